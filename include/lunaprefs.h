@@ -20,6 +20,8 @@
 #define _LUNAPREFS_H_
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <json.h>
 
 #ifdef __cplusplus
@@ -45,6 +47,9 @@ typedef void* LPAppHandle;
 #define LP_ERR_INTERNAL       11 /* some component I called reported failure */
 #define LP_ERR_DBERROR        12
 #define LP_ERR_PERM           13 /* Permission Denied*/
+#define LP_ERR_WRONGTYPE      14 /* typed getter called on a value of another type */
+#define LP_ERR_NOT_MODIFIED   15 /* value is still at the version the caller has */
+#define LP_ERR_NO_HISTORY     16 /* changes since then unknown; start over */
 
     /**
      * Add a file FOO with contents "BAR" to this directory and you now have a
@@ -59,35 +64,344 @@ typedef void* LPAppHandle;
  */
 
 /*
- * App prefs.  Each app has its own DB.
+ * App prefs.  Each app has its own DB, unless the shared store (below) is in
+ * use, in which case they all share one.
  */
 
 /**
- * @ brief: nuke the DB associated with this app id.
+ * @ brief: nuke the DB associated with this app id, journal and WAL too.
  */
 LPErr LPAppClearData( const char* appId );
 
+/**
+ * LPAppMigrateToSharedStore
+ *
+ * Move every app's prefs out of its own /var/preferences/<appId>/prefsDB.sl
+ * into one shared DB, keyed by appId and key, and remove the per-app DBs.
+ * From then on every handle, in every process, uses the shared DB, with no
+ * change to the API: one file to open, sync and back up instead of one per
+ * app.  The price is that writers on different apps now contend for the
+ * one DB, so it's best used with LP_OPT_JOURNAL_MODE at LP_JOURNAL_WAL and
+ * short write transactions.  Each app's DB is locked against writers while
+ * it's moved, waiting up to the default LP_OPT_BUSY_TIMEOUT for the lock,
+ * and refuses writes once moved, so no write to it is lost: each is either
+ * copied or fails.  If it fails (LP_ERR_BUSY if a lock can't be had) the
+ * per-app DBs are left as they were.  Running it again once the shared
+ * store is in use folds in any per-app DBs that have appeared since,
+ * overwriting what's there.
+ */
+LPErr LPAppMigrateToSharedStore( void );
+
+/**
+ * LPAppSharedStorePath
+ *
+ * The shared DB's path if LPAppMigrateToSharedStore has created it, else
+ * NULL.  Its data table has an app column ahead of key.
+ */
+const char* LPAppSharedStorePath( void );
+
 LPErr LPAppGetHandle( const char* appId, LPAppHandle* handle );
 
+/**
+ * LPAppGetHandleReadOnly
+ *
+ * A handle for reading only: its DB is opened read-only and its transaction
+ * never becomes a write transaction, so it takes no write lock.  Every read
+ * through it sees the DB as it was at the first one, until the handle is
+ * freed (commit or not makes no difference).  Setters and removers return
+ * LP_ERR_PERM.  With LP_OPT_JOURNAL_MODE at LP_JOURNAL_WAL any number of
+ * these can read while one writer writes; in the other journal modes a
+ * reader still keeps writers from committing until it's freed.
+ */
+LPErr LPAppGetHandleReadOnly( const char* appId, LPAppHandle* handle );
+
 /**
  * @param handle     returned via LPAppGetHandle.
  *
  * @param commit true means commit all statements actions made against
  *                   this handle, false means roll them all back.
  *
+ * The handle is freed even if the commit fails; its changes are then rolled
+ * back and the error returned.  Only while LPAppForEach or a value stream is
+ * using the handle is it left alone, with LP_ERR_PARAM_ERR.
  */
 LPErr LPAppFreeHandle( LPAppHandle handle, bool commit );
 
+/**
+ * LPAppCommit, LPAppRollback
+ *
+ * End the handle's transaction, as LPAppFreeHandle would, but keep the
+ * handle and its DB open.  The next call on the handle begins another, so a
+ * long-lived handle can commit as often as it likes without holding other
+ * writers off in between or paying to reopen.  On a read-only handle they
+ * end its snapshot.  If the commit fails (LP_ERR_BUSY, say) the transaction
+ * is still there to commit again.  Neither may be called from an
+ * LPAppForEach callback; they return LP_ERR_PARAM_ERR.
+ */
+LPErr LPAppCommit( LPAppHandle handle );
+LPErr LPAppRollback( LPAppHandle handle );
+
+/**
+ * LPAppSavepoint
+ *
+ * Mark a point in the handle's transaction that LPAppRollbackSavepoint can
+ * undo back to.  Savepoints nest: release and roll back apply to the most
+ * recent one still open, and both close it.  Releasing keeps its changes as
+ * part of the enclosing savepoint or transaction; nothing is committed until
+ * the transaction is.  LPAppCommit and LPAppRollback close all of them.  With
+ * none open, release and roll back return LP_ERR_PARAM_ERR, as roll back
+ * does from an LPAppForEach callback.
+ */
+LPErr LPAppSavepoint( LPAppHandle handle );
+LPErr LPAppReleaseSavepoint( LPAppHandle handle );
+LPErr LPAppRollbackSavepoint( LPAppHandle handle );
+
+/**
+ * Threads
+ *
+ * A handle may be shared between threads: each call on it holds the
+ * handle's lock for its duration, so calls are applied one at a time, in
+ * whatever order the threads get to them, all in the handle's one
+ * transaction.  Different handles, even on the same appId, don't block one
+ * another in the library (sqlite may still make a writer wait on another).
+ * A thread that needs several calls to go together -- a get and then a set
+ * that depends on it, or LPAppPeekValue and the use of what it points to --
+ * brackets them with LPAppLockHandle and LPAppUnlockHandle; the lock is
+ * recursive, so the calls in between work as usual.  LPAppForEach holds the
+ * lock while it runs, so its callback may call back into the handle from
+ * that thread, but other threads wait.
+ *
+ * LPAppFreeHandle must only be called once no other thread is using, or
+ * will use, the handle.  The pool, the options defaults and the async calls
+ * below are safe to use from any thread.
+ */
+void LPAppLockHandle( LPAppHandle handle );
+void LPAppUnlockHandle( LPAppHandle handle );
+
+/**
+ * LPAppSetPoolLimits
+ *
+ * Freeing a handle parks its app's DB, still open, in a process-wide pool so
+ * the next LPAppGetHandle for that appId can skip opening it.  At most
+ * maxOpen DBs are kept (least recently used are closed first) and DBs idle
+ * for more than idleSeconds are closed the next time the pool is used.
+ * maxOpen of 0 turns pooling off.  Defaults are 8 DBs and 30 seconds.
+ */
+LPErr LPAppSetPoolLimits( unsigned int maxOpen, unsigned int idleSeconds );
+
+/**
+ * LPAppTrimPool
+ *
+ * Close pooled DBs that are over their idle limit now rather than waiting for
+ * the pool to next be used, or all of them if closeAll is true.  DBs in use
+ * by a handle are not affected.
+ */
+LPErr LPAppTrimPool( bool closeAll );
+
+/*
+ * Tuning for app DBs.  Each option can be given a process-wide default,
+ * which applies to DBs opened from then on, and be overridden per handle.
+ * Options never set are left at sqlite's defaults.
+ */
+typedef enum {
+    LP_OPT_JOURNAL_MODE,        /* one of LP_JOURNAL_*; WAL persists in the file */
+    LP_OPT_SYNCHRONOUS,         /* one of LP_SYNC_* */
+    LP_OPT_CACHE_SIZE,          /* pages, or KiB if negative, as PRAGMA cache_size */
+    LP_OPT_MMAP_SIZE,           /* bytes of the DB to memory-map; 0 for none */
+    LP_OPT_WAL_AUTOCHECKPOINT,  /* WAL pages before a commit checkpoints; 0
+                                   never, leaving it to LPAppCheckpoint */
+    LP_OPT_READ_CACHE,          /* bytes; see below.  0, the default, for none */
+    LP_OPT_COMPRESS_MIN,        /* bytes; see below.  0, the default, for none */
+    LP_OPT_BUSY_TIMEOUT,        /* ms; see below.  0, the default, never waits */
+    LP_OPT_COUNT
+} LPAppOption;
+
+#define LP_JOURNAL_DELETE   0
+#define LP_JOURNAL_TRUNCATE 1
+#define LP_JOURNAL_PERSIST  2
+#define LP_JOURNAL_WAL      3
+
+#define LP_SYNC_OFF    0
+#define LP_SYNC_NORMAL 1
+#define LP_SYNC_FULL   2
+#define LP_SYNC_EXTRA  3
+
+/*
+ * LP_OPT_READ_CACHE keeps a copy of the whole DB in memory, if it fits in
+ * that many bytes, and answers LPAppCopyValue, LPAppCopyValueCJ,
+ * LPAppPeekValue and LPAppForEach from it.  Before each use the copy is
+ * checked, which is cheap, against the DB's change counter, and reloaded if
+ * anyone -- this handle, or another process -- has changed the DB since.  So
+ * it never returns stale data, but only pays off for DBs read more often
+ * than they're written.
+ *
+ * LP_OPT_COMPRESS_MIN has values of at least that many bytes stored
+ * zlib-compressed, when that makes them smaller.  Reads decompress them
+ * whatever the setting, so it can be changed at any time and only affects
+ * values written from then on.  Versions of this library from before the
+ * option can't read compressed values.
+ *
+ * LP_OPT_BUSY_TIMEOUT is how long a call keeps retrying when another
+ * connection (luna-prop, the service, another thread's handle) has the DB
+ * locked, before giving up with LP_ERR_BUSY.  Retries back off
+ * exponentially with some randomness.  Unlike the other options it can be
+ * changed on a handle whose DB is open, taking effect from the next call,
+ * so it can be set around a single call.  The call waits holding its
+ * handle's lock, whose DB is in the middle of the statement, so other
+ * threads sharing the handle wait as long; a thread that mustn't stall
+ * behind a locked DB uses a handle of its own.
+ */
+
+LPErr LPAppSetDefaultOption( LPAppOption option, long long value );
+
+/**
+ * LPAppSetOption
+ *
+ * Override a default for this handle only.  The handle's DB is opened, and
+ * the options applied, on its first get or set, so this must be called
+ * before that; afterwards it returns LP_ERR_PARAM_ERR.
+ */
+LPErr LPAppSetOption( LPAppHandle handle, LPAppOption option, long long value );
+
+/**
+ * LPAppGetBusyStats
+ *
+ * Process-wide counts of calls that found a DB locked by another
+ * connection, of those that gave up on it with LP_ERR_BUSY -- at once if
+ * LP_OPT_BUSY_TIMEOUT is 0 -- and of the time spent waiting.  reset zeroes
+ * the counts after copying them.
+ */
+typedef struct LPBusyStats {
+    unsigned long long waits;
+    unsigned long long timeouts;
+    unsigned long long waitedUS;  /* microseconds */
+} LPBusyStats;
+
+void LPAppGetBusyStats( LPBusyStats* stats, bool reset );
+
+/**
+ * LPAppUnpackStoredValue
+ *
+ * For code that reads an app DB's data table itself, as the service's
+ * backup does: a value column holding a BLOB rather than TEXT was
+ * compressed by LP_OPT_COMPRESS_MIN, and this returns its text, to be freed
+ * with g_free.  LP_ERR_VALUENOTJSON if it isn't a compressed value.
+ */
+LPErr LPAppUnpackStoredValue( const void* stored, size_t len, char** jstr );
+
+/**
+ * LPAppCheckpoint
+ *
+ * Copy what's in appId's write-ahead log back into its DB without waiting on
+ * readers or writers (a passive checkpoint).  For use with
+ * LP_OPT_WAL_AUTOCHECKPOINT set to 0, so that the work can be done when
+ * nobody is waiting on a get or set.  A no-op for DBs not in WAL mode.
+ */
+LPErr LPAppCheckpoint( const char* appId );
+
+/**
+ * LPAppGetSpace
+ *
+ * Report the size of appId's DB in pages, and how many of those are free
+ * pages LPAppReclaimSpace could give back to the filesystem.  freePages is
+ * always 0 for DBs created before incremental auto-vacuum was turned on.
+ * Both are 0 if appId has no DB.
+ */
+LPErr LPAppGetSpace( const char* appId, unsigned int* pages,
+                     unsigned int* freePages );
+
+/**
+ * LPAppReclaimSpace
+ *
+ * Give back up to maxPages of appId's free pages, then checkpoint as
+ * LPAppCheckpoint does.  Never waits: LP_ERR_BUSY if another connection is
+ * writing, in which case try again later.  Meant for idle time, a bounded
+ * slice at a time.
+ */
+LPErr LPAppReclaimSpace( const char* appId, unsigned int maxPages );
+
 
 LPErr LPAppCopyValue( LPAppHandle handle, const char* key, char** jstr );
+    /** LPAppPeekValue
+     *
+     * @brief like LPAppCopyValue, but *jstr points at the stored value
+     * instead of a copy.  It belongs to the handle and is good only until
+     * the handle is next used or freed, by any thread; see LPAppLockHandle.
+     * The value is returned as stored, without checking that it's a json
+     * document.
+     */
+LPErr LPAppPeekValue( LPAppHandle handle, const char* key, const char** jstr );
+
+/**
+ * LPAppGetValueInfo
+ *
+ * What's known about key's value without reading it.  version goes up each
+ * time the value is written, by anybody, and is never reused for the same
+ * app, even once the key or the app's whole DB is removed: a DB made again
+ * starts its versions at random, so they're not ordered against the old
+ * DB's, only different.  Values from before versions were kept are at
+ * version 0 with mtime 0 until next written.
+ */
+typedef struct LPValueInfo {
+    long long version;
+    long long mtime;            /* ms since the epoch of the last write */
+    long long size;             /* bytes of json text, however stored */
+} LPValueInfo;
+
+LPErr LPAppGetValueInfo( LPAppHandle handle, const char* key,
+                         LPValueInfo* info );
+
+/**
+ * LPAppCopyValueIfChanged
+ *
+ * LPAppCopyValue for a caller holding a copy of the value at knownVersion
+ * (-1 if none): LP_ERR_NOT_MODIFIED, without the value being read, if the
+ * value's still at that version.  *version gets the value's current
+ * version either way.
+ */
+LPErr LPAppCopyValueIfChanged( LPAppHandle handle, const char* key,
+                               long long knownVersion, char** jstr,
+                               long long* version );
     /** LPAppCopyValueString
      *
      * @brief convenience function.  Looks up value in DB, assumes it's an
      * array of one string, and returns that string.
      */
 LPErr LPAppCopyValueString( LPAppHandle handle, const char* key, char** str );
+    /** LPAppCopyValueInt
+     *
+     * @brief convenience function.  The number at the start of a value
+     * that's an array of one string, or a value from the typed setters, as
+     * an int; a double is truncated toward zero.  LP_ERR_VALUENOTJSON if the
+     * value's some other JSON, and LP_ERR_WRONGTYPE if the number is beyond
+     * an int's range.
+     */
 LPErr LPAppCopyValueInt( LPAppHandle handle, const char* key, int* intValue );
 LPErr LPAppCopyValueCJ( LPAppHandle handle, const char* key, struct json_object** json );
+    /** LPAppCopyValuePath
+     *
+     * @brief copy only the part of key's value that path selects, e.g.
+     * "$.audio.eq[3]" (sqlite's JSON path syntax: "$" is the whole value,
+     * ".name" a member and "[n]" an array element).  The path is followed
+     * inside sqlite, which needs its JSON1 functions, so only what's
+     * selected is copied out.  *jstr is its json text, which may be a
+     * string, number, true, false or null as well as an object or array.
+     * Returns LP_ERR_NO_SUCH_KEY if there's no key or nothing at path, and
+     * LP_ERR_PARAM_ERR if path is malformed, whatever the value.
+     */
+LPErr LPAppCopyValuePath( LPAppHandle handle, const char* key, const char* path,
+                          char** jstr );
+
+    /** LPAppCopyValueInt64, LPAppCopyValueDouble, LPAppCopyValueBool
+     *
+     * @brief typed getters.  Values stored by the matching typed setter are
+     * read without any json parsing.  Older values of the ["123"] form are
+     * still read, by parsing them.  Returns LP_ERR_WRONGTYPE if the value
+     * isn't of the type asked for; an int64 can be read as a double.
+     */
+LPErr LPAppCopyValueInt64( LPAppHandle handle, const char* key, int64_t* intValue );
+LPErr LPAppCopyValueDouble( LPAppHandle handle, const char* key, double* doubleValue );
+LPErr LPAppCopyValueBool( LPAppHandle handle, const char* key, bool* boolValue );
 
 LPErr LPAppSetValue( LPAppHandle handle, const char* key, const char* const jstr );
     /** LPAppSetValueString
@@ -99,8 +413,97 @@ LPErr LPAppSetValueString( LPAppHandle handle, const char* key, const char* cons
 LPErr LPAppSetValueInt( LPAppHandle handle, const char* key, int intValue );
 LPErr LPAppSetValueCJ( LPAppHandle handle, const char* key, struct json_object* json );
 
+    /** LPAppSetValueInt64, LPAppSetValueDouble, LPAppSetValueBool
+     *
+     * @brief typed setters.  Like LPAppSetValueString and LPAppSetValueInt
+     * (which are typed too) the value remains readable as json, as an array
+     * of one string: ["123"], ["1.5"], ["true"].  Doubles must be finite.
+     */
+LPErr LPAppSetValueInt64( LPAppHandle handle, const char* key, int64_t intValue );
+LPErr LPAppSetValueDouble( LPAppHandle handle, const char* key, double doubleValue );
+LPErr LPAppSetValueBool( LPAppHandle handle, const char* key, bool boolValue );
+
+/**
+ * LPAppMergeValue
+ *
+ * Apply patch, a JSON merge patch (RFC 7396), to key's value in place: the
+ * patch's members replace the value's members of the same name, recursively
+ * for objects, and members set to null are removed.  An array patch replaces
+ * the value.  If key has no value the patch, less its nulls, becomes it.  The
+ * merge is done by sqlite (it needs the JSON1 functions), so only the patch
+ * is parsed and copied here.  Returns LP_ERR_VALUENOTJSON if the patch isn't
+ * a json object or array, or the stored value isn't json.
+ */
+LPErr LPAppMergeValue( LPAppHandle handle, const char* key, const char* patch );
+LPErr LPAppMergeValueCJ( LPAppHandle handle, const char* key, struct json_object* patch );
+
 LPErr LPAppRemoveValue( LPAppHandle handle, const char* key );
 
+/**
+ * LPAppIncrement
+ *
+ * Add delta to the int64 stored under key, storing delta if there's no such
+ * key, and return the sum in newValue (which may be NULL).  Unlike a get
+ * followed by a set this is one update of the DB, so increments made at the
+ * same time by other processes aren't lost.  Returns LP_ERR_WRONGTYPE if the
+ * value isn't an int64, and LP_ERR_PARAM_ERR if the sum would overflow.
+ */
+LPErr LPAppIncrement( LPAppHandle handle, const char* key, int64_t delta,
+                      int64_t* newValue );
+
+/**
+ * LPAppCompareAndSet, LPAppCompareAndSetInt64
+ *
+ * Store a new value under key only if the one there is still expected, in
+ * one update of the DB, and set *swapped to say whether it was.
+ *
+ * LPAppCompareAndSet compares json text exactly as LPAppCopyValue returns
+ * it; an expected of NULL means the key must not exist yet.
+ * LPAppCompareAndSetInt64 returns LP_ERR_NO_SUCH_KEY or LP_ERR_WRONGTYPE
+ * if key doesn't hold an int64, and otherwise the value key holds after the
+ * call in current, which may be NULL.
+ */
+LPErr LPAppCompareAndSet( LPAppHandle handle, const char* key,
+                          const char* expected, const char* jstr,
+                          bool* swapped );
+LPErr LPAppCompareAndSetInt64( LPAppHandle handle, const char* key,
+                               int64_t expected, int64_t desired,
+                               bool* swapped, int64_t* current );
+
+/**
+ * LPAppRemovePrefix
+ *
+ * Remove every key starting with prefix, which must not be empty.  Returns
+ * LP_ERR_NO_SUCH_KEY if there were none.
+ */
+LPErr LPAppRemovePrefix( LPAppHandle handle, const char* prefix );
+
+/**
+ * LPAppSetValues
+ *
+ * Store count values, each a json document, under the matching keys as one
+ * unit: every key and value is checked before anything is written, and if
+ * one fails or a write fails none of the pairs is stored.  LPAppSetValuesCJ
+ * does the same for each key/value of a json object.
+ */
+LPErr LPAppSetValues( LPAppHandle handle, const char* const* keys,
+                      const char* const* jstrs, int count );
+LPErr LPAppSetValuesCJ( LPAppHandle handle, struct json_object* values );
+
+/**
+ * LPAppCopyValues
+ *
+ * Look up count keys at once.  *values gets a json object mapping each key
+ * found to its value; if errors is non-NULL *errors gets one mapping each
+ * key that couldn't be read to its LPErr (e.g. LP_ERR_NO_SUCH_KEY).  Per-key
+ * failures don't fail the call.  Strings are g_malloc'd; caller must g_free
+ * them (or json_object_put the CJ versions) when done.
+ */
+LPErr LPAppCopyValues( LPAppHandle handle, const char* const* keys, int count,
+                       char** values, char** errors );
+LPErr LPAppCopyValuesCJ( LPAppHandle handle, const char* const* keys, int count,
+                         struct json_object** values, struct json_object** errors );
+
 /**
  * LPAppCopyKeys
  *
@@ -111,16 +514,172 @@ LPErr LPAppRemoveValue( LPAppHandle handle, const char* key );
 LPErr LPAppCopyKeys( LPAppHandle handle, char** jstr );
 LPErr LPAppCopyKeysCJ( LPAppHandle handle, struct json_object** json );
 
+/**
+ * LPAppCopyKeysWithPrefix
+ *
+ * As LPAppCopyKeys, but only keys starting with prefix, in key order.  The
+ * lookup uses the key index rather than reading the whole table.
+ */
+LPErr LPAppCopyKeysWithPrefix( LPAppHandle handle, const char* prefix, char** jstr );
+LPErr LPAppCopyKeysWithPrefixCJ( LPAppHandle handle, const char* prefix,
+                                 struct json_object** json );
+
 /**
  * LPAppCopyAll
  *
  * Return in *json ptr to json-formatted string consisting of a json array of
  * key/value pairs representing all the keys and values.  The null-terminated
  * string returned is g_malloc'd internally.  Caller must call g_free when done.
+ * The list is laid out as json-c would, "[ { "key": value }, ... ]", but each
+ * value is the text as stored, not parsed and written out again by json-c:
+ * a value stored as {"a":1} comes back so, where it used to come back as
+ * { "a": 1 }.
  */
 LPErr LPAppCopyAll( LPAppHandle handle, char** jstr );
 LPErr LPAppCopyAllCJ( LPAppHandle handle, struct json_object** json );
 
+/**
+ * LPAppCopyAllWithPrefix
+ *
+ * As LPAppCopyAll, but only keys starting with prefix, in key order.
+ */
+LPErr LPAppCopyAllWithPrefix( LPAppHandle handle, const char* prefix, char** jstr );
+LPErr LPAppCopyAllWithPrefixCJ( LPAppHandle handle, const char* prefix,
+                                struct json_object** json );
+
+/**
+ * LPAppCopyChangesSince
+ *
+ * For keeping a copy of an app's values up to date without reading them all
+ * each time.  Every write moves the app's sequence number on, and stamps
+ * what it wrote (see LPAppGetValueInfo); a removed key is remembered as
+ * removed at that number.  Given the *seq from an earlier call, this
+ * returns
+ *
+ *   { "changed": [ { key: value }, ... ], "removed": [ key, ... ] }
+ *
+ * with what was set, and what removed, since then, and sets *seq to pass
+ * next time.  since of -1 lists every key, for a first copy.  If the app's
+ * history doesn't go back as far as since -- its DB was removed and made
+ * again, or predates this -- it's LP_ERR_NO_HISTORY, and the caller starts
+ * over from -1.
+ */
+LPErr LPAppCopyChangesSince( LPAppHandle handle, long long since,
+                             char** jstr, long long* seq );
+
+/**
+ * LPAppForEach
+ *
+ * Call func once for each key starting with prefix (every key if prefix is
+ * NULL or empty), in key order, until it returns false.  key and value are
+ * the stored strings, good only for the duration of the call, so nothing is
+ * copied and memory use doesn't grow with the number of keys.  func may read
+ * through the handle, but must not write through it or call LPAppForEach on
+ * it again.
+ */
+typedef bool (*LPAppForEachFunc)( const char* key, const char* value, void* ctx );
+LPErr LPAppForEach( LPAppHandle handle, const char* prefix,
+                    LPAppForEachFunc func, void* ctx );
+
+/**
+ * LPAppOpenValueRead, LPAppOpenValueWrite, LPAppReadValue, LPAppWriteValue,
+ * LPAppCloseValue
+ *
+ * Read or write a value a chunk at a time, for values too big to want a
+ * second copy of in memory.  LPAppOpenValueRead returns the stored value's
+ * length in size; LPAppReadValue then copies out up to len bytes at a time,
+ * setting got to 0 once it's all been read.  Like LPAppPeekValue, what's
+ * read is the stored string, without checking that it's json.
+ *
+ * LPAppOpenValueWrite replaces key's value with one of exactly size bytes,
+ * which LPAppWriteValue calls then fill in order; writing past size returns
+ * LP_ERR_PARAM_ERR.  Whatever isn't written is left as spaces, so size may
+ * be an upper bound.  LPAppCloseValue with keep true stores the value if it
+ * is json, and otherwise returns LP_ERR_VALUENOTJSON and leaves the old
+ * value (or no value) in place, as keep false always does.  A handle can
+ * have one write stream open at a time.
+ *
+ * Streams must be closed before their handle is committed, rolled back or
+ * freed, and a write stream before a savepoint is opened, released or
+ * rolled back; those return LP_ERR_PARAM_ERR until they are.  Setting or removing the
+ * key another way while a stream is open on it makes later reads and writes
+ * fail.
+ */
+typedef void* LPAppValueStream;
+LPErr LPAppOpenValueRead( LPAppHandle handle, const char* key,
+                          LPAppValueStream* stream, size_t* size );
+LPErr LPAppOpenValueWrite( LPAppHandle handle, const char* key, size_t size,
+                           LPAppValueStream* stream );
+LPErr LPAppReadValue( LPAppValueStream stream, char* buf, size_t len,
+                      size_t* got );
+LPErr LPAppWriteValue( LPAppValueStream stream, const char* buf, size_t len );
+LPErr LPAppCloseValue( LPAppValueStream stream, bool keep );
+
+/**
+ * LPAppCopyValueAsync, LPAppCopyValuePathAsync, LPAppSetValueAsync,
+ * LPAppMergeValueAsync, LPAppRemoveValueAsync
+ *
+ * The same as getting a handle on appId, calling LPAppCopyValue (or
+ * LPAppCopyValuePath, LPAppSetValue, LPAppMergeValue or LPAppRemoveValue)
+ * and freeing the handle, committing if the call succeeded.  But the work
+ * is done on a thread the library owns, so a slow fsync doesn't hold up the
+ * caller.  func is then called with the result from the GMainContext that
+ * was the calling thread's default, so that context's loop must be running.
+ * jstr is the value found by the copies, and NULL otherwise; it is freed
+ * when func returns.
+ *
+ * Calls on the same appId are carried out and completed in the order they
+ * were made.  The return value only reports bad arguments, or failure to
+ * start the thread; func is not called then.
+ */
+typedef void (*LPAppAsyncFunc)( LPErr err, const char* jstr, void* ctx );
+LPErr LPAppCopyValueAsync( const char* appId, const char* key,
+                           LPAppAsyncFunc func, void* ctx );
+LPErr LPAppCopyValuePathAsync( const char* appId, const char* key,
+                               const char* path, LPAppAsyncFunc func, void* ctx );
+LPErr LPAppSetValueAsync( const char* appId, const char* key,
+                          const char* jstr, LPAppAsyncFunc func, void* ctx );
+LPErr LPAppMergeValueAsync( const char* appId, const char* key,
+                            const char* patch, LPAppAsyncFunc func, void* ctx );
+LPErr LPAppRemoveValueAsync( const char* appId, const char* key,
+                             LPAppAsyncFunc func, void* ctx );
+
+/**
+ * LPAppCopyValueIfChangedAsync
+ *
+ * LPAppCopyValueIfChanged as the calls above do LPAppCopyValue; func also
+ * gets the value's version.
+ */
+typedef void (*LPAppAsyncVersionFunc)( LPErr err, const char* jstr,
+                                       long long version, void* ctx );
+LPErr LPAppCopyValueIfChangedAsync( const char* appId, const char* key,
+                                    long long knownVersion,
+                                    LPAppAsyncVersionFunc func, void* ctx );
+
+/**
+ * LPAppCheckpointAsync
+ *
+ * LPAppCheckpoint on the same thread as the calls above, and in order with
+ * them, so the checkpoint's fsync holds up nothing but that thread.  func
+ * gets its result, and a jstr of NULL.
+ */
+LPErr LPAppCheckpointAsync( const char* appId, LPAppAsyncFunc func,
+                            void* ctx );
+
+/**
+ * LPAppGetSpaceAsync, LPAppReclaimSpaceAsync
+ *
+ * LPAppGetSpace and LPAppReclaimSpace on the same thread, as
+ * LPAppCheckpointAsync is, for idle-time upkeep that mustn't hold up a
+ * caller's loop.  LPAppReclaimSpaceAsync's func gets a jstr of NULL.
+ */
+typedef void (*LPAppAsyncSpaceFunc)( LPErr err, unsigned int pages,
+                                     unsigned int freePages, void* ctx );
+LPErr LPAppGetSpaceAsync( const char* appId, LPAppAsyncSpaceFunc func,
+                          void* ctx );
+LPErr LPAppReclaimSpaceAsync( const char* appId, unsigned int maxPages,
+                              LPAppAsyncFunc func, void* ctx );
+
 
 /*
  * Sys prefs.  There's one DB conceptually.  In reality the values can
@@ -170,6 +729,10 @@ LPErr LPSystemCopyKeysPublicCJ( struct json_object** json ); /* for use by the s
  * Return in *json ptr to json-formatted string consisting of a json array of
  * key/value pairs representing all the keys and values.  The null-terminated
  * string returned is g_malloc'd internally.  Caller must call g_free when done.
+ * The list is laid out as json-c would, "[ { "key": value }, ... ]", but each
+ * value is the text as stored, not parsed and written out again by json-c:
+ * a value stored as {"a":1} comes back so, where it used to come back as
+ * { "a": 1 }.
  */
 LPErr LPSystemCopyAll( char** jstr );
 LPErr LPSystemCopyAllCJ( struct json_object** json );
@@ -0,0 +1,532 @@
+// Copyright (c) 2026 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+/* -*-mode: C; fill-column: 78; c-basic-offset: 4; -*- */
+
+#include "jsonscan.h"
+
+#include <stdbool.h>
+
+#if defined(__SSE2__)
+# include <emmintrin.h>
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+# include <immintrin.h>
+# define HAVE_AVX2_DISPATCH
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+# include <arm_neon.h>
+#endif
+
+/* Where we are in the document.  The states before ST_STRING are between
+   tokens, where whitespace is skipped. */
+enum {
+    ST_TOP,             /* before the top-level container */
+    ST_VALUE,           /* after ':', or ',' in an array */
+    ST_VALUE_OR_CLOSE,  /* after '[' */
+    ST_KEY,             /* after ',' in an object */
+    ST_KEY_OR_CLOSE,    /* after '{' */
+    ST_COLON,           /* after a key */
+    ST_AFTER,           /* after a value: ',' or the container's close */
+    ST_DONE,            /* after the top-level container closed */
+    ST_STRING,
+    ST_ESCAPE,          /* after '\' in a string */
+    ST_UNICODE,         /* in the hex digits of a \u escape */
+    ST_NUMBER,
+    ST_LITERAL          /* in true, false or null */
+};
+
+/* Progress through a number, for ST_NUMBER */
+enum {
+    NUM_MINUS,          /* '-' */
+    NUM_ZERO,           /* leading '0' */
+    NUM_INT,            /* integer digits */
+    NUM_DOT,            /* '.' */
+    NUM_FRAC,           /* fraction digits */
+    NUM_E,              /* 'e' or 'E' */
+    NUM_ESIGN,          /* exponent sign */
+    NUM_EXP             /* exponent digits */
+};
+
+/* Keep integers within int64 and exponents within what strtod() handles
+   the same way everywhere. */
+#define MAX_INT_DIGITS 18
+#define MAX_EXP_DIGITS 3
+
+/*****************************************************************************
+* String bodies
+*
+* Nearly all the bytes in a preference value are inside strings, and inside
+* a string only '"', '\' and control characters need a closer look.  So that
+* is where we go wide: find the next such byte 16 or 32 at a time.  Each of
+* these returns the first byte in [pp, end) that is one of those, or end.
+*****************************************************************************/
+
+static const unsigned char*
+skipPlainScalar( const unsigned char* pp, const unsigned char* end )
+{
+    while ( pp < end && *pp != '"' && *pp != '\\' && *pp >= 0x20 ) {
+        ++pp;
+    }
+    return pp;
+}
+
+#if defined(__SSE2__)
+static const unsigned char*
+skipPlainSSE2( const unsigned char* pp, const unsigned char* end )
+{
+    const __m128i quote = _mm_set1_epi8( '"' );
+    const __m128i bslash = _mm_set1_epi8( '\\' );
+    const __m128i ctl = _mm_set1_epi8( 0x1F );
+    while ( end - pp >= 16 ) {
+        __m128i vv = _mm_loadu_si128( (const __m128i*)pp );
+        __m128i hit = _mm_or_si128(
+            _mm_or_si128( _mm_cmpeq_epi8( vv, quote ),
+                          _mm_cmpeq_epi8( vv, bslash ) ),
+            /* unsigned vv <= 0x1F */
+            _mm_cmpeq_epi8( _mm_min_epu8( vv, ctl ), vv ) );
+        int mask = _mm_movemask_epi8( hit );
+        if ( 0 != mask ) {
+            return pp + __builtin_ctz( mask );
+        }
+        pp += 16;
+    }
+    return skipPlainScalar( pp, end );
+}
+#endif
+
+#if defined(HAVE_AVX2_DISPATCH)
+__attribute__((target("avx2")))
+static const unsigned char*
+skipPlainAVX2( const unsigned char* pp, const unsigned char* end )
+{
+    const __m256i quote = _mm256_set1_epi8( '"' );
+    const __m256i bslash = _mm256_set1_epi8( '\\' );
+    const __m256i ctl = _mm256_set1_epi8( 0x1F );
+    while ( end - pp >= 32 ) {
+        __m256i vv = _mm256_loadu_si256( (const __m256i*)pp );
+        __m256i hit = _mm256_or_si256(
+            _mm256_or_si256( _mm256_cmpeq_epi8( vv, quote ),
+                             _mm256_cmpeq_epi8( vv, bslash ) ),
+            _mm256_cmpeq_epi8( _mm256_min_epu8( vv, ctl ), vv ) );
+        unsigned int mask = (unsigned int)_mm256_movemask_epi8( hit );
+        if ( 0 != mask ) {
+            return pp + __builtin_ctz( mask );
+        }
+        pp += 32;
+    }
+# if defined(__SSE2__)
+    return skipPlainSSE2( pp, end );
+# else
+    return skipPlainScalar( pp, end );
+# endif
+}
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+static const unsigned char*
+skipPlainNEON( const unsigned char* pp, const unsigned char* end )
+{
+    const uint8x16_t quote = vdupq_n_u8( '"' );
+    const uint8x16_t bslash = vdupq_n_u8( '\\' );
+    const uint8x16_t ctl = vdupq_n_u8( 0x1F );
+    while ( end - pp >= 16 ) {
+        uint8x16_t vv = vld1q_u8( pp );
+        uint8x16_t hit = vorrq_u8( vorrq_u8( vceqq_u8( vv, quote ),
+                                             vceqq_u8( vv, bslash ) ),
+                                   vcleq_u8( vv, ctl ) );
+        /* narrow each byte of hit to a nibble of a 64-bit mask */
+        uint8x8_t nibbles = vshrn_n_u16( vreinterpretq_u16_u8( hit ), 4 );
+        uint64_t mask = vget_lane_u64( vreinterpret_u64_u8( nibbles ), 0 );
+        if ( 0 != mask ) {
+            return pp + (__builtin_ctzll( mask ) >> 2);
+        }
+        pp += 16;
+    }
+    return skipPlainScalar( pp, end );
+}
+#endif
+
+typedef const unsigned char* (*SkipPlainFunc)( const unsigned char*,
+                                               const unsigned char* );
+
+/* Pick the widest version this CPU runs.  Racing threads can only store the
+   same answer, so there's no need to lock. */
+static SkipPlainFunc
+getSkipPlain( void )
+{
+    static SkipPlainFunc sSkipPlain = NULL;
+    if ( NULL == sSkipPlain ) {
+        SkipPlainFunc func = skipPlainScalar;
+#if defined(__SSE2__)
+        func = skipPlainSSE2;
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+        func = skipPlainNEON;
+#endif
+#if defined(HAVE_AVX2_DISPATCH)
+        __builtin_cpu_init();
+        if ( __builtin_cpu_supports( "avx2" ) ) {
+            func = skipPlainAVX2;
+        }
+#endif
+        sSkipPlain = func;
+    }
+    return sSkipPlain;
+}
+
+/*****************************************************************************
+* The state machine
+*****************************************************************************/
+
+static void
+giveUp( JsonScan* scan )
+{
+    scan->result = JSONSCAN_UNKNOWN;
+}
+
+static int
+hexValue( unsigned char ch )
+{
+    if ( ch >= '0' && ch <= '9' ) {
+        return ch - '0';
+    } else if ( ch >= 'a' && ch <= 'f' ) {
+        return ch - 'a' + 10;
+    } else if ( ch >= 'A' && ch <= 'F' ) {
+        return ch - 'A' + 10;
+    }
+    return -1;
+}
+
+static void
+push( JsonScan* scan, bool isObject )
+{
+    if ( scan->depth == JSONSCAN_MAX_DEPTH ) {
+        giveUp( scan );
+    } else {
+        if ( isObject ) {
+            scan->stack |= 1 << scan->depth;
+        } else {
+            scan->stack &= ~(1 << scan->depth);
+        }
+        ++scan->depth;
+        scan->state = isObject ? ST_KEY_OR_CLOSE : ST_VALUE_OR_CLOSE;
+    }
+}
+
+static void
+pop( JsonScan* scan, bool isObject )
+{
+    bool topIsObject = 0 != (scan->stack & (1 << (scan->depth - 1)));
+    if ( topIsObject != isObject ) {
+        giveUp( scan );
+    } else {
+        --scan->depth;
+        scan->state = 0 == scan->depth ? ST_DONE : ST_AFTER;
+    }
+}
+
+static void
+beginValue( JsonScan* scan, unsigned char ch )
+{
+    switch ( ch ) {
+    case '{':
+    case '[':
+        push( scan, ch == '{' );
+        break;
+    case '"':
+        scan->state = ST_STRING;
+        scan->inKey = false;
+        break;
+    case '-':
+        scan->state = ST_NUMBER;
+        scan->sub = NUM_MINUS;
+        scan->count = 0;
+        break;
+    case 't':
+    case 'f':
+    case 'n':
+        scan->state = ST_LITERAL;
+        scan->literal = ch == 't' ? "true" : ch == 'f' ? "false" : "null";
+        scan->sub = 1;
+        break;
+    default:
+        if ( ch >= '0' && ch <= '9' ) {
+            scan->state = ST_NUMBER;
+            scan->sub = ch == '0' ? NUM_ZERO : NUM_INT;
+            scan->count = 1;
+        } else {
+            giveUp( scan );
+        }
+    }
+}
+
+/* Handle a character between tokens that isn't whitespace. */
+static void
+structural( JsonScan* scan, unsigned char ch )
+{
+    switch ( scan->state ) {
+    case ST_TOP:
+        if ( ch == '{' || ch == '[' ) {
+            push( scan, ch == '{' );
+        } else {
+            giveUp( scan );
+        }
+        break;
+    case ST_VALUE_OR_CLOSE:
+        if ( ch == ']' ) {
+            pop( scan, false );
+            break;
+        }
+        /* fall through */
+    case ST_VALUE:
+        beginValue( scan, ch );
+        break;
+    case ST_KEY_OR_CLOSE:
+        if ( ch == '}' ) {
+            pop( scan, true );
+            break;
+        }
+        /* fall through */
+    case ST_KEY:
+        if ( ch == '"' ) {
+            scan->state = ST_STRING;
+            scan->inKey = true;
+        } else {
+            giveUp( scan );
+        }
+        break;
+    case ST_COLON:
+        if ( ch == ':' ) {
+            scan->state = ST_VALUE;
+        } else {
+            giveUp( scan );
+        }
+        break;
+    case ST_AFTER:
+        if ( ch == ',' ) {
+            scan->state = (scan->stack & (1 << (scan->depth - 1)))
+                ? ST_KEY : ST_VALUE;
+        } else if ( ch == '}' || ch == ']' ) {
+            pop( scan, ch == '}' );
+        } else {
+            giveUp( scan );
+        }
+        break;
+    default:                    /* ST_DONE: trailing garbage */
+        giveUp( scan );
+    }
+}
+
+/*
+ * Take ch as the next character of a number if it can be.  Returns false,
+ * having consumed nothing, when the number has ended -- or is broken, which
+ * the caller learns from numberComplete().
+ */
+static bool
+numberChar( JsonScan* scan, unsigned char ch )
+{
+    bool digit = ch >= '0' && ch <= '9';
+    bool taken = true;
+    switch ( scan->sub ) {
+    case NUM_MINUS:
+        if ( digit ) {
+            scan->sub = ch == '0' ? NUM_ZERO : NUM_INT;
+            scan->count = 1;
+        } else {
+            taken = false;
+        }
+        break;
+    case NUM_INT:
+        if ( digit ) {
+            if ( ++scan->count > MAX_INT_DIGITS ) {
+                giveUp( scan );
+            }
+            break;
+        }
+        /* fall through */
+    case NUM_ZERO:
+        if ( ch == '.' ) {
+            scan->sub = NUM_DOT;
+        } else if ( ch == 'e' || ch == 'E' ) {
+            scan->sub = NUM_E;
+        } else {
+            taken = false;
+        }
+        break;
+    case NUM_DOT:
+        if ( digit ) {
+            scan->sub = NUM_FRAC;
+        } else {
+            taken = false;
+        }
+        break;
+    case NUM_FRAC:
+        if ( ch == 'e' || ch == 'E' ) {
+            scan->sub = NUM_E;
+        } else if ( !digit ) {
+            taken = false;
+        }
+        break;
+    case NUM_E:
+        if ( ch == '+' || ch == '-' ) {
+            scan->sub = NUM_ESIGN;
+            break;
+        }
+        /* fall through */
+    case NUM_ESIGN:
+        if ( digit ) {
+            scan->sub = NUM_EXP;
+            scan->count = 1;
+        } else {
+            taken = false;
+        }
+        break;
+    case NUM_EXP:
+        if ( !digit ) {
+            taken = false;
+        } else if ( ++scan->count > MAX_EXP_DIGITS ) {
+            giveUp( scan );
+        }
+        break;
+    }
+    return taken;
+}
+
+static bool
+numberComplete( const JsonScan* scan )
+{
+    return scan->sub == NUM_ZERO || scan->sub == NUM_INT
+        || scan->sub == NUM_FRAC || scan->sub == NUM_EXP;
+}
+
+void
+jsonScanInit( JsonScan* scan )
+{
+    scan->result = JSONSCAN_MORE;
+    scan->state = ST_TOP;
+    scan->sub = 0;
+    scan->inKey = false;
+    scan->depth = 0;
+    scan->stack = 0;
+    scan->count = 0;
+    scan->literal = NULL;
+}
+
+JsonScanResult
+jsonScanFeed( JsonScan* scan, const char* buf, size_t len )
+{
+    const unsigned char* pp = (const unsigned char*)buf;
+    const unsigned char* end = pp + len;
+    SkipPlainFunc skipPlain = getSkipPlain();
+
+    while ( JSONSCAN_MORE == scan->result && pp < end ) {
+        unsigned char ch = *pp;
+        switch ( scan->state ) {
+        case ST_STRING:
+            pp = (*skipPlain)( pp, end );
+            if ( pp < end ) {
+                ch = *pp++;
+                if ( ch == '"' ) {
+                    scan->state = scan->inKey ? ST_COLON : ST_AFTER;
+                } else if ( ch == '\\' ) {
+                    scan->state = ST_ESCAPE;
+                } else {        /* raw control character */
+                    giveUp( scan );
+                }
+            }
+            break;
+        case ST_ESCAPE:
+            ++pp;
+            switch ( ch ) {
+            case '"': case '\\': case '/':
+            case 'b': case 'f': case 'n': case 'r': case 't':
+                scan->state = ST_STRING;
+                break;
+            case 'u':
+                scan->state = ST_UNICODE;
+                scan->sub = 4;
+                scan->count = 0;
+                break;
+            default:
+                giveUp( scan );
+            }
+            break;
+        case ST_UNICODE: {
+            int hex = hexValue( ch );
+            ++pp;
+            if ( hex < 0 ) {
+                giveUp( scan );
+            } else {
+                scan->count = (scan->count << 4) | hex;
+                if ( 0 == --scan->sub ) {
+                    /* json-c versions differ on NULs and on surrogates */
+                    if ( 0 == scan->count
+                         || (scan->count >= 0xD800 && scan->count <= 0xDFFF) ) {
+                        giveUp( scan );
+                    } else {
+                        scan->state = ST_STRING;
+                    }
+                }
+            }
+            break;
+        }
+        case ST_NUMBER:
+            if ( numberChar( scan, ch ) ) {
+                ++pp;
+            } else if ( numberComplete( scan ) ) {
+                scan->state = ST_AFTER; /* and look at ch again there */
+            } else {
+                giveUp( scan );
+            }
+            break;
+        case ST_LITERAL:
+            if ( ch != (unsigned char)scan->literal[scan->sub] ) {
+                giveUp( scan );
+            } else {
+                ++pp;
+                if ( '\0' == scan->literal[++scan->sub] ) {
+                    scan->state = ST_AFTER;
+                }
+            }
+            break;
+        default:
+            ++pp;
+            if ( ch != ' ' && ch != '\n' && ch != '\r' && ch != '\t' ) {
+                structural( scan, ch );
+            }
+        }
+    }
+    return scan->result;
+} /* jsonScanFeed */
+
+JsonScanResult
+jsonScanFinish( JsonScan* scan )
+{
+    if ( JSONSCAN_MORE == scan->result ) {
+        scan->result = ST_DONE == scan->state
+            ? JSONSCAN_VALID : JSONSCAN_UNKNOWN;
+    }
+    return scan->result;
+}
+
+JsonScanResult
+jsonScanText( const char* text, size_t len )
+{
+    JsonScan scan;
+    jsonScanInit( &scan );
+    (void)jsonScanFeed( &scan, text, len );
+    return jsonScanFinish( &scan );
+}
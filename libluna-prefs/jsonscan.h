@@ -0,0 +1,68 @@
+// Copyright (c) 2026 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+/* -*-mode: C; fill-column: 78; c-basic-offset: 4; -*- */
+
+#ifndef _JSONSCAN_H_
+#define _JSONSCAN_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * A check that text is a json document -- a top-level object or array --
+ * that builds nothing and allocates nothing, and can be fed its text a piece
+ * at a time.
+ *
+ * It knows strict json only, and is more cautious than that about a few
+ * corners (numbers too long for an int64, \u0000 and surrogate escapes,
+ * nesting deeper than JSONSCAN_MAX_DEPTH) where json-c's behaviour has
+ * varied between versions.  Everything it calls JSONSCAN_VALID json-c
+ * accepts too; json-c also accepts things it doesn't (comments, single
+ * quotes, trailing garbage...).  So a JSONSCAN_UNKNOWN answer means "ask
+ * json-c", never "no".
+ */
+
+typedef enum {
+    JSONSCAN_MORE,      /* good so far: feed more, or finish */
+    JSONSCAN_VALID,     /* a complete strict json document */
+    JSONSCAN_UNKNOWN    /* not strict json, or not something we vouch for */
+} JsonScanResult;
+
+#define JSONSCAN_MAX_DEPTH 16   /* json-c's default limit is 32 */
+
+typedef struct JsonScan {
+    JsonScanResult result;
+    uint8_t  state;
+    uint8_t  sub;       /* progress through a number, literal or \u escape */
+    uint8_t  inKey;     /* the string being read is an object key */
+    uint8_t  depth;
+    uint16_t stack;     /* bit n set if the container at depth n+1 is an object */
+    uint16_t count;     /* digits in a number part, or a \u escape's value */
+    const char* literal;
+} JsonScan;
+
+void jsonScanInit( JsonScan* scan );
+
+/* Returns JSONSCAN_MORE until the answer is known to be JSONSCAN_UNKNOWN. */
+JsonScanResult jsonScanFeed( JsonScan* scan, const char* buf, size_t len );
+
+/* No more text: returns JSONSCAN_VALID or JSONSCAN_UNKNOWN. */
+JsonScanResult jsonScanFinish( JsonScan* scan );
+
+/* All of the above for text already in memory. */
+JsonScanResult jsonScanText( const char* text, size_t len );
+
+#endif /* #ifndef _JSONSCAN_H_ */
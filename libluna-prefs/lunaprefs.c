@@ -16,29 +16,26 @@
 /* -*-mode: C; fill-column: 78; c-basic-offset: 4; -*- */
 
 #include "lunaprefs.h"
+#include "jsonscan.h"
+#include "packvalue.h"
+#include "readcache.h"
 
 #include <glib.h>
 #include <sqlite3.h>
 #include <errno.h>
 #include <string.h>
 #include <stdio.h>
+#include <limits.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <sys/stat.h>
 #include <sys/vfs.h>
+#include <math.h>
+#include <zlib.h>
 
 #include <json.h>
 #include <nyx/nyx_client.h>
 /* todo:
- *
- * set auto-vaccuum property
- *
- * compile two parameterized statements, the getter and setter.  But where do
- * they live?  Do I keep them in globals?  Would make sense if I'm being
- * called by a service that has state, but not if I'm just an API.  Maybe
- * they're in the handle.  That'd be an optimization for the case where a
- * handle is kept across a number of get/set calls.
- *
- * Versioning.  In table name alone for now?
  *
  * Apple's API assumes app's provide their own IDs and pass them in.  Do they
  * do security checks?
@@ -64,6 +61,9 @@
  */
 
 #define PROPS_DIR "/etc/prefs/properties"
+#define APP_PREFS_DIR "/var/preferences"
+#define APP_DB_NAME "prefsDB.sl"
+#define SHARED_DB_PATH APP_PREFS_DIR "/sharedPrefsDB.sl"
 #define WHITELIST_PATH "/etc/prefs/public_properties"
 #define TOKENS_DIR "/dev/tokens"
 
@@ -87,13 +87,245 @@
 
 static const char* PALM_TOKEN_PREFIX = "com.palm.properties.";
 
+/* Parameterized statements against the data table.  Each handle compiles
+ * these lazily, the first time they're needed, and keeps them until the
+ * handle is freed, so a handle kept across a number of get/set calls pays for
+ * SQL compilation only once per statement.
+ */
+typedef enum {
+    STMT_GET,
+    STMT_GET_PATH,
+    STMT_SET,
+    STMT_REMOVE,
+    STMT_KEYS,
+    STMT_ALL,
+    STMT_KEYS_RANGE,
+    STMT_RANGE,
+    STMT_REMOVE_RANGE,
+    STMT_INCREMENT,
+    STMT_CAS_INT64,
+    STMT_SET_IF,
+    STMT_ADD,
+    STMT_MERGE,
+    STMT_ROWID,
+    STMT_SET_SPACE,
+    STMT_DATA_VERSION,
+    STMT_LOAD,
+    STMT_SAVEPOINT,
+    STMT_RELEASE,
+    STMT_ROLLBACK_TO,
+    STMT_INFO,
+    STMT_GET_IF_CHANGED,
+    STMT_SEQ,
+    STMT_CHANGED,
+    STMT_REMOVED,
+    N_STMTS
+} StmtId;
+
+/*
+ * A value column as text, unpacking it if LP_OPT_COMPRESS_MIN had it
+ * packed (see packvalue.h); and text as it's to be stored, packed if the
+ * option says so.  Statements read and write values through these so
+ * packing is invisible to everything above them.
+ */
+#define STORED_VALUE "CASE typeof( value ) WHEN 'blob'" \
+                     " THEN lp_unpack( value ) ELSE value END"
+#define STORE( text ) "lp_pack( " text " )"
+
+/*
+ * Where the shared store (see LPAppSharedStorePath) needs the appId in a
+ * statement: to qualify a WHERE, as the WHERE, and as a leading column and
+ * value in an INSERT.  They're SQL comments, so the statements run on an
+ * app's own DB as written; sharedStmtSQL() swaps in the real thing.
+ * APP_NAME is the app's name in the tables every DB keys by app (see
+ * schemaStep2()), which is '' in an app's own DB.
+ */
+#define APP_AND   "/*app_and*/"
+#define APP_WHERE "/*app_where*/"
+#define APP_COL   "/*app_col*/"
+#define APP_VAL   "/*app_val*/"
+#define APP_NAME  "/*app_name*/''"
+
+static const char* const sStmtSQL[N_STMTS] = {
+    [STMT_GET]    = "SELECT " STORED_VALUE ", flags, scalar"
+                    " FROM data WHERE " APP_AND " key = ?1;",
+    /* The value if it's json (else NULL), then the type and json text of
+       what path ?2 selects in it (NULL if nothing).  json_extract() hands
+       back true and false as 1 and 0, so those are spelled out. */
+    [STMT_GET_PATH] = "SELECT doc, json_type( doc, ?2 ),"
+                      " CASE json_type( doc, ?2 )"
+                      " WHEN 'true' THEN 'true' WHEN 'false' THEN 'false'"
+                      " ELSE json_quote( json_extract( doc, ?2 ) ) END"
+                      " FROM ( SELECT CASE WHEN json_valid( v ) THEN v END"
+                      " AS doc FROM ( SELECT " STORED_VALUE " AS v"
+                      " FROM data WHERE " APP_AND " key = ?1 ) );",
+    /* Use REPLACE, not INSERT, to avoid duplicates.  */
+    [STMT_SET]    = "REPLACE INTO data( " APP_COL " key, value, flags, scalar )"
+                    " VALUES( " APP_VAL " ?1, " STORE( "?2" ) ", ?3, ?4 );",
+    [STMT_REMOVE] = "DELETE FROM data WHERE " APP_AND " key = ?1;",
+    [STMT_KEYS]   = "SELECT key FROM data" APP_WHERE ";",
+    [STMT_ALL]    = "SELECT key, " STORED_VALUE ", flags FROM data"
+                    APP_WHERE ";",
+    /* See bindPrefixRange() for what goes in ?1 and ?2. */
+    [STMT_KEYS_RANGE]   = "SELECT key FROM data"
+                          " WHERE " APP_AND " key >= ?1 AND key < ?2"
+                          " ORDER BY key;",
+    [STMT_RANGE]        = "SELECT key, " STORED_VALUE ", flags FROM data"
+                          " WHERE " APP_AND " key >= ?1 AND key < ?2"
+                          " ORDER BY key;",
+    [STMT_REMOVE_RANGE] = "DELETE FROM data"
+                          " WHERE " APP_AND " key >= ?1 AND key < ?2;",
+    /* The atomic updates; see incrementTyped() and friends for the
+       bindings.  Each leaves rows that aren't typed int64s alone, and
+       writes the document as setScalar() would. */
+    [STMT_INCREMENT] = "INSERT INTO data"
+                       "( " APP_COL " key, value, flags, scalar )"
+                       " VALUES( " APP_VAL " ?1, '[ \"' || ?2 || '\" ]',"
+                       " ?3, ?2 )"
+                       " ON CONFLICT( " APP_COL " key ) DO UPDATE"
+                       " SET scalar = scalar + ?2,"
+                       " value = '[ \"' || (scalar + ?2) || '\" ]'"
+                       " WHERE (flags & ?4) = (?3 & ?4)"
+                       " AND typeof( scalar + ?2 ) = 'integer';",
+    [STMT_CAS_INT64] = "UPDATE data"
+                       " SET scalar = ?3, value = '[ \"' || ?3 || '\" ]'"
+                       " WHERE " APP_AND " key = ?1 AND scalar = ?2"
+                       " AND (flags & ?4) = ?5;",
+    [STMT_SET_IF]    = "UPDATE data SET value = " STORE( "?2" ) ","
+                       " flags = ?3, scalar = ?4"
+                       " WHERE " APP_AND " key = ?1"
+                       " AND " STORED_VALUE " = ?5;",
+    [STMT_ADD]       = "INSERT OR IGNORE INTO data"
+                       "( " APP_COL " key, value, flags, scalar )"
+                       " VALUES( " APP_VAL " ?1, " STORE( "?2" ) ", ?3, ?4 );",
+    /* RFC 7396 merge of patch ?2 into the stored document, or into nothing
+       if there's none.  A stored value that isn't json is left alone. */
+    [STMT_MERGE]     = "INSERT INTO data"
+                       "( " APP_COL " key, value, flags, scalar )"
+                       " VALUES( " APP_VAL " ?1,"
+                       " " STORE( "json_patch( '{}', ?2 )" ) ", ?3, NULL )"
+                       " ON CONFLICT( " APP_COL " key ) DO UPDATE"
+                       " SET value = " STORE( "json_patch( " STORED_VALUE
+                                              ", ?2 )" ) ","
+                       " flags = ?3, scalar = NULL"
+                       " WHERE json_valid( " STORED_VALUE " );",
+    /* For value streams: the row to open a blob on and whether it's packed,
+       and a new value of ?2 spaces for one to overwrite. */
+    [STMT_ROWID]     = "SELECT rowid, typeof( value ) = 'blob'"
+                       " FROM data WHERE " APP_AND " key = ?1;",
+    [STMT_SET_SPACE] = "REPLACE INTO data"
+                       "( " APP_COL " key, value, flags, scalar )"
+                       " VALUES( " APP_VAL " ?1, printf( '%*s', ?2, '' ),"
+                       " ?3, NULL );",
+    /* Changes when another connection commits; see currentCache(). */
+    [STMT_DATA_VERSION] = "PRAGMA data_version;",
+    [STMT_LOAD]         = "SELECT key, " STORED_VALUE ", flags"
+                          " FROM data" APP_WHERE " ORDER BY key;",
+    /* Batch writes nest in the handle's transaction so a failure part way
+       through undoes the batch but not what came before it. */
+    [STMT_SAVEPOINT]   = "SAVEPOINT lp_batch;",
+    [STMT_RELEASE]     = "RELEASE lp_batch;",
+    [STMT_ROLLBACK_TO] = "ROLLBACK TO lp_batch;",
+    /* A key's change stamps (see schemaStep2()), and its value only if
+       its version isn't ?2, so an unchanged value isn't read, let alone
+       unpacked. */
+    [STMT_INFO]           = "SELECT version, mtime, size"
+                            " FROM data WHERE " APP_AND " key = ?1;",
+    [STMT_GET_IF_CHANGED] = "SELECT CASE WHEN version = ?2 THEN NULL"
+                            " ELSE " STORED_VALUE " END, flags, version"
+                            " FROM data WHERE " APP_AND " key = ?1;",
+    /* For LPAppCopyChangesSince; see schemaStep3(). */
+    [STMT_SEQ]     = "SELECT last, floor FROM versions"
+                     " WHERE app = " APP_NAME ";",
+    [STMT_CHANGED] = "SELECT key, " STORED_VALUE ", flags FROM data"
+                     " WHERE " APP_AND " version > ?1 ORDER BY version;",
+    [STMT_REMOVED] = "SELECT key FROM removed"
+                     " WHERE app = " APP_NAME " AND version > ?1"
+                     " ORDER BY version;",
+};
+
+/* Bits in the data table's flags column. */
+#define VALUE_FLAG_CHECKED  0x01    /* value was a json doc when stored */
+#define VALUE_TYPE_SHIFT    1       /* then 3 bits of VALUE_TYPE_* */
+#define VALUE_TYPE_MASK     (0x07 << VALUE_TYPE_SHIFT)
+#define VALUE_TYPE(flags)   (((flags) & VALUE_TYPE_MASK) >> VALUE_TYPE_SHIFT)
+
+/* Values set through the typed setters keep their native value in the
+ * scalar column, as well as the legacy ["123"]-style json document in
+ * value that all the json getters (and older versions of this library) read.
+ * Typed getters read the scalar column and need no parsing.
+ */
+#define VALUE_TYPE_JSON     0       /* only the document; scalar is NULL */
+#define VALUE_TYPE_INT64    1
+#define VALUE_TYPE_DOUBLE   2
+#define VALUE_TYPE_BOOL     3       /* scalar is 0 or 1 */
+#define VALUE_TYPE_STRING   4
+
+/* LPAppOption settings, each one only meaningful if its bit is in set. */
+typedef struct DBOptions {
+    guint     set;
+    long long values[LP_OPT_COUNT];
+} DBOptions;
+
 typedef struct LPAppHandle_t {
     gchar*   pPath;
     sqlite3* pDb;
+    sqlite3_stmt* stmts[N_STMTS];
+    sqlite3_stmt* peeked;       /* left on a row by LPAppPeekValue */
+    DBOptions options;          /* set on this handle, override defaults */
+    DBOptions applied;          /* what pDb is currently running with */
+    ReadCache* cache;           /* of pDb's contents, for LP_OPT_READ_CACHE */
+    int      walks;             /* LPAppForEach calls under way */
+    GRecMutex lock;             /* held by each public call on the handle */
+    bool     readOnly;          /* from LPAppGetHandleReadOnly */
+    bool     shared;            /* in SHARED_DB_PATH, not pPath's own DB */
+    bool     txnEnded;          /* by LPAppCommit or LPAppRollback */
+    int      savepoints;        /* open LPAppSavepoint levels */
+    int      streams;           /* open LPAppValueStreams */
+    bool     streamWriting;     /* one of them is writing */
+    gint64   busySince;         /* when the statement waiting began */
 } LPAppHandle_t;
 
+/* Every public call that takes a handle holds its lock from after checking
+ * its arguments to its return, so threads sharing a handle take turns.  The
+ * sqlite connection therefore never sees two threads at once, and is opened
+ * without a mutex of its own.  Recursive, so callers can hold it across
+ * several calls and LPAppForEach callbacks can call back in.
+ */
+static void
+lockHandle( LPAppHandle handle )
+{
+    g_rec_mutex_lock( &((LPAppHandle_t*)handle)->lock );
+}
+
+static void
+unlockHandle( LPAppHandle handle )
+{
+    g_rec_mutex_unlock( &((LPAppHandle_t*)handle)->lock );
+}
+
+/* An open DB parked in the pool after its handle was freed, along with the
+ * statements that handle compiled.  dev/ino identify the file it was opened
+ * on so a DB that's been deleted or replaced behind our back isn't reused.
+ */
+typedef struct PooledDB {
+    gchar*   pPath;
+    sqlite3* pDb;
+    sqlite3_stmt* stmts[N_STMTS];
+    DBOptions applied;
+    ReadCache* cache;
+    bool     readOnly;          /* pooled apart from read-write DBs */
+    bool     shared;            /* and from the shared store */
+    dev_t    dev;
+    ino_t    ino;
+    gint64   lastUsed;
+} PooledDB;
+
+#define POOL_DEFAULT_MAX_OPEN      8
+#define POOL_DEFAULT_IDLE_SECONDS 30
+
 static LPErr openDB( LPAppHandle_t* handle );
-static LPErr addTable( LPAppHandle_t* handle );
+static LPErr connectDB( LPAppHandle_t* handle );
 static LPErr LPSystemCopyAllCJ_impl( struct json_object** json,
                                      bool onPublicBus );
 static LPErr LPSystemCopyKeysCJ_impl( struct json_object** json,
@@ -111,6 +343,12 @@ is_toplevel_json( const struct json_object* jobj )
 static bool
 check_is_json( const char* text )
 {
+    /* Almost everything stored is strict json, which jsonScanText() can vouch
+       for without building a DOM.  json-c has the final say on the rest. */
+    if ( JSONSCAN_VALID == jsonScanText( text, strlen( text ) ) ) {
+        return true;
+    }
+
     struct json_object* jobj = json_tokener_parse( text );
     bool isJson =  jobj ;
     if ( isJson ) {
@@ -180,6 +418,44 @@ strToJsonWithCheck( const char* jstr, struct json_object** json )
     return err;
 }
 
+/* Append str to gstr as a quoted json string, escaped as json-c does. */
+static void
+appendJsonString( GString* gstr, const char* str )
+{
+    const char* ch;
+    g_string_append_c( gstr, '"' );
+    for ( ch = str; *ch; ++ch ) {
+        switch ( *ch ) {
+        case '"':  g_string_append( gstr, "\\\"" ); break;
+        case '\\': g_string_append( gstr, "\\\\" ); break;
+        case '/':  g_string_append( gstr, "\\/" ); break;
+        case '\b': g_string_append( gstr, "\\b" ); break;
+        case '\f': g_string_append( gstr, "\\f" ); break;
+        case '\n': g_string_append( gstr, "\\n" ); break;
+        case '\r': g_string_append( gstr, "\\r" ); break;
+        case '\t': g_string_append( gstr, "\\t" ); break;
+        default:
+            if ( (unsigned char)*ch < 0x20 ) {
+                g_string_append_printf( gstr, "\\u%04x", *ch );
+            } else {
+                g_string_append_c( gstr, *ch );
+            }
+        }
+    }
+    g_string_append_c( gstr, '"' );
+} /* appendJsonString */
+
+/*
+ * Values stored through this library are checked on the way in and marked
+ * as such; only others (e.g. restored from a backup) need checking on the
+ * way out.
+ */
+static bool
+storedValueOK( const char* value, int flags )
+{
+    return (flags & VALUE_FLAG_CHECKED) || check_is_json( value );
+}
+
 static LPErr
 sqlerr_to_lperr( int err )
 {
@@ -188,17 +464,33 @@ sqlerr_to_lperr( int err )
         lperr = LP_ERR_NONE;
     } else if ( SQLITE_BUSY == err ) {
         lperr = LP_ERR_BUSY;
+    } else if ( SQLITE_READONLY == err ) {
+        lperr = LP_ERR_PERM;    /* a write through a read-only handle */
     } else {
         lperr = LP_ERR_DBERROR;
     }
     return lperr;
 }
 
+/*
+ * A value handed out by LPAppPeekValue lives in its statement's row buffer;
+ * it's good until the next call that uses the handle, which ends it here.
+ */
+static void
+endPeek( LPAppHandle_t* handle )
+{
+    if ( NULL != handle->peeked ) {
+        (void)sqlite3_reset( handle->peeked );
+        handle->peeked = NULL;
+    }
+}
+
 static LPErr
-runSQL( LPAppHandle_t* handle, bool canAddTable,
+runSQL( LPAppHandle_t* handle,
         int (*callback)(void*,int,char**,char**), void* context,
         const char* fmt, ... )
 {
+    endPeek( handle );
     LPErr lperr = openDB( handle );
     if ( LP_ERR_NONE == lperr ) {
         va_list ap;
@@ -206,25 +498,13 @@ runSQL( LPAppHandle_t* handle, bool canAddTable,
         char* stmt = sqlite3_vmprintf( fmt, ap );
         va_end( ap );
         g_assert( !!stmt );
-        char* errmsg;
-        int err;
-    again:
-        errmsg = NULL;
-        err = sqlite3_exec( handle->pDb, stmt,
-                            callback, context,
-                            &errmsg );
+        char* errmsg = NULL;
+        int err = sqlite3_exec( handle->pDb, stmt,
+                                callback, context,
+                                &errmsg );
 
         if ( SQLITE_OK != err )
         {
-            if ( SQLITE_ERROR == err && canAddTable )
-            {
-                if ( LP_ERR_NONE == addTable( handle ) )
-                {
-                    sqlite3_free( errmsg ); /* no-op if NULL */
-                    canAddTable = false;
-                    goto again;
-                }
-            }
             if ( NULL != errmsg )
             {
                 fprintf( stderr, "sqlite3_exec(\"%s\")=>%d/\"%s\"\n", stmt, err, errmsg );
@@ -239,421 +519,4150 @@ runSQL( LPAppHandle_t* handle, bool canAddTable,
     return lperr;
 } /* runSQL */
 
-static LPErr
-addTable( LPAppHandle_t* handle )
+/*****************************************************************************
+* Schema
+*
+* A DB's PRAGMA user_version is how many of sSchemaSteps it has had; a new
+* file starts at 0.  migrateSchema() runs the ones it's missing, once, in a
+* write transaction, when a read-write connection opens it, so statements
+* can count on the table being there and current.  A read-only connection
+* to a DB that's behind has a read-write one do it first (see
+* openReadOnly()).  DBs from before versioning are at 0 too, whatever their
+* table looks like, so step 1 has to take them as it finds them.
+*****************************************************************************/
+
+/* The shared store's table: every app's rows, each keyed by its appId too. */
+#define SHARED_TABLE_SQL "CREATE TABLE IF NOT EXISTS data( app TEXT NOT NULL," \
+    " key TEXT NOT NULL, value TEXT, flags INTEGER NOT NULL DEFAULT 0," \
+    " scalar, PRIMARY KEY( app, key ) );"
+
+/*
+ * DBs from before values carried flags and typed values have fewer columns
+ * in their data table.  New flags start out 0, so the old values get
+ * checked when read and are typed VALUE_TYPE_JSON.
+ */
+static const char* const sColumns[][2] = {
+    { "flags",  "flags INTEGER NOT NULL DEFAULT 0" },
+    { "scalar", "scalar" },    /* no type, so no conversions */
+};
+#define N_COLUMNS G_N_ELEMENTS( sColumns )
+
+/* Whether the data table exists, and if so which of sColumns it has. */
+static bool
+readColumns( sqlite3* pDb, bool has[N_COLUMNS] )
 {
-    LPErr err = runSQL( handle, false, NULL, NULL,
-                        "CREATE TABLE IF NOT EXISTS data( key TEXT PRIMARY KEY, value TEXT );" );
+    bool hasTable = false;
+    sqlite3_stmt* stmt;
+    int ii;
+    memset( has, 0, N_COLUMNS * sizeof(has[0]) );
+    int err = sqlite3_prepare_v2( pDb, "PRAGMA table_info( data );",
+                                  -1, &stmt, NULL );
+    if ( SQLITE_OK == err ) {
+        while ( SQLITE_ROW == sqlite3_step( stmt ) ) {
+            const char* column = (const char*)sqlite3_column_text( stmt, 1 );
+            hasTable = true;
+            for ( ii = 0; ii < N_COLUMNS; ++ii ) {
+                has[ii] = has[ii] || 0 == g_strcmp0( column, sColumns[ii][0] );
+            }
+        }
+        (void)sqlite3_finalize( stmt );
+    }
+    return hasTable;
+}
+
+/* Step 1: the data table, or the columns an older one is missing. */
+static int
+schemaStep1( sqlite3* pDb, bool shared )
+{
+    bool has[N_COLUMNS];
+    int err = SQLITE_OK;
+    int ii;
+    if ( shared ) {
+        err = sqlite3_exec( pDb, SHARED_TABLE_SQL, NULL, NULL, NULL );
+    } else if ( !readColumns( pDb, has ) ) {
+        err = sqlite3_exec( pDb, "CREATE TABLE data( key TEXT PRIMARY KEY,"
+                            " value TEXT, flags INTEGER NOT NULL DEFAULT 0,"
+                            " scalar );", NULL, NULL, NULL );
+    } else {
+        for ( ii = 0; SQLITE_OK == err && ii < N_COLUMNS; ++ii ) {
+            if ( !has[ii] ) {
+                gchar* sql = g_strdup_printf( "ALTER TABLE data ADD COLUMN %s;",
+                                              sColumns[ii][1] );
+                err = sqlite3_exec( pDb, sql, NULL, NULL, NULL );
+                g_free( sql );
+            }
+        }
+    }
+    return err;
+} /* schemaStep1 */
+
+/*
+ * A value's length as text: a TEXT value's in bytes, and a packed one's
+ * from its 4-byte big-endian header (see packvalue.h), spelled out in
+ * built-in SQL so that the triggers below run on any connection, not just
+ * ours with lp_unpack() defined.
+ */
+#define HEADER_NIBBLE( v, n ) "(instr( '0123456789ABCDEF'," \
+    " substr( hex( substr( " v ", 1, 4 ) ), " #n ", 1 ) ) - 1)"
+#define VALUE_SIZE( v ) "CASE typeof( " v " ) WHEN 'blob' THEN" \
+    " (((((((" HEADER_NIBBLE( v, 1 ) " * 16 + " HEADER_NIBBLE( v, 2 ) ")" \
+    " * 16 + " HEADER_NIBBLE( v, 3 ) ") * 16 + " HEADER_NIBBLE( v, 4 ) ")" \
+    " * 16 + " HEADER_NIBBLE( v, 5 ) ") * 16 + " HEADER_NIBBLE( v, 6 ) ")" \
+    " * 16 + " HEADER_NIBBLE( v, 7 ) ") * 16 + " HEADER_NIBBLE( v, 8 ) ")" \
+    " ELSE length( CAST( " v " AS BLOB ) ) END"
+
+/* ms since the epoch */
+#define NOW_MS "CAST( (julianday( 'now' ) - 2440587.5) * 86400000" \
+    " AS INTEGER )"
+
+/*
+ * An app's first version, at random in 1..2^62: one whose DB is deleted
+ * and made again starts somewhere else entirely, so it doesn't reuse the
+ * old DB's versions, which nothing of the old DB is left to say.  Starting
+ * from the time wouldn't do: the clock can go back, and an app can write
+ * faster than once a ms.  Either way 2^62 versions are left to count up.
+ */
+#define FIRST_VERSION "(1 + (random() & 4611686018427387903))"
+
+/*
+ * Stamp a row just written with the time, its size, and the next of its
+ * app's versions, kept in the versions table so they never go back even as
+ * keys come and go.  An app's first write starts them at FIRST_VERSION.
+ * %s is the row's app: NEW.app in the shared store, '' in an app's own DB.
+ */
+#define STAMP_SQL \
+    " INSERT INTO versions( app, last ) VALUES( %s, " FIRST_VERSION " )" \
+    " ON CONFLICT( app ) DO UPDATE SET last = last + 1;" \
+    " UPDATE data SET mtime = " NOW_MS "," \
+    " version = ( SELECT last FROM versions WHERE app = %s )," \
+    " size = " VALUE_SIZE( "NEW.value" ) " WHERE rowid = NEW.rowid;"
+
+/*
+ * Step 2: per-key change stamps, for LPAppGetValueInfo and
+ * LPAppCopyValueIfChanged.  Kept by triggers rather than by our statements
+ * so that every writer keeps them -- restores, the sqlite3 shell, older
+ * versions of this library -- and none can change a value without its
+ * version moving.  Value streams write in place, but only after a
+ * STMT_SET_SPACE that stamps the row.  Existing rows start at version 0,
+ * their mtimes unknown.
+ */
+static int
+schemaStep2( sqlite3* pDb, bool shared )
+{
+    const char* app = shared ? "NEW.app" : "''";
+    char* sql = sqlite3_mprintf(
+        "ALTER TABLE data ADD COLUMN mtime INTEGER;"
+        " ALTER TABLE data ADD COLUMN version INTEGER;"
+        " ALTER TABLE data ADD COLUMN size INTEGER;"
+        " UPDATE data SET version = 0, size = " VALUE_SIZE( "value" ) ";"
+        " CREATE TABLE versions( app TEXT PRIMARY KEY,"
+        " last INTEGER NOT NULL );"
+        " CREATE TRIGGER stamp_insert AFTER INSERT ON data"
+        " BEGIN" STAMP_SQL " END;"
+        " CREATE TRIGGER stamp_update AFTER UPDATE OF value, flags, scalar"
+        " ON data BEGIN" STAMP_SQL " END;",
+        app, app, app, app );
+    int err = NULL == sql ? SQLITE_NOMEM
+        : sqlite3_exec( pDb, sql, NULL, NULL, NULL );
+    sqlite3_free( sql );
+    return err;
+} /* schemaStep2 */
+
+/*
+ * Step 3: a change history, for LPAppCopyChangesSince.  Rows changed since
+ * a version are the ones stamped above it; removed keys leave a tombstone
+ * in removed, stamped the same way, until set again.  versions.floor is the
+ * oldest version the history answers for: an app's first write starts it,
+ * and for DBs from before tombstones it's where they started.  The step 2
+ * triggers are replaced by ones that also keep removed; as before %s is the
+ * row's app, here an old row's (OLD.app) for a delete.
+ */
+#define BUMP_SQL( app ) \
+    " INSERT INTO versions( app, last )" \
+    " VALUES( " app ", " FIRST_VERSION " )" \
+    " ON CONFLICT( app ) DO UPDATE SET last = last + 1;" \
+    " UPDATE versions SET floor = last - 1" \
+    " WHERE app = " app " AND floor IS NULL;"
+#define STAMP3_SQL BUMP_SQL( "%s" ) \
+    " UPDATE data SET mtime = " NOW_MS "," \
+    " version = ( SELECT last FROM versions WHERE app = %s )," \
+    " size = " VALUE_SIZE( "NEW.value" ) " WHERE rowid = NEW.rowid;"
+
+static int
+schemaStep3( sqlite3* pDb, bool shared )
+{
+    const char* app = shared ? "NEW.app" : "''";
+    const char* oldApp = shared ? "OLD.app" : "''";
+    char* sql = sqlite3_mprintf(
+        "ALTER TABLE versions ADD COLUMN floor INTEGER;"
+        " UPDATE versions SET floor = last;"
+        " CREATE TABLE removed( app TEXT NOT NULL, key TEXT NOT NULL,"
+        " version INTEGER NOT NULL, PRIMARY KEY( app, key ) );"
+        " CREATE INDEX removed_by_version ON removed( app, version );"
+        " CREATE INDEX data_by_version ON data( %s version );"
+        " DROP TRIGGER stamp_insert;"
+        " DROP TRIGGER stamp_update;"
+        " CREATE TRIGGER stamp_insert AFTER INSERT ON data BEGIN" STAMP3_SQL
+        " DELETE FROM removed WHERE app = %s AND key = NEW.key; END;"
+        " CREATE TRIGGER stamp_update AFTER UPDATE OF value, flags, scalar"
+        " ON data BEGIN" STAMP3_SQL " END;"
+        " CREATE TRIGGER stamp_delete AFTER DELETE ON data BEGIN"
+        BUMP_SQL( "%s" )
+        " REPLACE INTO removed( app, key, version ) VALUES( %s, OLD.key,"
+        " ( SELECT last FROM versions WHERE app = %s ) ); END;",
+        shared ? "app," : "", app, app, app, app, app, app, app,
+        oldApp, oldApp, oldApp, oldApp );
+    int err = NULL == sql ? SQLITE_NOMEM
+        : sqlite3_exec( pDb, sql, NULL, NULL, NULL );
+    sqlite3_free( sql );
     return err;
+} /* schemaStep3 */
+
+typedef int (*SchemaStep)( sqlite3* pDb, bool shared );
+
+static const SchemaStep sSchemaSteps[] = {
+    schemaStep1,
+    schemaStep2,
+    schemaStep3,
+};
+#define SCHEMA_VERSION ((int)G_N_ELEMENTS( sSchemaSteps ))
+
+/* pDb's user_version, or -1 if it can't be read. */
+static int
+schemaVersion( sqlite3* pDb )
+{
+    int version = -1;
+    sqlite3_stmt* stmt;
+    if ( SQLITE_OK == sqlite3_prepare_v2( pDb, "PRAGMA user_version;", -1,
+                                          &stmt, NULL ) ) {
+        if ( SQLITE_ROW == sqlite3_step( stmt ) ) {
+            version = sqlite3_column_int( stmt, 0 );
+        }
+        (void)sqlite3_finalize( stmt );
+    }
+    return version;
 }
 
 /*
- * Open the sqlite DB if it isn't already open.  Since there are ways to wind
- * up with a DB file that exists but doesn't have a table, we're prepared to
- * add a table in reponse to errors on read or write.  Thus we don't add one
- * here.
+ * Bring pDb up to SCHEMA_VERSION, outside any transaction of the caller's.
+ * A DB from a newer version of this library is left alone.
+ */
+static int
+migrateSchema( sqlite3* pDb, bool shared )
+{
+    int err = SQLITE_OK;
+    if ( schemaVersion( pDb ) < SCHEMA_VERSION ) {
+        /* Lets LPAppReclaimSpace shrink the file.  Only takes on a DB
+           that's still empty: it can't be set in a transaction, nor once
+           anything, a change of journal mode included, has written the
+           header.  Older DBs stay as they are. */
+        (void)sqlite3_exec( pDb, "PRAGMA auto_vacuum = INCREMENTAL;",
+                            NULL, NULL, NULL );
+        err = sqlite3_exec( pDb, "BEGIN IMMEDIATE;", NULL, NULL, NULL );
+        if ( SQLITE_OK == err ) {
+            /* again: another connection may have done it while we waited */
+            int version = schemaVersion( pDb );
+            if ( version < 0 ) {
+                err = SQLITE_ERROR;
+            }
+            for ( ; SQLITE_OK == err && version < SCHEMA_VERSION; ++version ) {
+                err = sSchemaSteps[version]( pDb, shared );
+            }
+            if ( SQLITE_OK == err ) {
+                char* sql = sqlite3_mprintf( "PRAGMA user_version = %d;"
+                                             " COMMIT;", version );
+                err = sqlite3_exec( pDb, sql, NULL, NULL, NULL );
+                sqlite3_free( sql );
+            }
+            if ( SQLITE_OK != err ) {
+                g_warning( "%s: %s: %s", __func__,
+                           sqlite3_db_filename( pDb, "main" ),
+                           sqlite3_errmsg( pDb ) );
+                (void)sqlite3_exec( pDb, "ROLLBACK;", NULL, NULL, NULL );
+            }
+        }
+    }
+    return err;
+} /* migrateSchema */
+
+/*
+ * sStmtSQL for the shared store: the APP_* markers replaced by SQL that
+ * limits each statement to the rows of the connection's app, which
+ * lp_app() returns (see openFile()).  Built the first time it's needed.
+ */
+static const char*
+sharedStmtSQL( StmtId id )
+{
+    static const char* const sReplacements[][2] = {
+        { APP_AND,   "app = lp_app() AND" },
+        { APP_WHERE, " WHERE app = lp_app()" },
+        { APP_COL,   "app," },
+        { APP_VAL,   "lp_app()," },
+        { APP_NAME,  "lp_app()" },
+    };
+    static gchar* sSQL[N_STMTS];
+    static gsize sBuilt = 0;
+
+    if ( g_once_init_enter( &sBuilt ) ) {
+        int ii, jj;
+        for ( ii = 0; ii < N_STMTS; ++ii ) {
+            gchar* sql = g_strdup( sStmtSQL[ii] );
+            for ( jj = 0; jj < G_N_ELEMENTS( sReplacements ); ++jj ) {
+                gchar** parts = g_strsplit( sql, sReplacements[jj][0], -1 );
+                g_free( sql );
+                sql = g_strjoinv( sReplacements[jj][1], parts );
+                g_strfreev( parts );
+            }
+            sSQL[ii] = sql;
+        }
+        g_once_init_leave( &sBuilt, 1 );
+    }
+    return sSQL[id];
+} /* sharedStmtSQL */
+
+/*
+ * Return the compiled statement for id, compiling it first if this handle
+ * hasn't needed it yet.  The statement comes back reset and ready to be
+ * bound; callers must sqlite3_reset() it when done so it doesn't hold the
+ * DB's read lock.
  */
 static LPErr
-openDB( LPAppHandle_t* handle )
+getStmt( LPAppHandle_t* handle, StmtId id, sqlite3_stmt** stmt )
 {
-    LPErr err = LP_ERR_NONE;
-    if ( handle->pDb == NULL ) {
-        if ( handle->pPath == NULL ) {
-            err = LP_ERR_INVALID_HANDLE;
+    endPeek( handle );
+    LPErr lperr = openDB( handle );
+    if ( LP_ERR_NONE == lperr && NULL == handle->stmts[id] ) {
+        const char* sql = handle->shared ? sharedStmtSQL( id ) : sStmtSQL[id];
+        int err = sqlite3_prepare_v2( handle->pDb, sql, -1,
+                                      &handle->stmts[id], NULL );
+        if ( SQLITE_OK != err ) {
+            fprintf( stderr, "sqlite3_prepare_v2(\"%s\")=>%d/\"%s\"\n",
+                     sql, err, sqlite3_errmsg( handle->pDb ) );
+            handle->stmts[id] = NULL;
+        }
+        lperr = sqlerr_to_lperr( err );
+    }
+    *stmt = handle->stmts[id];
+    return lperr;
+} /* getStmt */
+
+/*
+ * Step a statement that returns no rows (or whose rows don't interest us)
+ * and reset it for next time.
+ */
+static LPErr
+stepDone( sqlite3_stmt* stmt )
+{
+    int err = sqlite3_step( stmt );
+    if ( SQLITE_DONE == err || SQLITE_ROW == err ) {
+        err = SQLITE_OK;
+    }
+    (void)sqlite3_reset( stmt );
+    return sqlerr_to_lperr( err );
+}
+
+static void
+finalizeStmts( LPAppHandle_t* handle )
+{
+    int ii;
+    handle->peeked = NULL;
+    for ( ii = 0; ii < N_STMTS; ++ii ) {
+        sqlite3_finalize( handle->stmts[ii] ); /* no-op if NULL */
+        handle->stmts[ii] = NULL;
+    }
+    /* and what they read */
+    readCacheFree( handle->cache );
+    handle->cache = NULL;
+}
+
+/*****************************************************************************
+* DB pool
+*
+* Opening an app DB means creating its directory, opening the file and
+* compiling statements against it; for a service that gets and frees a handle
+* per request that dominates the cost of the request.  So instead of closing
+* a DB when its handle is freed (after the commit or rollback, so it holds no
+* locks) we park it here, most recently used first, and the next handle on
+* the same appId picks it up.  The pool is bounded by count, to keep an upper
+* limit on the fds we hold, and by age: DBs idle longer than the limit are
+* closed the next time the pool is touched.
+*****************************************************************************/
+
+G_LOCK_DEFINE_STATIC( pool );
+static GQueue sPool = G_QUEUE_INIT;
+static guint sPoolMaxOpen = POOL_DEFAULT_MAX_OPEN;
+static guint sPoolIdleSeconds = POOL_DEFAULT_IDLE_SECONDS;
+
+static void
+closePooled( gpointer data )
+{
+    PooledDB* pooled = (PooledDB*)data;
+    int ii;
+    for ( ii = 0; ii < N_STMTS; ++ii ) {
+        sqlite3_finalize( pooled->stmts[ii] );
+    }
+    readCacheFree( pooled->cache );
+    (void)sqlite3_close( pooled->pDb );
+    g_free( pooled->pPath );
+    g_free( pooled );
+}
+
+/* Move DBs that are over budget or have been idle too long from the pool to
+ * victims.  Call with the pool lock held; close the victims once it's
+ * dropped.
+ */
+static void
+trimPoolLocked( GQueue* victims, bool all )
+{
+    gint64 idleBefore = g_get_monotonic_time()
+        - (gint64)sPoolIdleSeconds * G_USEC_PER_SEC;
+    PooledDB* oldest;
+    while ( NULL != (oldest = g_queue_peek_tail( &sPool )) ) {
+        if ( all || g_queue_get_length( &sPool ) > sPoolMaxOpen
+             || oldest->lastUsed < idleBefore ) {
+            g_queue_push_tail( victims, g_queue_pop_tail( &sPool ) );
         } else {
-            (void)g_mkdir_with_parents( handle->pPath, S_IRWXU | S_IRWXG );
-            gchar* fullPath = g_strdup_printf( "%s/prefsDB.sl", handle->pPath );
+            break;
+        }
+    }
+}
+
+static void
+closeVictims( GQueue* victims )
+{
+    PooledDB* pooled;
+    while ( NULL != (pooled = g_queue_pop_head( victims )) ) {
+        closePooled( pooled );
+    }
+}
 
-            sqlite3* pDb;
-            int result = sqlite3_open( fullPath, &pDb );
-            if ( result == 0 ) {
-                handle->pDb = pDb; /* assign this before calling runSQL()!!! */
+/* The file holding the DB of the app whose directory is dir. */
+static gchar*
+dbFilePath( const gchar* dir, bool shared )
+{
+    return shared ? g_strdup( SHARED_DB_PATH )
+        : g_strdup_printf( "%s/" APP_DB_NAME, dir );
+}
 
-                err = runSQL( handle, false, NULL, NULL, "BEGIN;" ); /* begin a transaction */
-            } else {
-                err = sqlerr_to_lperr( result );
+static bool
+statDB( const gchar* dir, bool shared, struct stat* st )
+{
+    gchar* fullPath = dbFilePath( dir, shared );
+    bool found = 0 == stat( fullPath, st );
+    g_free( fullPath );
+    return found;
+}
+
+/* Whether a pooled DB is the one handle would open. */
+static bool
+pooledMatches( const PooledDB* pooled, const LPAppHandle_t* handle )
+{
+    return 0 == strcmp( pooled->pPath, handle->pPath )
+        && pooled->readOnly == handle->readOnly
+        && pooled->shared == handle->shared;
+}
+
+/* Hand a pooled DB for handle's path, if there is one, over to handle. */
+static bool
+takeFromPool( LPAppHandle_t* handle )
+{
+    GQueue victims = G_QUEUE_INIT;
+    PooledDB* pooled = NULL;
+    GList* link;
+
+    G_LOCK( pool );
+    trimPoolLocked( &victims, false );
+    for ( link = sPool.head; !!link; link = link->next ) {
+        if ( pooledMatches( link->data, handle ) ) {
+            pooled = (PooledDB*)link->data;
+            g_queue_delete_link( &sPool, link );
+            break;
+        }
+    }
+    G_UNLOCK( pool );
+    closeVictims( &victims );
+
+    bool taken = false;
+    if ( NULL != pooled ) {
+        struct stat st;
+        if ( statDB( pooled->pPath, pooled->shared, &st )
+             && st.st_dev == pooled->dev && st.st_ino == pooled->ino ) {
+            handle->pDb = pooled->pDb;
+            memcpy( handle->stmts, pooled->stmts, sizeof(handle->stmts) );
+            handle->applied = pooled->applied;
+            handle->cache = pooled->cache;
+            g_free( pooled->pPath );
+            g_free( pooled );
+            taken = true;
+        } else {
+            /* cleared or replaced since we parked it */
+            closePooled( pooled );
+        }
+    }
+    return taken;
+} /* takeFromPool */
+
+/* Park handle's DB in the pool.  Returns false, leaving the DB with the
+ * handle, if pooling is off or there's no room for it.
+ */
+static bool
+returnToPool( LPAppHandle_t* handle )
+{
+    struct stat st;
+    if ( !statDB( handle->pPath, handle->shared, &st ) ) {
+        return false;
+    } else if ( !sqlite3_get_autocommit( handle->pDb ) ) {
+        return false;   /* a transaction's still open: closing ends it */
+    }
+
+    PooledDB* pooled = g_new0( PooledDB, 1 );
+    pooled->pPath = handle->pPath;
+    pooled->pDb = handle->pDb;
+    memcpy( pooled->stmts, handle->stmts, sizeof(pooled->stmts) );
+    pooled->applied = handle->applied;
+    pooled->cache = handle->cache;
+    pooled->readOnly = handle->readOnly;
+    pooled->shared = handle->shared;
+    pooled->dev = st.st_dev;
+    pooled->ino = st.st_ino;
+    pooled->lastUsed = g_get_monotonic_time();
+
+    GQueue victims = G_QUEUE_INIT;
+    bool parked = false;
+    GList* link;
+
+    G_LOCK( pool );
+    if ( sPoolMaxOpen > 0 ) {
+        parked = true;
+        for ( link = sPool.head; !!link; link = link->next ) {
+            if ( pooledMatches( link->data, handle ) ) {
+                parked = false; /* one per appId and mode is plenty */
+                break;
             }
-            g_free( fullPath );
         }
     }
-    return err;
-} /* openDB */
+    if ( parked ) {
+        g_queue_push_head( &sPool, pooled );
+        trimPoolLocked( &victims, false );
+    }
+    G_UNLOCK( pool );
+    closeVictims( &victims );
+
+    if ( parked ) {
+        handle->pPath = NULL;   /* pool owns these now */
+        handle->pDb = NULL;
+        memset( handle->stmts, 0, sizeof(handle->stmts) );
+        handle->cache = NULL;
+    } else {
+        g_free( pooled );
+    }
+    return parked;
+} /* returnToPool */
 
-LPErr
-LPAppClearData( const char* appId )
+/* Close any pooled DB for dir; it's about to go away. */
+static void
+evictFromPool( const gchar* dir )
 {
-    gchar* path = g_strdup_printf( "/var/preferences/%s/prefsDB.sl", appId );
-    int err = -1;
-    if (path) {
-        err = unlink( path );
-        g_free( path );
+    GQueue victims = G_QUEUE_INIT;
+    GList* link;
+    GList* next;
+
+    G_LOCK( pool );
+    for ( link = sPool.head; !!link; link = next ) {
+        next = link->next;
+        if ( 0 == strcmp( ((PooledDB*)link->data)->pPath, dir ) ) {
+            g_queue_push_tail( &victims, link->data );
+            g_queue_delete_link( &sPool, link );
+        }
     }
-    return (err == 0)? LP_ERR_NONE : LP_ERR_PARAM_ERR;
+    G_UNLOCK( pool );
+    closeVictims( &victims );
 }
 
 LPErr
-LPAppGetHandle( const char* appId, LPAppHandle* handle )
+LPAppSetPoolLimits( unsigned int maxOpen, unsigned int idleSeconds )
 {
-    g_return_val_if_fail( handle != NULL, -EINVAL );
-    *handle = NULL;
+    GQueue victims = G_QUEUE_INIT;
 
-    g_return_val_if_fail( appId != NULL, -EINVAL );
-
-    LPAppHandle_t* hndl = g_new0( LPAppHandle_t, 1 );
-    if (hndl) {
-        hndl->pPath = g_strdup_printf( "/var/preferences/%s", appId );
-        *handle = (LPAppHandle)hndl;
-    }
+    G_LOCK( pool );
+    sPoolMaxOpen = maxOpen;
+    sPoolIdleSeconds = idleSeconds;
+    trimPoolLocked( &victims, false );
+    G_UNLOCK( pool );
+    closeVictims( &victims );
 
-    return 0;
-} /* LPAppGetHandle */
+    return LP_ERR_NONE;
+}
 
 LPErr
-LPAppFreeHandle( LPAppHandle handle, bool commit )
+LPAppTrimPool( bool closeAll )
 {
-    LPErr lperr = LP_ERR_NONE;
-    g_return_val_if_fail( handle != NULL, -EINVAL );
-    LPAppHandle_t* hndl = (LPAppHandle_t*)handle;
+    GQueue victims = G_QUEUE_INIT;
+
+    G_LOCK( pool );
+    trimPoolLocked( &victims, closeAll );
+    G_UNLOCK( pool );
+    closeVictims( &victims );
+
+    return LP_ERR_NONE;
+}
+
+/*****************************************************************************
+* Packed values
+*
+* lp_pack() and lp_unpack(), the SQL functions behind STORE() and
+* STORED_VALUE, are defined on each connection as it's opened.  lp_pack()
+* finds its LP_OPT_COMPRESS_MIN setting in its user data, so applying the
+* option redefines it.
+*****************************************************************************/
 
-    if ( hndl->pDb ) {
-        lperr = runSQL( handle, false, NULL, NULL, "%s;", (commit?"COMMIT":"ROLLBACK") );
-        if ( LP_ERR_NONE == lperr ) {
-            lperr = sqlerr_to_lperr(sqlite3_close( hndl->pDb ) );
-            hndl->pDb = NULL;
+static void
+packFunc( sqlite3_context* ctx, int argc, sqlite3_value** argv )
+{
+    const size_t* minLen = sqlite3_user_data( ctx );
+    uint8_t* packed = NULL;
+    size_t packedLen;
+    if ( NULL != minLen && SQLITE_TEXT == sqlite3_value_type( argv[0] ) ) {
+        const char* text = (const char*)sqlite3_value_text( argv[0] );
+        size_t len = sqlite3_value_bytes( argv[0] );
+        if ( len >= *minLen ) {
+            packed = packValue( text, len, &packedLen );
         }
     }
+    if ( NULL != packed ) {
+        sqlite3_result_blob64( ctx, packed, packedLen, free );
+    } else {
+        sqlite3_result_value( ctx, argv[0] );
+    }
+} /* packFunc */
 
-    g_free( hndl->pPath );
-    g_free( hndl );
-    return lperr;
+static void
+unpackFunc( sqlite3_context* ctx, int argc, sqlite3_value** argv )
+{
+    size_t len;
+    char* text = unpackValue( sqlite3_value_blob( argv[0] ),
+                              sqlite3_value_bytes( argv[0] ), &len );
+    if ( NULL != text ) {
+        sqlite3_result_text64( ctx, text, len, free, SQLITE_UTF8 );
+    } else {
+        sqlite3_result_error( ctx, "lp_unpack: damaged value", -1 );
+    }
+} /* unpackFunc */
+
+/* (Re)define lp_pack() to pack text of minLen bytes or more; 0 for none. */
+static int
+setPackMin( sqlite3* pDb, long long minLen )
+{
+    size_t* data = NULL;
+    if ( minLen > 0 ) {
+        data = g_new( size_t, 1 );
+        *data = minLen;
+    }
+    return sqlite3_create_function_v2( pDb, "lp_pack", 1,
+                                       SQLITE_UTF8 | SQLITE_DETERMINISTIC,
+                                       data, packFunc, NULL, NULL, g_free );
 }
 
 static int
-getValue( void* context, int nColumns, char** colValues, char** colNames )
+definePackFuncs( sqlite3* pDb )
 {
-    g_assert( nColumns == 1 );    /* I asked for one column, not '*' */
-    gchar** result = (gchar**)context;
-    *result = g_strdup( colValues[0] );
-    return 0;      /* non-0 return aborts, but causes sqlite3_exec to return
-                      SQLITE_ABORT  */
+    int err = setPackMin( pDb, 0 );
+    if ( SQLITE_OK == err ) {
+        err = sqlite3_create_function_v2( pDb, "lp_unpack", 1,
+                                          SQLITE_UTF8 | SQLITE_DETERMINISTIC,
+                                          NULL, unpackFunc, NULL, NULL, NULL );
+    }
+    return err;
 }
 
 LPErr
-LPAppCopyValue( LPAppHandle handle, const char* key, char** jstr )
+LPAppUnpackStoredValue( const void* stored, size_t len, char** jstr )
+{
+    g_return_val_if_fail( stored != NULL, -EINVAL );
+    g_return_val_if_fail( jstr != NULL, -EINVAL );
+
+    LPErr err = LP_ERR_NONE;
+    size_t textLen;
+    char* text = unpackValue( stored, len, &textLen );
+    if ( NULL == text ) {
+        err = LP_ERR_VALUENOTJSON;
+    } else {
+        *jstr = g_strndup( text, textLen );
+        free( text );
+    }
+    return err;
+} /* LPAppUnpackStoredValue */
+
+/*****************************************************************************
+* DB options
+*****************************************************************************/
+
+G_LOCK_DEFINE_STATIC( options );
+static DBOptions sDefaultOptions;
+
+static const char* const sJournalModes[] = {
+    [LP_JOURNAL_DELETE]   = "DELETE",
+    [LP_JOURNAL_TRUNCATE] = "TRUNCATE",
+    [LP_JOURNAL_PERSIST]  = "PERSIST",
+    [LP_JOURNAL_WAL]      = "WAL",
+};
+
+static bool
+optionValueOK( LPAppOption option, long long value )
+{
+    bool ok;
+    switch ( option ) {
+    case LP_OPT_JOURNAL_MODE:
+        ok = value >= LP_JOURNAL_DELETE && value <= LP_JOURNAL_WAL;
+        break;
+    case LP_OPT_SYNCHRONOUS:
+        ok = value >= LP_SYNC_OFF && value <= LP_SYNC_EXTRA;
+        break;
+    case LP_OPT_CACHE_SIZE:
+        ok = true;              /* negative means KiB, as for the pragma */
+        break;
+    case LP_OPT_MMAP_SIZE:
+        ok = value >= 0 && value <= G_MAXINT64;
+        break;
+    case LP_OPT_WAL_AUTOCHECKPOINT:
+        ok = value >= 0 && value <= G_MAXINT;   /* sqlite takes an int */
+        break;
+    case LP_OPT_READ_CACHE:
+        ok = value >= 0 && value <= G_MAXUINT32;
+        break;
+    case LP_OPT_COMPRESS_MIN:
+        ok = value >= 0 && value <= PACKED_MAX_TEXT;
+        break;
+    case LP_OPT_BUSY_TIMEOUT:
+        ok = value >= 0 && value <= G_MAXINT;
+        break;
+    default:
+        ok = false;
+        break;
+    }
+    return ok;
+}
+
+static LPErr
+applyOption( LPAppHandle_t* handle, LPAppOption option, long long value )
+{
+    LPErr err;
+    switch ( option ) {
+    case LP_OPT_JOURNAL_MODE:
+        if ( handle->readOnly ) {
+            err = LP_ERR_NONE;  /* the file's mode, and writers set it */
+        } else {
+            err = runSQL( handle, NULL, NULL, "PRAGMA journal_mode=%s;",
+                          sJournalModes[value] );
+        }
+        break;
+    case LP_OPT_SYNCHRONOUS:
+        err = runSQL( handle, NULL, NULL, "PRAGMA synchronous=%lld;", value );
+        break;
+    case LP_OPT_CACHE_SIZE:
+        err = runSQL( handle, NULL, NULL, "PRAGMA cache_size=%lld;", value );
+        break;
+    case LP_OPT_MMAP_SIZE:
+        err = runSQL( handle, NULL, NULL, "PRAGMA mmap_size=%lld;", value );
+        break;
+    case LP_OPT_WAL_AUTOCHECKPOINT:
+        err = sqlerr_to_lperr( sqlite3_wal_autocheckpoint( handle->pDb, (int)value ) );
+        break;
+    case LP_OPT_READ_CACHE:
+        readCacheFree( handle->cache ); /* loaded to the old limit */
+        handle->cache = NULL;
+        err = LP_ERR_NONE;
+        break;
+    case LP_OPT_COMPRESS_MIN:
+        err = handle->readOnly ? LP_ERR_NONE /* never writes */
+            : sqlerr_to_lperr( setPackMin( handle->pDb, value ) );
+        break;
+    case LP_OPT_BUSY_TIMEOUT:
+        err = LP_ERR_NONE;      /* busyWait() looks it up as it needs it */
+        break;
+    default:
+        err = LP_ERR_PARAM_ERR;
+        break;
+    }
+    return err;
+}
+
+/*
+ * Bring pDb's settings in line with the process defaults as overridden by
+ * the handle's own.  Options set nowhere are left as sqlite has them, and
+ * options a pooled DB already runs with aren't set again.  Must be called
+ * outside a transaction: sqlite won't change journal mode inside one.
+ */
+static LPErr
+applyOptions( LPAppHandle_t* handle )
+{
+    LPErr err = LP_ERR_NONE;
+    DBOptions wanted;
+    int ii;
+
+    G_LOCK( options );
+    wanted = sDefaultOptions;
+    G_UNLOCK( options );
+
+    for ( ii = 0; ii < LP_OPT_COUNT; ++ii ) {
+        guint bit = 1 << ii;
+        if ( handle->options.set & bit ) {
+            wanted.set |= bit;
+            wanted.values[ii] = handle->options.values[ii];
+        }
+    }
+
+    for ( ii = 0; ii < LP_OPT_COUNT && LP_ERR_NONE == err; ++ii ) {
+        guint bit = 1 << ii;
+        if ( (wanted.set & bit)
+             && ( !(handle->applied.set & bit)
+                  || handle->applied.values[ii] != wanted.values[ii] ) ) {
+            err = applyOption( handle, ii, wanted.values[ii] );
+            if ( LP_ERR_NONE == err ) {
+                handle->applied.set |= bit;
+                handle->applied.values[ii] = wanted.values[ii];
+            }
+        }
+    }
+    return err;
+} /* applyOptions */
+
+LPErr
+LPAppSetDefaultOption( LPAppOption option, long long value )
+{
+    g_return_val_if_fail( optionValueOK( option, value ), LP_ERR_PARAM_ERR );
+
+    G_LOCK( options );
+    sDefaultOptions.set |= 1 << option;
+    sDefaultOptions.values[option] = value;
+    G_UNLOCK( options );
+    return LP_ERR_NONE;
+}
+
+LPErr
+LPAppSetOption( LPAppHandle handle, LPAppOption option, long long value )
+{
+    g_return_val_if_fail( handle != NULL, -EINVAL );
+    g_return_val_if_fail( optionValueOK( option, value ), LP_ERR_PARAM_ERR );
+    LPAppHandle_t* hndl = (LPAppHandle_t*)handle;
+
+    lockHandle( handle );
+
+    LPErr err = LP_ERR_NONE;
+    if ( NULL != hndl->pDb && LP_OPT_BUSY_TIMEOUT != option ) {
+        err = LP_ERR_PARAM_ERR; /* too late: DB's open with a transaction going */
+    } else {
+        hndl->options.set |= 1 << option;
+        hndl->options.values[option] = value;
+    }
+    unlockHandle( handle );
+    return err;
+}
+
+/*****************************************************************************
+* Busy waits
+*
+* A statement that finds the DB locked by another connection retries, for
+* up to LP_OPT_BUSY_TIMEOUT, rather than failing at once with LP_ERR_BUSY.
+* Sleeps start short and double, up to a cap, each cut to a random point in
+* its upper half so that waiters started together don't retry together.
+*****************************************************************************/
+
+#define BUSY_FIRST_SLEEP_US   1000
+#define BUSY_MAX_SLEEP_US    50000
+
+G_LOCK_DEFINE_STATIC( busyStats );
+static LPBusyStats sBusyStats;
+
+static long long
+busyTimeoutMS( LPAppHandle_t* handle )
+{
+    long long timeout;
+    if ( handle->options.set & (1 << LP_OPT_BUSY_TIMEOUT) ) {
+        timeout = handle->options.values[LP_OPT_BUSY_TIMEOUT];
+    } else {
+        G_LOCK( options );
+        timeout = (sDefaultOptions.set & (1 << LP_OPT_BUSY_TIMEOUT))
+            ? sDefaultOptions.values[LP_OPT_BUSY_TIMEOUT] : 0;
+        G_UNLOCK( options );
+    }
+    return timeout;
+}
+
+/* sqlite's busy handler: nonzero to try again.  count is 0 on the first
+   call for a statement.  It sleeps with the handle's lock held: the
+   connection, opened without a mutex, is mid-statement, and another
+   thread's call on the handle can't be let at it until sqlite returns. */
+static int
+busyWait( void* ctx, int count )
+{
+    LPAppHandle_t* handle = (LPAppHandle_t*)ctx;
+    gint64 now = g_get_monotonic_time();
+    if ( 0 == count ) {
+        handle->busySince = now;
+    }
+    gint64 left = busyTimeoutMS( handle ) * G_TIME_SPAN_MILLISECOND
+        - (now - handle->busySince);
+
+    gint64 sleep = 0;
+    if ( left > 0 ) {
+        sleep = BUSY_FIRST_SLEEP_US << MIN( count, 6 );
+        sleep = MIN( sleep, BUSY_MAX_SLEEP_US );
+        sleep = g_random_int_range( sleep / 2, sleep + 1 );
+        sleep = MIN( sleep, left );
+    }
+
+    G_LOCK( busyStats );
+    if ( 0 == count ) {
+        ++sBusyStats.waits;
+    }
+    if ( 0 == sleep ) {
+        ++sBusyStats.timeouts;
+    }
+    sBusyStats.waitedUS += sleep;
+    G_UNLOCK( busyStats );
+
+    if ( 0 < sleep ) {
+        g_usleep( sleep );
+    }
+    return 0 < sleep;
+} /* busyWait */
+
+void
+LPAppGetBusyStats( LPBusyStats* stats, bool reset )
+{
+    g_return_if_fail( stats != NULL );
+
+    G_LOCK( busyStats );
+    *stats = sBusyStats;
+    if ( reset ) {
+        memset( &sBusyStats, 0, sizeof(sBusyStats) );
+    }
+    G_UNLOCK( busyStats );
+}
+
+/*
+ * Put handle's DB back in the pool, or close it if the pool won't have it.
+ */
+static LPErr
+releaseDB( LPAppHandle_t* handle )
+{
+    LPErr err = LP_ERR_NONE;
+    /* the handle may be gone by the time the DB's used again */
+    (void)sqlite3_busy_handler( handle->pDb, NULL, NULL );
+    if ( !returnToPool( handle ) ) {
+        finalizeStmts( handle );
+        err = sqlerr_to_lperr( sqlite3_close( handle->pDb ) );
+        handle->pDb = NULL;
+    }
+    return err;
+}
+
+/* lp_app(), for the shared store: the appId the connection is for. */
+static void
+appFunc( sqlite3_context* ctx, int argc, sqlite3_value** argv )
+{
+    sqlite3_result_text( ctx, sqlite3_user_data( ctx ), -1, SQLITE_STATIC );
+}
+
+static LPErr
+openFile( LPAppHandle_t* handle, int flags )
+{
+    LPErr err = LP_ERR_NONE;
+    if ( (flags & SQLITE_OPEN_CREATE) && !handle->shared ) {
+        (void)g_mkdir_with_parents( handle->pPath, S_IRWXU | S_IRWXG );
+    }
+    gchar* fullPath = dbFilePath( handle->pPath, handle->shared );
+
+    sqlite3* pDb;
+    int result = sqlite3_open_v2( fullPath, &pDb, flags | SQLITE_OPEN_NOMUTEX,
+                                  NULL );
+    if ( result == 0 ) {
+        result = definePackFuncs( pDb );
+    }
+    if ( result == 0 && handle->shared ) {
+        /* pPath is APP_PREFS_DIR "/" appId */
+        gchar* appId = g_strdup( handle->pPath + strlen( APP_PREFS_DIR "/" ) );
+        result = sqlite3_create_function_v2( pDb, "lp_app", 0,
+                                             SQLITE_UTF8 | SQLITE_DETERMINISTIC,
+                                             appId, appFunc, NULL, NULL,
+                                             g_free );
+    }
+    if ( result == 0 ) {
+        handle->pDb = pDb; /* assign this before calling runSQL()!!! */
+        memset( &handle->applied, 0, sizeof(handle->applied) );
+    } else {
+        (void)sqlite3_close( pDb );
+        err = sqlerr_to_lperr( result );
+    }
+    g_free( fullPath );
+    return err;
+} /* openFile */
+
+/*
+ * Create dir's DB or bring its schema up to date, as opening it for a
+ * read-write handle does.
+ */
+static LPErr
+upgradeSchema( const gchar* dir, bool shared )
+{
+    LPAppHandle_t* hndl = g_new0( LPAppHandle_t, 1 );
+    hndl->pPath = g_strdup( dir );
+    hndl->shared = shared;
+
+    LPErr err = connectDB( hndl );
+    if ( LP_ERR_NONE == err ) {
+        err = releaseDB( hndl );
+    }
+
+    g_free( hndl->pPath );
+    g_free( hndl );
+    return err;
+} /* upgradeSchema */
+
+/*
+ * A read-only connection can't create the DB or bring an old one's table up
+ * to date, and our statements won't compile without them.  So when either is
+ * needed, a read-write connection does it first, once.
+ */
+static LPErr
+openReadOnly( LPAppHandle_t* handle )
+{
+    LPErr err = openFile( handle, SQLITE_OPEN_READONLY );
+    if ( LP_ERR_NONE != err || schemaVersion( handle->pDb ) < SCHEMA_VERSION ) {
+        if ( LP_ERR_NONE == err ) {
+            (void)sqlite3_close( handle->pDb );
+            handle->pDb = NULL;
+        }
+        err = upgradeSchema( handle->pPath, handle->shared );
+        if ( LP_ERR_NONE == err ) {
+            err = openFile( handle, SQLITE_OPEN_READONLY );
+        }
+    }
+    return err;
+} /* openReadOnly */
+
+/*
+ * Get handle a DB connection, from the pool or by opening the file, set up
+ * the way its options say, but don't start a transaction on it.
+ */
+static LPErr
+connectDB( LPAppHandle_t* handle )
+{
+    LPErr err = LP_ERR_NONE;
+    bool opened = false;
+    if ( handle->pPath == NULL ) {
+        err = LP_ERR_INVALID_HANDLE;
+    } else if ( !takeFromPool( handle ) ) {
+        if ( handle->readOnly ) {
+            err = openReadOnly( handle );
+        } else {
+            err = openFile( handle, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE );
+        }
+        opened = LP_ERR_NONE == err;
+    }
+
+    if ( LP_ERR_NONE == err ) {
+        (void)sqlite3_busy_handler( handle->pDb, busyWait, handle );
+        if ( opened && !handle->readOnly ) {
+            /* before applyOptions(), which can set the journal mode: see
+               migrateSchema() */
+            err = sqlerr_to_lperr( migrateSchema( handle->pDb,
+                                                  handle->shared ) );
+        }
+        if ( LP_ERR_NONE == err ) {
+            err = applyOptions( handle );
+        }
+        if ( LP_ERR_NONE != err ) {
+            finalizeStmts( handle );
+            (void)sqlite3_close( handle->pDb );
+            handle->pDb = NULL;
+        }
+    }
+    return err;
+} /* connectDB */
+
+/*
+ * Open the sqlite DB if it isn't already open; connectDB() sees to its
+ * schema, so the statements can assume the table.  BEGIN is deferred: a
+ * read-only handle's transaction stays a read transaction, its snapshot
+ * taken at the first read.
+ */
+static LPErr
+openDB( LPAppHandle_t* handle )
+{
+    LPErr err = LP_ERR_NONE;
+    bool begin = handle->txnEnded;  /* the next one, on an open DB */
+    if ( handle->pDb == NULL ) {
+        err = connectDB( handle );
+        begin = LP_ERR_NONE == err;
+    }
+    if ( begin ) {
+        handle->txnEnded = false;   /* before runSQL() comes back here */
+        err = runSQL( handle, NULL, NULL, "BEGIN;" ); /* begin a transaction */
+        handle->txnEnded = LP_ERR_NONE != err;
+    }
+    return err;
+} /* openDB */
+
+/*****************************************************************************
+* Shared store
+*
+* Once SHARED_DB_PATH exists every app's prefs live in it, in one table keyed
+* by (app, key), and each app's own DB is ignored.  Handles get on with it
+* as before: each still has its own connection, pooled by appId, and its
+* statements find the appId through lp_app() (see sharedStmtSQL()).  Which
+* layout is in use is decided per handle, when it's created, by whether the
+* file is there, so every process agrees without being told.
+*****************************************************************************/
+
+static bool
+sharedStoreInUse( void )
+{
+    return g_file_test( SHARED_DB_PATH, G_FILE_TEST_EXISTS );
+}
+
+const char*
+LPAppSharedStorePath( void )
+{
+    return sharedStoreInUse() ? SHARED_DB_PATH : NULL;
+}
+
+/*
+ * Remove an app's own DB, with the journal, WAL and shared-memory files that
+ * go with it, and its directory if that leaves it empty.  LP_ERR_PARAM_ERR
+ * if there was no DB, or any of its files is still there.
+ */
+static LPErr
+removeAppDB( const gchar* dir )
+{
+    static const char* const sSuffixes[] = { "", "-journal", "-wal", "-shm" };
+    gchar* file = dbFilePath( dir, false );
+    LPErr err = LP_ERR_NONE;
+    int ii;
+
+    evictFromPool( dir );
+    for ( ii = 0; ii < G_N_ELEMENTS( sSuffixes ); ++ii ) {
+        gchar* path = g_strconcat( file, sSuffixes[ii], NULL );
+        if ( 0 != unlink( path ) && ( 0 == ii || ENOENT != errno ) ) {
+            err = LP_ERR_PARAM_ERR;
+        }
+        g_free( path );
+    }
+    (void)rmdir( dir );
+    g_free( file );
+    return err;
+} /* removeAppDB */
+
+/* A connection of our own, with no handle, waits as a handle would. */
+static void
+setDefaultBusyTimeout( sqlite3* pDb )
+{
+    LPAppHandle_t noOptions = { 0 };
+    (void)sqlite3_busy_timeout( pDb, (int)MIN( busyTimeoutMS( &noOptions ),
+                                               G_MAXINT ) );
+}
+
+/*
+ * Shut writers out of the app DB in dir until the returned connection is
+ * closed.  BEGIN IMMEDIATE takes the write lock and, unlike EXCLUSIVE, leaves
+ * the DB readable, as the copy needs.  NULL, with sqlite's reason in
+ * *result, if a writer keeps it for longer than the default busy timeout.
+ */
+static sqlite3*
+lockAppDB( const gchar* dir, int* result )
+{
+    gchar* file = dbFilePath( dir, false );
+    sqlite3* pDb = NULL;
+
+    *result = sqlite3_open_v2( file, &pDb, SQLITE_OPEN_READWRITE, NULL );
+    if ( SQLITE_OK == *result ) {
+        setDefaultBusyTimeout( pDb );
+        *result = sqlite3_exec( pDb, "BEGIN IMMEDIATE;", NULL, NULL, NULL );
+    }
+    if ( SQLITE_OK != *result ) {
+        g_warning( "%s: can't lock %s: %s", __func__, file,
+                   sqlite3_errmsg( pDb ) );
+        (void)sqlite3_close( pDb );
+        pDb = NULL;
+    }
+    g_free( file );
+    return pDb;
+} /* lockAppDB */
+
+/*
+ * Make a DB locked by lockAppDB() refuse all writes, for good, before it's
+ * removed.  A connection opened on it earlier, by anyone, would otherwise
+ * go on writing to the unlinked file, where nothing will read it again:
+ * sqlite notices that with a rollback journal, but not in WAL mode.
+ */
+static void
+retireAppDB( sqlite3* lock )
+{
+    static const char* const sSQL =
+        "CREATE TRIGGER retired_insert BEFORE INSERT ON data"
+        " BEGIN SELECT RAISE( ABORT, 'moved to the shared store' ); END;"
+        " CREATE TRIGGER retired_update BEFORE UPDATE ON data"
+        " BEGIN SELECT RAISE( ABORT, 'moved to the shared store' ); END;"
+        " CREATE TRIGGER retired_delete BEFORE DELETE ON data"
+        " BEGIN SELECT RAISE( ABORT, 'moved to the shared store' ); END;"
+        " COMMIT;";
+    if ( SQLITE_OK != sqlite3_exec( lock, sSQL, NULL, NULL, NULL ) ) {
+        g_warning( "%s: %s", __func__, sqlite3_errmsg( lock ) );
+    }
+} /* retireAppDB */
+
+static void
+unlockAppDB( gpointer data )
+{
+    sqlite3* pDb = (sqlite3*)data;
+    (void)sqlite3_exec( pDb, "ROLLBACK;", NULL, NULL, NULL );
+    (void)sqlite3_close( pDb );
+}
+
+/* Copy the rows of appId's own DB, in dir, into pDb's shared table. */
+static int
+copyAppDB( sqlite3* pDb, const char* appId, const gchar* dir )
+{
+    gchar* file = dbFilePath( dir, false );
+    char* sql = sqlite3_mprintf( "ATTACH %Q AS perapp;", file );
+    int result = sqlite3_exec( pDb, sql, NULL, NULL, NULL );
+    sqlite3_free( sql );
+    if ( SQLITE_OK == result ) {
+        /* REPLACE, so that a restored or re-migrated app's values win */
+        sql = sqlite3_mprintf( "BEGIN;"
+                               " INSERT OR REPLACE INTO main.data"
+                               "( app, key, value, flags, scalar )"
+                               " SELECT %Q, key, value, flags, scalar"
+                               " FROM perapp.data;"
+                               " COMMIT;", appId );
+        result = sqlite3_exec( pDb, sql, NULL, NULL, NULL );
+        sqlite3_free( sql );
+        if ( SQLITE_OK != result ) {
+            g_warning( "%s: copying %s failed: %s", __func__, file,
+                       sqlite3_errmsg( pDb ) );
+            (void)sqlite3_exec( pDb, "ROLLBACK;", NULL, NULL, NULL );
+        }
+        (void)sqlite3_exec( pDb, "DETACH perapp;", NULL, NULL, NULL );
+    }
+    g_free( file );
+    return result;
+} /* copyAppDB */
+
+/*
+ * A new shared store is built under another name and renamed into place
+ * once it's complete, so no handle sees it half full.  Adding to one that's
+ * already there (after a restore put back apps' own DBs, say) can't work
+ * like that, but each app is copied in one transaction, and only removed
+ * once all of them are in, so an interrupted run is simply run again.
+ *
+ * Each app's DB is locked against writers from just before its copy until
+ * it's been retired and removed, so a write to it either lands before the
+ * copy or fails: with LP_ERR_BUSY while the lock is held, and for good
+ * after.  Nothing is removed if any app's lock can't be had.
+ */
+LPErr
+LPAppMigrateToSharedStore( void )
+{
+    bool building = !sharedStoreInUse();
+    const char* target = building ? SHARED_DB_PATH ".new" : SHARED_DB_PATH;
+    GPtrArray* copied = g_ptr_array_new_with_free_func( g_free );
+    GPtrArray* locks = g_ptr_array_new_with_free_func( unlockAppDB );
+    sqlite3* pDb = NULL;
+
+    if ( building ) {
+        (void)unlink( target );     /* from a run that didn't finish */
+    }
+    int result = sqlite3_open_v2( target, &pDb,
+                                  SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE,
+                                  NULL );
+    if ( SQLITE_OK == result ) {
+        setDefaultBusyTimeout( pDb );
+        result = migrateSchema( pDb, true );
+    }
+
+    GDir* prefsDir = SQLITE_OK == result
+        ? g_dir_open( APP_PREFS_DIR, 0, NULL ) : NULL;
+    const gchar* appId;
+    while ( SQLITE_OK == result && NULL != prefsDir
+            && NULL != (appId = g_dir_read_name( prefsDir )) ) {
+        gchar* dir = g_build_filename( APP_PREFS_DIR, appId, NULL );
+        sqlite3* lock = NULL;
+        struct stat st;
+        if ( statDB( dir, false, &st ) ) {  /* else not an app's directory */
+            /* so old DBs have the columns we copy */
+            result = LP_ERR_NONE == upgradeSchema( dir, false )
+                ? SQLITE_OK : SQLITE_ERROR;
+            if ( SQLITE_OK == result
+                 && NULL != (lock = lockAppDB( dir, &result )) ) {
+                result = copyAppDB( pDb, appId, dir );
+            }
+        }
+        if ( NULL != lock ) {
+            g_ptr_array_add( copied, dir );
+            g_ptr_array_add( locks, lock );
+        } else {
+            g_free( dir );
+        }
+    }
+    if ( NULL != prefsDir ) {
+        g_dir_close( prefsDir );
+    }
+
+    int closeResult = sqlite3_close( pDb );
+    if ( SQLITE_OK == result ) {
+        result = closeResult;
+    }
+    if ( SQLITE_OK == result && building && 0 != rename( target,
+                                                         SHARED_DB_PATH ) ) {
+        result = SQLITE_CANTOPEN;
+    }
+    if ( SQLITE_OK == result ) {
+        guint ii;
+        for ( ii = 0; ii < copied->len; ++ii ) {
+            retireAppDB( g_ptr_array_index( locks, ii ) );
+            (void)removeAppDB( g_ptr_array_index( copied, ii ) );
+        }
+    } else if ( building ) {
+        (void)unlink( target );
+    }
+
+    g_ptr_array_free( locks, TRUE );   /* only now may writers go on */
+    g_ptr_array_free( copied, TRUE );
+    return sqlerr_to_lperr( result );
+} /* LPAppMigrateToSharedStore */
+
+/*****************************************************************************
+* Maintenance
+*
+* Chores on an app's DB as a whole, run on a connection of their own with no
+* transaction of ours open, so each statement commits as it goes.  An app
+* with no DB has nothing to do.
+*****************************************************************************/
+
+typedef LPErr (*DBChore)( sqlite3* pDb, void* ctx );
+
+static LPErr
+doChore( const char* appId, DBChore chore, void* ctx )
+{
+    LPErr err = LP_ERR_NONE;
+    LPAppHandle_t* hndl = g_new0( LPAppHandle_t, 1 );
+    hndl->pPath = g_strdup_printf( APP_PREFS_DIR "/%s", appId );
+    hndl->shared = sharedStoreInUse();
+    /* chores are for when nobody else wants the DB: never wait for it */
+    hndl->options.set = 1 << LP_OPT_BUSY_TIMEOUT;
+
+    struct stat st;
+    if ( statDB( hndl->pPath, hndl->shared, &st ) ) {
+        err = connectDB( hndl );
+        if ( LP_ERR_NONE == err ) {
+            err = (*chore)( hndl->pDb, ctx );
+            LPErr relErr = releaseDB( hndl );
+            if ( LP_ERR_NONE == err ) {
+                err = relErr;
+            }
+        }
+    }
+
+    g_free( hndl->pPath );
+    g_free( hndl );
+    return err;
+} /* doChore */
+
+static LPErr
+checkpointChore( sqlite3* pDb, void* unused )
+{
+    return sqlerr_to_lperr(
+        sqlite3_wal_checkpoint_v2( pDb, NULL, SQLITE_CHECKPOINT_PASSIVE,
+                                   NULL, NULL ) );
+}
+
+LPErr
+LPAppCheckpoint( const char* appId )
+{
+    g_return_val_if_fail( appId != NULL, -EINVAL );
+
+    return doChore( appId, checkpointChore, NULL );
+} /* LPAppCheckpoint */
+
+static LPErr
+pragmaInt( sqlite3* pDb, const char* pragma, sqlite3_int64* value )
+{
+    sqlite3_stmt* stmt;
+    int result = sqlite3_prepare_v2( pDb, pragma, -1, &stmt, NULL );
+    if ( SQLITE_OK == result ) {
+        result = sqlite3_step( stmt );
+        if ( SQLITE_ROW == result ) {
+            *value = sqlite3_column_int64( stmt, 0 );
+            result = SQLITE_OK;
+        }
+        (void)sqlite3_finalize( stmt );
+    }
+    return sqlerr_to_lperr( result );
+}
+
+typedef struct SpaceCounts {
+    unsigned int pages;
+    unsigned int freePages;
+} SpaceCounts;
+
+static LPErr
+spaceChore( sqlite3* pDb, void* ctx )
+{
+    SpaceCounts* counts = (SpaceCounts*)ctx;
+    sqlite3_int64 pages = 0, freePages = 0, autoVacuum = 0;
+    LPErr err = pragmaInt( pDb, "PRAGMA page_count;", &pages );
+    if ( LP_ERR_NONE == err ) {
+        err = pragmaInt( pDb, "PRAGMA freelist_count;", &freePages );
+    }
+    if ( LP_ERR_NONE == err ) {
+        err = pragmaInt( pDb, "PRAGMA auto_vacuum;", &autoVacuum );
+    }
+    if ( LP_ERR_NONE == err ) {
+        counts->pages = MIN( pages, G_MAXUINT );
+        /* 2 is INCREMENTAL; without it there's nothing we can give back */
+        counts->freePages = 2 == autoVacuum ? MIN( freePages, G_MAXUINT ) : 0;
+    }
+    return err;
+} /* spaceChore */
+
+LPErr
+LPAppGetSpace( const char* appId, unsigned int* pages,
+               unsigned int* freePages )
+{
+    g_return_val_if_fail( appId != NULL, -EINVAL );
+    g_return_val_if_fail( pages != NULL, -EINVAL );
+    g_return_val_if_fail( freePages != NULL, -EINVAL );
+
+    SpaceCounts counts = { 0, 0 };
+    LPErr err = doChore( appId, spaceChore, &counts );
+    *pages = counts.pages;
+    *freePages = counts.freePages;
+    return err;
+} /* LPAppGetSpace */
+
+static LPErr
+reclaimChore( sqlite3* pDb, void* ctx )
+{
+    /* sqlite3_exec() steps it to the end; each step frees one page */
+    char* sql = sqlite3_mprintf( "PRAGMA incremental_vacuum( %u );",
+                                 *(unsigned int*)ctx );
+    LPErr err = sqlerr_to_lperr( sqlite3_exec( pDb, sql, NULL, NULL, NULL ) );
+    sqlite3_free( sql );
+    if ( LP_ERR_NONE == err ) {
+        /* in WAL mode the file only shrinks once that's checkpointed */
+        err = checkpointChore( pDb, NULL );
+    }
+    return err;
+} /* reclaimChore */
+
+LPErr
+LPAppReclaimSpace( const char* appId, unsigned int maxPages )
+{
+    g_return_val_if_fail( appId != NULL, -EINVAL );
+    g_return_val_if_fail( maxPages > 0, LP_ERR_PARAM_ERR ); /* 0 means all */
+
+    return doChore( appId, reclaimChore, &maxPages );
+} /* LPAppReclaimSpace */
+
+/* LPAppClearData for the shared store: delete appId's rows. */
+static LPErr
+clearSharedData( gchar* dir )
+{
+    LPAppHandle_t* hndl = g_new0( LPAppHandle_t, 1 );
+    hndl->pPath = dir;
+    hndl->shared = true;
+
+    LPErr err = connectDB( hndl );
+    if ( LP_ERR_NONE == err ) {
+        /* outside any transaction, so it commits as it goes */
+        err = runSQL( hndl, NULL, NULL,
+                      "DELETE FROM data WHERE app = lp_app();" );
+        if ( LP_ERR_NONE == err && 0 == sqlite3_changes( hndl->pDb ) ) {
+            err = LP_ERR_PARAM_ERR;     /* as for a DB that isn't there */
+        }
+        LPErr relErr = releaseDB( hndl );
+        if ( LP_ERR_NONE == err ) {
+            err = relErr;
+        }
+    }
+    g_free( hndl->pPath );
+    g_free( hndl );
+    return err;
+} /* clearSharedData */
+
+LPErr
+LPAppClearData( const char* appId )
+{
+    gchar* dir = g_strdup_printf( APP_PREFS_DIR "/%s", appId );
+    evictFromPool( dir );
+    if ( sharedStoreInUse() ) {
+        return clearSharedData( dir );
+    }
+    LPErr err = removeAppDB( dir );
+    g_free( dir );
+    return err;
+}
+
+static LPErr
+newHandle( const char* appId, bool readOnly, LPAppHandle* handle )
+{
+    g_return_val_if_fail( handle != NULL, -EINVAL );
+    *handle = NULL;
+
+    g_return_val_if_fail( appId != NULL, -EINVAL );
+
+    LPAppHandle_t* hndl = g_new0( LPAppHandle_t, 1 );
+    if (hndl) {
+        hndl->pPath = g_strdup_printf( APP_PREFS_DIR "/%s", appId );
+        hndl->readOnly = readOnly;
+        hndl->shared = sharedStoreInUse();
+        g_rec_mutex_init( &hndl->lock );
+        *handle = (LPAppHandle)hndl;
+    }
+
+    return 0;
+} /* newHandle */
+
+LPErr
+LPAppGetHandle( const char* appId, LPAppHandle* handle )
+{
+    return newHandle( appId, false, handle );
+} /* LPAppGetHandle */
+
+LPErr
+LPAppGetHandleReadOnly( const char* appId, LPAppHandle* handle )
+{
+    return newHandle( appId, true, handle );
+} /* LPAppGetHandleReadOnly */
+
+/*
+ * The cache may hold writes that are being undone, which neither
+ * data_version nor the change count will show.
+ */
+static void
+dropCache( LPAppHandle_t* handle )
+{
+    readCacheFree( handle->cache );
+    handle->cache = NULL;
+}
+
+/*
+ * Commit or roll back the handle's transaction, if it has one going, and
+ * leave the DB open for openDB() to begin the next.  A commit that fails
+ * (busy, say) leaves the transaction as it was, to be tried again.
+ */
+static LPErr
+endTransaction( LPAppHandle_t* handle, bool commit )
+{
+    LPErr err = LP_ERR_NONE;
+    if ( handle->walks > 0 || handle->streams > 0 ) {
+        err = LP_ERR_PARAM_ERR; /* LPAppForEach or a stream is using it */
+    } else if ( NULL != handle->pDb && !handle->txnEnded ) {
+        if ( !commit ) {
+            dropCache( handle );
+        }
+        err = runSQL( handle, NULL, NULL, "%s;",
+                      commit ? "COMMIT" : "ROLLBACK" );
+        if ( LP_ERR_NONE == err || !commit ) {
+            handle->txnEnded = true;
+            handle->savepoints = 0;
+        }
+    }
+    return err;
+} /* endTransaction */
+
+LPErr
+LPAppFreeHandle( LPAppHandle handle, bool commit )
+{
+    LPErr lperr = LP_ERR_NONE;
+    g_return_val_if_fail( handle != NULL, -EINVAL );
+    LPAppHandle_t* hndl = (LPAppHandle_t*)handle;
+
+    if ( hndl->streams > 0 || hndl->walks > 0 ) {
+        lperr = LP_ERR_PARAM_ERR; /* they point into it: keep it */
+    } else {
+        if ( hndl->pDb ) {
+            lperr = endTransaction( hndl, commit );
+            if ( LP_ERR_NONE != lperr ) {
+                /* the commit failed, LP_ERR_BUSY say: its changes are lost,
+                   but the write lock mustn't stay held by a DB nobody has */
+                (void)endTransaction( hndl, false );
+            }
+            LPErr relErr = releaseDB( hndl );
+            if ( LP_ERR_NONE == lperr ) {
+                lperr = relErr;
+            }
+        }
+
+        g_rec_mutex_clear( &hndl->lock );
+        g_free( hndl->pPath );
+        g_free( hndl );
+    }
+    return lperr;
+}
+
+LPErr
+LPAppCommit( LPAppHandle handle )
+{
+    g_return_val_if_fail( handle != NULL, -EINVAL );
+
+    lockHandle( handle );
+    LPErr err = endTransaction( (LPAppHandle_t*)handle, true );
+    unlockHandle( handle );
+    return err;
+} /* LPAppCommit */
+
+LPErr
+LPAppRollback( LPAppHandle handle )
+{
+    g_return_val_if_fail( handle != NULL, -EINVAL );
+
+    lockHandle( handle );
+    LPErr err = endTransaction( (LPAppHandle_t*)handle, false );
+    unlockHandle( handle );
+    return err;
+} /* LPAppRollback */
+
+/*
+ * Savepoints are named for their depth, so the caller needn't name them and
+ * they can't collide with LPAppSetValues' own.
+ */
+LPErr
+LPAppSavepoint( LPAppHandle handle )
+{
+    g_return_val_if_fail( handle != NULL, -EINVAL );
+    LPAppHandle_t* hndl = (LPAppHandle_t*)handle;
+
+    lockHandle( handle );
+    LPErr err = LP_ERR_PARAM_ERR;   /* sqlite won't under a write stream */
+    if ( !hndl->streamWriting ) {
+        err = runSQL( hndl, NULL, NULL, "SAVEPOINT lp_sp%d;",
+                      hndl->savepoints );
+    }
+    if ( LP_ERR_NONE == err ) {
+        ++hndl->savepoints;
+    }
+    unlockHandle( handle );
+    return err;
+} /* LPAppSavepoint */
+
+LPErr
+LPAppReleaseSavepoint( LPAppHandle handle )
+{
+    g_return_val_if_fail( handle != NULL, -EINVAL );
+    LPAppHandle_t* hndl = (LPAppHandle_t*)handle;
+
+    lockHandle( handle );
+    LPErr err = LP_ERR_PARAM_ERR;
+    if ( hndl->savepoints > 0 && !hndl->streamWriting ) {
+        err = runSQL( hndl, NULL, NULL, "RELEASE lp_sp%d;",
+                      hndl->savepoints - 1 );
+        if ( LP_ERR_NONE == err ) {
+            --hndl->savepoints;
+        }
+    }
+    unlockHandle( handle );
+    return err;
+} /* LPAppReleaseSavepoint */
+
+LPErr
+LPAppRollbackSavepoint( LPAppHandle handle )
+{
+    g_return_val_if_fail( handle != NULL, -EINVAL );
+    LPAppHandle_t* hndl = (LPAppHandle_t*)handle;
+
+    lockHandle( handle );
+    LPErr err = LP_ERR_PARAM_ERR;
+    if ( hndl->savepoints > 0 && 0 == hndl->walks
+         && !hndl->streamWriting ) {
+        int level = hndl->savepoints - 1;
+        dropCache( hndl );
+        /* ROLLBACK TO leaves the savepoint open; we're done with it */
+        err = runSQL( hndl, NULL, NULL,
+                      "ROLLBACK TO lp_sp%d; RELEASE lp_sp%d;", level, level );
+        if ( LP_ERR_NONE == err ) {
+            --hndl->savepoints;
+        }
+    }
+    unlockHandle( handle );
+    return err;
+} /* LPAppRollbackSavepoint */
+
+void
+LPAppLockHandle( LPAppHandle handle )
+{
+    g_return_if_fail( handle != NULL );
+    lockHandle( handle );
+}
+
+void
+LPAppUnlockHandle( LPAppHandle handle )
+{
+    g_return_if_fail( handle != NULL );
+    unlockHandle( handle );
+}
+
+/*
+ * Bind to ?1 and ?2 of stmt the bounds of the keys starting with prefix, so
+ * "key >= ?1 AND key < ?2" is a range scan on the primary key's index.  The
+ * upper bound is prefix with its last byte that can be incremented
+ * incremented and anything after dropped.  A prefix that's all 0xFF bytes,
+ * like an empty one, has no such bound; there we bind an empty blob, which
+ * sqlite sorts after every text value.
+ */
+static void
+bindPrefixRange( sqlite3_stmt* stmt, const char* prefix )
+{
+    if ( NULL == prefix ) {
+        prefix = "";
+    }
+    int len = strlen( prefix );
+    sqlite3_bind_text( stmt, 1, prefix, len, SQLITE_TRANSIENT );
+
+    while ( len > 0 && (unsigned char)prefix[len-1] == 0xFF ) {
+        --len;
+    }
+    if ( len > 0 ) {
+        gchar* upper = g_strndup( prefix, len );
+        ++upper[len-1];
+        sqlite3_bind_text( stmt, 2, upper, len, g_free );
+    } else {
+        sqlite3_bind_zeroblob( stmt, 2, 0 );
+    }
+} /* bindPrefixRange */
+
+/*
+ * Look key up using stmt, a STMT_GET, or if key is NULL whatever has already
+ * been bound to it.  On success *value points into sqlite's row buffer and
+ * stays good only until stmt is reset, which the caller must do whatever
+ * this returns.  *flags, if flags isn't NULL, gets the row's flags.
+ */
+static LPErr
+stepGet( sqlite3_stmt* stmt, const char* key, const char** value, int* flags )
+{
+    LPErr err = LP_ERR_NONE;
+    if ( NULL != key ) {
+        sqlite3_bind_text( stmt, 1, key, -1, SQLITE_STATIC );
+    }
+    int result = sqlite3_step( stmt );
+    if ( SQLITE_ROW == result ) {
+        *value = (const char*)sqlite3_column_text( stmt, 0 );
+        if ( NULL == *value ) {
+            err = LP_ERR_MEM;
+        } else if ( NULL != flags ) {
+            *flags = sqlite3_column_int( stmt, 1 );
+        }
+    } else if ( SQLITE_DONE == result ) {
+        err = LP_ERR_NO_SUCH_KEY;
+    } else {
+        err = sqlerr_to_lperr( result );
+    }
+    return err;
+} /* stepGet */
+
+/*
+ * Copy the whole DB into a new ReadCache, unless it's bigger than limit, in
+ * which case the cache comes back not complete.
+ */
+static LPErr
+loadCache( LPAppHandle_t* handle, size_t limit, ReadCache** out )
+{
+    ReadCache* cache = readCacheNew( limit );
+    sqlite3_stmt* stmt;
+    LPErr err = NULL == cache ? LP_ERR_MEM : getStmt( handle, STMT_LOAD, &stmt );
+    if ( LP_ERR_NONE == err ) {
+        int result;
+        while ( SQLITE_ROW == (result = sqlite3_step( stmt )) ) {
+            const char* key = (const char*)sqlite3_column_text( stmt, 0 );
+            int keyLen = sqlite3_column_bytes( stmt, 0 );
+            const char* value = (const char*)sqlite3_column_text( stmt, 1 );
+            int valueLen = sqlite3_column_bytes( stmt, 1 );
+            if ( NULL == key || NULL == value ) {
+                result = SQLITE_NOMEM;
+                break;
+            }
+            bool isJson = storedValueOK( value, sqlite3_column_int( stmt, 2 ) );
+            if ( !readCacheAdd( cache, key, keyLen, value, valueLen, isJson ) ) {
+                result = SQLITE_DONE;   /* too big: no point going on */
+                break;
+            }
+        }
+        if ( SQLITE_DONE != result ) {
+            err = sqlerr_to_lperr( result );
+        }
+        (void)sqlite3_reset( stmt );
+    }
+    if ( LP_ERR_NONE == err ) {
+        *out = cache;
+    } else {
+        readCacheFree( cache );
+    }
+    return err;
+} /* loadCache */
+
+/*
+ * The handle's cache if LP_OPT_READ_CACHE is on, reloaded first if the DB
+ * has changed, or NULL if there's no current copy to read from.
+ *
+ * PRAGMA data_version changes when another connection commits, and our own
+ * writes bump sqlite3_total_changes(), so a cache stamped with both is good
+ * for as long as they match.  (Rolling back is the one other way our data can
+ * change; endTransaction() and LPAppRollbackSavepoint drop the cache for
+ * that.)  Reading data_version
+ * also starts the handle's read transaction if it hasn't started, so the
+ * stamp and what's loaded under it are of the same snapshot.
+ */
+static ReadCache*
+currentCache( LPAppHandle_t* handle )
+{
+    ReadCache* cache = NULL;
+    sqlite3_stmt* stmt;
+    sqlite3_int64 version = -1;
+
+    endPeek( handle );
+    if ( LP_ERR_NONE == openDB( handle )
+         && (handle->applied.set & (1 << LP_OPT_READ_CACHE))
+         && 0 < handle->applied.values[LP_OPT_READ_CACHE]
+         /* else our transaction was rolled back under us */
+         && !sqlite3_get_autocommit( handle->pDb )
+         && LP_ERR_NONE == getStmt( handle, STMT_DATA_VERSION, &stmt ) ) {
+        if ( SQLITE_ROW == sqlite3_step( stmt ) ) {
+            version = sqlite3_column_int64( stmt, 0 );
+        }
+        (void)sqlite3_reset( stmt );
+    }
+
+    if ( version >= 0 ) {
+        int changes = sqlite3_total_changes( handle->pDb );
+        size_t limit = handle->applied.values[LP_OPT_READ_CACHE];
+        cache = handle->cache;
+        if ( NULL == cache ) {
+            /* load it below */
+        } else if ( cache->version == version && cache->changes == changes ) {
+            /* good as it is */
+        } else if ( handle->walks > 0 ) {
+            cache = NULL;       /* an LPAppForEach is still walking it */
+        } else {
+            readCacheFree( cache );
+            handle->cache = cache = NULL;
+        }
+        if ( NULL == handle->cache
+             && LP_ERR_NONE == loadCache( handle, limit, &cache ) ) {
+            cache->version = version;
+            cache->changes = changes;
+            handle->cache = cache;
+        }
+    }
+    return ( NULL != cache && cache->complete ) ? cache : NULL;
+} /* currentCache */
+
+/* stepGet() for the cache: *isJson is whether the value may be returned. */
+static LPErr
+findCached( const ReadCache* cache, const char* key, const char** value,
+            bool* isJson )
+{
+    LPErr err = LP_ERR_NO_SUCH_KEY;
+    const ReadCacheEntry* entry = readCacheFind( cache, key );
+    if ( NULL != entry ) {
+        *value = readCacheValue( cache, entry );
+        *isJson = entry->isJson;
+        err = LP_ERR_NONE;
+    }
+    return err;
+}
+
+LPErr
+LPAppCopyValue( LPAppHandle handle, const char* key, char** jstr )
+{
+    g_return_val_if_fail( handle != NULL, -EINVAL );
+    g_return_val_if_fail( key != NULL, -EINVAL );
+    g_return_val_if_fail( jstr != NULL, -EINVAL );
+    LPAppHandle_t* hndl = (LPAppHandle_t*)handle;
+
+    lockHandle( handle );
+
+    ReadCache* cache = currentCache( hndl );
+    sqlite3_stmt* stmt = NULL;
+    const char* value;
+    bool isJson;
+    LPErr err;
+
+    if ( NULL != cache ) {
+        err = findCached( cache, key, &value, &isJson );
+    } else {
+        err = getStmt( hndl, STMT_GET, &stmt );
+        if ( LP_ERR_NONE == err ) {
+            int flags;
+            err = stepGet( stmt, key, &value, &flags );
+            isJson = LP_ERR_NONE == err && storedValueOK( value, flags );
+        }
+    }
+
+    if ( LP_ERR_NONE != err ) {
+        /* nothing to copy */
+    } else if ( !isJson ) {
+        g_critical( "non-json value stored: %s", value );
+        err = LP_ERR_VALUENOTJSON;
+    } else {
+        *jstr = g_strdup( value );
+    }
+    if ( NULL != stmt ) {
+        (void)sqlite3_reset( stmt );
+    }
+
+    unlockHandle( handle );
+    return err;
+}
+
+LPErr
+LPAppGetValueInfo( LPAppHandle handle, const char* key, LPValueInfo* info )
+{
+    g_return_val_if_fail( handle != NULL, -EINVAL );
+    g_return_val_if_fail( key != NULL, -EINVAL );
+    g_return_val_if_fail( info != NULL, -EINVAL );
+    LPAppHandle_t* hndl = (LPAppHandle_t*)handle;
+
+    lockHandle( handle );
+
+    sqlite3_stmt* stmt;
+    LPErr err = getStmt( hndl, STMT_INFO, &stmt );
+    if ( LP_ERR_NONE == err ) {
+        sqlite3_bind_text( stmt, 1, key, -1, SQLITE_STATIC );
+        int result = sqlite3_step( stmt );
+        if ( SQLITE_ROW == result ) {
+            info->version = sqlite3_column_int64( stmt, 0 );
+            info->mtime = sqlite3_column_int64( stmt, 1 ); /* 0 if NULL */
+            info->size = sqlite3_column_int64( stmt, 2 );
+        } else if ( SQLITE_DONE == result ) {
+            err = LP_ERR_NO_SUCH_KEY;
+        } else {
+            err = sqlerr_to_lperr( result );
+        }
+        (void)sqlite3_reset( stmt );
+    }
+
+    unlockHandle( handle );
+    return err;
+} /* LPAppGetValueInfo */
+
+/* Not from the read cache, which doesn't keep versions: the lookup's as
+   cheap as the cache's check that it's current. */
+LPErr
+LPAppCopyValueIfChanged( LPAppHandle handle, const char* key,
+                         long long knownVersion, char** jstr,
+                         long long* version )
+{
+    g_return_val_if_fail( handle != NULL, -EINVAL );
+    g_return_val_if_fail( key != NULL, -EINVAL );
+    g_return_val_if_fail( jstr != NULL, -EINVAL );
+    g_return_val_if_fail( version != NULL, -EINVAL );
+    LPAppHandle_t* hndl = (LPAppHandle_t*)handle;
+
+    lockHandle( handle );
+
+    sqlite3_stmt* stmt;
+    LPErr err = getStmt( hndl, STMT_GET_IF_CHANGED, &stmt );
+    if ( LP_ERR_NONE == err ) {
+        sqlite3_bind_text( stmt, 1, key, -1, SQLITE_STATIC );
+        sqlite3_bind_int64( stmt, 2, knownVersion );
+        int result = sqlite3_step( stmt );
+        if ( SQLITE_ROW == result ) {
+            *version = sqlite3_column_int64( stmt, 2 );
+            const char* value = (const char*)sqlite3_column_text( stmt, 0 );
+            int flags = sqlite3_column_int( stmt, 1 );
+            if ( *version == knownVersion ) {
+                err = LP_ERR_NOT_MODIFIED;
+            } else if ( NULL == value ) {
+                err = LP_ERR_MEM;
+            } else if ( !storedValueOK( value, flags ) ) {
+                g_critical( "non-json value stored: %s", value );
+                err = LP_ERR_VALUENOTJSON;
+            } else {
+                *jstr = g_strdup( value );
+            }
+        } else if ( SQLITE_DONE == result ) {
+            err = LP_ERR_NO_SUCH_KEY;
+        } else {
+            err = sqlerr_to_lperr( result );
+        }
+        (void)sqlite3_reset( stmt );
+    }
+
+    unlockHandle( handle );
+    return err;
+} /* LPAppCopyValueIfChanged */
+
+LPErr
+LPAppPeekValue( LPAppHandle handle, const char* key, const char** jstr )
+{
+    g_return_val_if_fail( handle != NULL, -EINVAL );
+    g_return_val_if_fail( key != NULL, -EINVAL );
+    g_return_val_if_fail( jstr != NULL, -EINVAL );
+    LPAppHandle_t* hndl = (LPAppHandle_t*)handle;
+
+    lockHandle( handle );
+
+    sqlite3_stmt* stmt;
+    ReadCache* cache = currentCache( hndl );
+    LPErr err;
+    if ( NULL != cache ) {
+        bool isJson;            /* returned as stored, as below */
+        err = findCached( cache, key, jstr, &isJson );
+    } else if ( LP_ERR_NONE == (err = getStmt( hndl, STMT_GET, &stmt )) ) {
+        /* key has to outlive the call as long as the row does */
+        sqlite3_bind_text( stmt, 1, key, -1, SQLITE_TRANSIENT );
+        err = stepGet( stmt, NULL, jstr, NULL );
+        if ( LP_ERR_NONE == err ) {
+            hndl->peeked = stmt;    /* reset by the next call */
+        } else {
+            (void)sqlite3_reset( stmt );
+        }
+    }
+    unlockHandle( handle );
+    return err;
+} /* LPAppPeekValue */
+
+/*
+ * Shortest of %.15g and %.17g that reads back as the same double, so 0.1
+ * stays "0.1".
+ */
+static void
+formatDouble( double value, char buf[G_ASCII_DTOSTR_BUF_SIZE] )
+{
+    g_ascii_formatd( buf, G_ASCII_DTOSTR_BUF_SIZE, "%.15g", value );
+    if ( g_ascii_strtod( buf, NULL ) != value ) {
+        g_ascii_formatd( buf, G_ASCII_DTOSTR_BUF_SIZE, "%.17g", value );
+    }
+}
+
+/* A typed value as LPAppCopyValueString() has always returned it: the
+   string inside its legacy document. */
+static gchar*
+scalarAsString( sqlite3_stmt* stmt, int type )
+{
+    gchar* str = NULL;
+    char buf[G_ASCII_DTOSTR_BUF_SIZE];
+    switch ( type ) {
+    case VALUE_TYPE_INT64:
+        str = g_strdup_printf( "%" G_GINT64_FORMAT,
+                               (gint64)sqlite3_column_int64( stmt, 2 ) );
+        break;
+    case VALUE_TYPE_DOUBLE:
+        formatDouble( sqlite3_column_double( stmt, 2 ), buf );
+        str = g_strdup( buf );
+        break;
+    case VALUE_TYPE_BOOL:
+        str = g_strdup( sqlite3_column_int( stmt, 2 ) ? "true" : "false" );
+        break;
+    case VALUE_TYPE_STRING:
+        str = g_strdup( (const gchar*)sqlite3_column_text( stmt, 2 ) );
+        break;
+    }
+    return str;
+}
+
+/*
+ * For values stored as plain json, e.g. by an older version of this
+ * library: the string at the start of an array like ["123"], read as the
+ * getters always have -- any later elements are ignored, and anything but
+ * a string there is the wrong type.
+ */
+static LPErr
+copyLegacyScalar( const char* jstr, gchar** str )
+{
+    struct json_object* json;
+    LPErr err = strToJsonWithCheck( jstr, &json );
+    if ( LP_ERR_NONE == err ) {
+        struct json_object* child = NULL;
+        if ( json_object_is_type( json, json_type_array ) ) {
+            child = json_object_array_get_idx( json, 0 );
+        }
+        if ( NULL == child
+             || !json_object_is_type( child, json_type_string ) ) {
+            err = LP_ERR_WRONGTYPE;
+        } else {
+            *str = g_strdup( json_object_get_string( child ) );
+        }
+        json_object_put( json );
+    }
+    return err;
+}
+
+/* All of str, as a decimal that fits in an int64. */
+static bool
+parseInt64( const char* str, gint64* value )
+{
+    gchar* end;
+    errno = 0;
+    *value = g_ascii_strtoll( str, &end, 10 );
+    return end != str && *end == '\0' && 0 == errno;
+}
+
+/*
+ * Find key, leaving stmt (a STMT_GET) on its row for the caller to read the
+ * scalar from and then reset.  *type gets the row's VALUE_TYPE_*.  If the
+ * row has no native value, *legacy gets the string from its legacy document
+ * instead, for the caller to convert and g_free.
+ */
+static LPErr
+getScalar( LPAppHandle handle, const char* key, sqlite3_stmt** stmt,
+           int* type, gchar** legacy )
+{
+    g_return_val_if_fail( handle != NULL, -EINVAL );
+    g_return_val_if_fail( key != NULL, -EINVAL );
+
+    *legacy = NULL;
+    LPErr err = getStmt( (LPAppHandle_t*)handle, STMT_GET, stmt );
+    if ( LP_ERR_NONE == err ) {
+        const char* value;
+        int flags;
+        err = stepGet( *stmt, key, &value, &flags );
+        if ( LP_ERR_NONE == err ) {
+            *type = VALUE_TYPE( flags );
+            if ( VALUE_TYPE_JSON == *type ) {
+                err = copyLegacyScalar( value, legacy );
+            }
+        }
+        if ( LP_ERR_NONE != err ) {
+            (void)sqlite3_reset( *stmt );
+        }
+    }
+    return err;
+}
+
+LPErr
+LPAppCopyValueString( LPAppHandle handle, const char* key, char** str )
+{
+    g_return_val_if_fail( handle != NULL, -EINVAL );
+    g_return_val_if_fail( key != NULL, -EINVAL );
+    g_return_val_if_fail( str != NULL, -EINVAL );
+
+    lockHandle( handle );
+
+    sqlite3_stmt* stmt;
+    LPErr err = getStmt( (LPAppHandle_t*)handle, STMT_GET, &stmt );
+    if ( LP_ERR_NONE == err ) {
+        const char* value;
+        int flags;
+        err = stepGet( stmt, key, &value, &flags );
+        if ( LP_ERR_NONE == err && VALUE_TYPE_JSON != VALUE_TYPE( flags ) ) {
+            *str = scalarAsString( stmt, VALUE_TYPE( flags ) );
+        } else if ( LP_ERR_NONE == err ) {
+            struct json_object* json = NULL;
+            err = strToJsonWithCheck( value, &json );
+            if ( LP_ERR_NONE == err && json_object_is_type( json, json_type_array ) )
+            {
+                /* assume it's an array of length one.  Return the string at elem 0. */
+                struct json_object* child = json_object_array_get_idx( json, 0 );
+
+                if ( (NULL != child) && ( json_object_is_type( child, json_type_string)) )
+                {
+                    *str = g_strdup( json_object_get_string( child ) );
+                }
+                else
+                {
+                    err = LP_ERR_VALUENOTJSON;
+                }
+            }
+            json_object_put( json ); /* no-op if NULL */
+        }
+        (void)sqlite3_reset( stmt );
+    }
+    unlockHandle( handle );
+    return err;
+}
+
+LPErr
+LPAppCopyValueInt( LPAppHandle handle, const char* key, int* intValue )
+{
+    g_return_val_if_fail( handle != NULL, -EINVAL );
+    g_return_val_if_fail( intValue != NULL, -EINVAL );
+
+    lockHandle( handle );
+
+    sqlite3_stmt* stmt;
+    int type;
+    gchar* legacy;
+    LPErr err = getScalar( handle, key, &stmt, &type, &legacy );
+    if ( LP_ERR_WRONGTYPE == err ) {
+        err = LP_ERR_VALUENOTJSON;  /* as this has always returned */
+    } else if ( LP_ERR_NONE == err ) {
+        double value;
+        switch ( type ) {
+        case VALUE_TYPE_JSON:
+            value = g_ascii_strtoll( legacy, NULL, 10 );
+            break;
+        case VALUE_TYPE_STRING:
+            value = g_ascii_strtoll( (const char*)sqlite3_column_text( stmt, 2 ),
+                                     NULL, 10 );
+            break;
+        case VALUE_TYPE_DOUBLE:
+            value = sqlite3_column_double( stmt, 2 );
+            break;
+        default:
+            value = sqlite3_column_int64( stmt, 2 );
+        }
+        /* truncated toward zero as the cast will, it must fit; past an int
+           it's no int, rather than one that wrapped */
+        if ( value > (double)INT_MIN - 1 && value < (double)INT_MAX + 1 ) {
+            *intValue = (int)value;
+        } else {
+            err = LP_ERR_WRONGTYPE;
+        }
+        (void)sqlite3_reset( stmt );
+        g_free( legacy );
+    }
+    unlockHandle( handle );
+    return err;
+}
+
+LPErr
+LPAppCopyValueInt64( LPAppHandle handle, const char* key, int64_t* intValue )
+{
+    g_return_val_if_fail( handle != NULL, -EINVAL );
+    g_return_val_if_fail( intValue != NULL, -EINVAL );
+
+    lockHandle( handle );
+
+    sqlite3_stmt* stmt;
+    int type;
+    gchar* legacy;
+    LPErr err = getScalar( handle, key, &stmt, &type, &legacy );
+    if ( LP_ERR_NONE == err ) {
+        if ( VALUE_TYPE_INT64 == type ) {
+            *intValue = sqlite3_column_int64( stmt, 2 );
+        } else if ( VALUE_TYPE_JSON == type ) {
+            gint64 value;
+            if ( parseInt64( legacy, &value ) ) {
+                *intValue = value;
+            } else {
+                err = LP_ERR_WRONGTYPE;
+            }
+        } else {
+            err = LP_ERR_WRONGTYPE;
+        }
+        (void)sqlite3_reset( stmt );
+        g_free( legacy );
+    }
+    unlockHandle( handle );
+    return err;
+} /* LPAppCopyValueInt64 */
+
+LPErr
+LPAppCopyValueDouble( LPAppHandle handle, const char* key, double* doubleValue )
+{
+    g_return_val_if_fail( handle != NULL, -EINVAL );
+    g_return_val_if_fail( doubleValue != NULL, -EINVAL );
+
+    lockHandle( handle );
+
+    sqlite3_stmt* stmt;
+    int type;
+    gchar* legacy;
+    LPErr err = getScalar( handle, key, &stmt, &type, &legacy );
+    if ( LP_ERR_NONE == err ) {
+        if ( VALUE_TYPE_DOUBLE == type || VALUE_TYPE_INT64 == type ) {
+            *doubleValue = sqlite3_column_double( stmt, 2 );
+        } else if ( VALUE_TYPE_JSON == type ) {
+            gchar* end;
+            double value = g_ascii_strtod( legacy, &end );
+            if ( end == legacy || *end != '\0' ) {
+                err = LP_ERR_WRONGTYPE;
+            } else {
+                *doubleValue = value;
+            }
+        } else {
+            err = LP_ERR_WRONGTYPE;
+        }
+        (void)sqlite3_reset( stmt );
+        g_free( legacy );
+    }
+    unlockHandle( handle );
+    return err;
+} /* LPAppCopyValueDouble */
+
+LPErr
+LPAppCopyValueBool( LPAppHandle handle, const char* key, bool* boolValue )
+{
+    g_return_val_if_fail( handle != NULL, -EINVAL );
+    g_return_val_if_fail( boolValue != NULL, -EINVAL );
+
+    lockHandle( handle );
+
+    sqlite3_stmt* stmt;
+    int type;
+    gchar* legacy;
+    LPErr err = getScalar( handle, key, &stmt, &type, &legacy );
+    if ( LP_ERR_NONE == err ) {
+        if ( VALUE_TYPE_BOOL == type ) {
+            *boolValue = 0 != sqlite3_column_int( stmt, 2 );
+        } else if ( VALUE_TYPE_JSON == type && 0 == strcmp( legacy, "true" ) ) {
+            *boolValue = true;
+        } else if ( VALUE_TYPE_JSON == type && 0 == strcmp( legacy, "false" ) ) {
+            *boolValue = false;
+        } else {
+            err = LP_ERR_WRONGTYPE;
+        }
+        (void)sqlite3_reset( stmt );
+        g_free( legacy );
+    }
+    unlockHandle( handle );
+    return err;
+} /* LPAppCopyValueBool */
+
+LPErr
+LPAppCopyValueCJ( LPAppHandle handle, const char* key, struct json_object** json )
+{
+    g_return_val_if_fail( handle != NULL, -EINVAL );
+    g_return_val_if_fail( key != NULL, -EINVAL );
+    g_return_val_if_fail( json != NULL, -EINVAL );
+
+    lockHandle( handle );
+
+    /* Parsing is checking, so don't bother with storedValueOK() */
+    sqlite3_stmt* stmt;
+    ReadCache* cache = currentCache( (LPAppHandle_t*)handle );
+    LPErr err;
+    if ( NULL != cache ) {
+        const char* value;
+        bool isJson;
+        err = findCached( cache, key, &value, &isJson );
+        if ( LP_ERR_NONE == err ) {
+            err = strToJsonWithCheck( value, json );
+        }
+    } else if ( LP_ERR_NONE == (err = getStmt( (LPAppHandle_t*)handle,
+                                               STMT_GET, &stmt )) ) {
+        const char* value;
+        err = stepGet( stmt, key, &value, NULL );
+        if ( LP_ERR_NONE == err ) {
+            err = strToJsonWithCheck( value, json );
+        }
+        (void)sqlite3_reset( stmt );
+    }
+    unlockHandle( handle );
+    return err;
+} /* LPAppCopyValueCJ */
+
+/*
+ * Whether sqlite's JSON functions can follow path: "$" and then any number
+ * of ".key", ".\"key\"", "[n]", "[#]" and "[#-n]" steps.  Checked up front,
+ * so that an error from sqlite is the DB's and not the caller's.
+ */
+static bool
+validPath( const char* path )
+{
+    const char* pp = path;
+    if ( '$' != *pp++ ) {
+        return false;
+    }
+    while ( '\0' != *pp ) {
+        if ( '.' == *pp && '"' == pp[1] ) {
+            const char* close = strchr( pp + 2, '"' );
+            if ( NULL == close ) {
+                return false;
+            }
+            pp = close + 1;
+        } else if ( '.' == *pp ) {
+            size_t len = strcspn( ++pp, ".[" );
+            if ( 0 == len ) {
+                return false;
+            }
+            pp += len;
+        } else if ( 0 == strncmp( pp, "[#]", 3 ) ) {
+            pp += 3;
+        } else if ( '[' == *pp ) {
+            pp += 0 == strncmp( pp, "[#-", 3 ) ? 3 : 1;
+            if ( !g_ascii_isdigit( *pp ) ) {
+                return false;
+            }
+            while ( g_ascii_isdigit( *pp ) ) {
+                ++pp;
+            }
+            if ( ']' != *pp++ ) {
+                return false;
+            }
+        } else {
+            return false;
+        }
+    }
+    return true;
+} /* validPath */
+
+LPErr
+LPAppCopyValuePath( LPAppHandle handle, const char* key, const char* path,
+                    char** jstr )
+{
+    g_return_val_if_fail( handle != NULL, -EINVAL );
+    g_return_val_if_fail( key != NULL, -EINVAL );
+    g_return_val_if_fail( path != NULL, -EINVAL );
+    g_return_val_if_fail( jstr != NULL, -EINVAL );
+
+    lockHandle( handle );
+
+    sqlite3_stmt* stmt;
+    LPErr err = LP_ERR_PARAM_ERR;
+    if ( validPath( path )
+         && LP_ERR_NONE == (err = getStmt( (LPAppHandle_t*)handle,
+                                           STMT_GET_PATH, &stmt )) ) {
+        sqlite3_bind_text( stmt, 1, key, -1, SQLITE_STATIC );
+        sqlite3_bind_text( stmt, 2, path, -1, SQLITE_STATIC );
+        int result = sqlite3_step( stmt );
+        if ( SQLITE_DONE == result ) {
+            err = LP_ERR_NO_SUCH_KEY;
+        } else if ( SQLITE_ROW != result ) {
+            err = sqlerr_to_lperr( result );
+        } else if ( SQLITE_NULL == sqlite3_column_type( stmt, 0 ) ) {
+            g_critical( "non-json value stored for %s", key );
+            err = LP_ERR_VALUENOTJSON;
+        } else if ( SQLITE_NULL == sqlite3_column_type( stmt, 1 ) ) {
+            err = LP_ERR_NO_SUCH_KEY;   /* nothing there */
+        } else {
+            *jstr = g_strdup( (const char*)sqlite3_column_text( stmt, 2 ) );
+        }
+        (void)sqlite3_reset( stmt );
+    }
+    unlockHandle( handle );
+    return err;
+} /* LPAppCopyValuePath */
+
+static LPErr
+copy_as_string( struct json_object* json, char** out )
+{
+    LPErr err = LP_ERR_NONE;
+    const char* txt = json_object_get_string( json );
+    g_assert( !!txt );
+    *out = g_strdup( txt );
+    return err;
+}
+
+/* A NULL prefix means all keys, in whatever order the table has them. */
+static LPErr
+addKeysToArray( LPAppHandle_t* handle, const char* prefix,
+                struct json_object* jarray )
+{
+    sqlite3_stmt* stmt;
+    LPErr err = getStmt( handle, NULL == prefix ? STMT_KEYS : STMT_KEYS_RANGE,
+                         &stmt );
+    if ( LP_ERR_NONE == err ) {
+        int result;
+        if ( NULL != prefix ) {
+            bindPrefixRange( stmt, prefix );
+        }
+        while ( SQLITE_ROW == (result = sqlite3_step( stmt )) ) {
+            const char* key = (const char*)sqlite3_column_text( stmt, 0 );
+            json_object_array_add( jarray, json_object_new_string( key ) );
+        }
+        if ( SQLITE_DONE != result ) {
+            err = sqlerr_to_lperr( result );
+        }
+        (void)sqlite3_reset( stmt );
+    }
+    return err;
+} /* addKeysToArray */
+
+LPErr
+LPAppCopyKeys( LPAppHandle handle, char** jstr )
+{
+    return LPAppCopyKeysWithPrefix( handle, NULL, jstr );
+}
+
+LPErr
+LPAppCopyKeysWithPrefix( LPAppHandle handle, const char* prefix, char** jstr )
+{
+    LPErr err = -EINVAL;
+    g_return_val_if_fail( handle != NULL, -EINVAL );
+    g_return_val_if_fail( jstr != NULL, -EINVAL );
+
+    lockHandle( handle );
+
+    struct json_object* jarray = json_object_new_array();
+
+    err = addKeysToArray( (LPAppHandle_t*)handle, prefix, jarray );
+
+    if ( 0 == err ) {
+        err = copy_as_string( jarray, jstr );
+    }
+
+    json_object_put( jarray );
+    unlockHandle( handle );
+    return err;
+} /* LPAppCopyKeysWithPrefix */
+
+LPErr
+LPAppCopyKeysCJ( LPAppHandle handle, struct json_object** json )
+{
+    return LPAppCopyKeysWithPrefixCJ( handle, NULL, json );
+}
+
+LPErr
+LPAppCopyKeysWithPrefixCJ( LPAppHandle handle, const char* prefix,
+                           struct json_object** json )
+{
+    LPErr err = -EINVAL;
+    g_return_val_if_fail( handle != NULL, -EINVAL );
+    g_return_val_if_fail( json != NULL, -EINVAL );
+
+    lockHandle( handle );
+
+    struct json_object* jarray = json_object_new_array();
+
+    err = addKeysToArray( (LPAppHandle_t*)handle, prefix, jarray );
+
+    if ( LP_ERR_NONE == err )
+    {
+        *json = jarray;
+    }
+    else
+    {
+        json_object_put( jarray );
+    }
+    unlockHandle( handle );
+    return err;
+}
+
+static LPErr
+addKeyValuesToArray( LPAppHandle_t* handle, const char* prefix,
+                     struct json_object* jarray )
+{
+    sqlite3_stmt* stmt;
+    LPErr err = getStmt( handle, NULL == prefix ? STMT_ALL : STMT_RANGE,
+                         &stmt );
+    if ( LP_ERR_NONE == err ) {
+        int result;
+        if ( NULL != prefix ) {
+            bindPrefixRange( stmt, prefix );
+        }
+        while ( SQLITE_ROW == (result = sqlite3_step( stmt )) ) {
+            const char* key = (const char*)sqlite3_column_text( stmt, 0 );
+            const char* text = (const char*)sqlite3_column_text( stmt, 1 );
+            struct json_object* value = json_tokener_parse( text );
+            if ( value && is_toplevel_json(value) ) {
+                struct json_object* obj = json_object_new_object();
+                json_object_object_add( obj, key, value );
+                json_object_array_add( jarray, obj );
+            } else {
+                json_object_put( value ); /* no-op if NULL */
+                result = SQLITE_ABORT;
+                break;
+            }
+        }
+        if ( SQLITE_DONE != result ) {
+            err = sqlerr_to_lperr( result );
+        }
+        (void)sqlite3_reset( stmt );
+    }
+    return err;
+} /* addKeyValuesToArray */
+
+LPErr
+LPAppCopyAll( LPAppHandle handle, char** jstr )
+{
+    return LPAppCopyAllWithPrefix( handle, NULL, jstr );
+}
+
+/*
+ * Lists are laid out as json-c's json_object_to_json_string() lays them out
+ * -- "[ ]", "[ a, b ]", "{ "key": value }" -- so output built here reads as
+ * it did when json-c built it.  Start each item with listItem(), and end
+ * the list with " ]".
+ */
+static void
+listItem( GString* gstr, bool* first )
+{
+    g_string_append( gstr, *first ? " " : ", " );
+    *first = false;
+}
+
+/*
+ * Append the rows stmt finds, each a key, its value and flags, to gstr as
+ * items of a list of { key: value } objects.  SQLITE_DONE if all went well.
+ */
+static int
+appendKeyValues( sqlite3_stmt* stmt, GString* gstr )
+{
+    int result;
+    bool first = true;
+    while ( SQLITE_ROW == (result = sqlite3_step( stmt )) ) {
+        const char* key = (const char*)sqlite3_column_text( stmt, 0 );
+        const char* value = (const char*)sqlite3_column_text( stmt, 1 );
+        if ( NULL == key || NULL == value ) {
+            result = SQLITE_NOMEM;
+            break;
+        } else if ( !storedValueOK( value, sqlite3_column_int( stmt, 2 ) ) ) {
+            result = SQLITE_ABORT;
+            break;
+        }
+        listItem( gstr, &first );
+        g_string_append( gstr, "{ " );
+        appendJsonString( gstr, key );
+        g_string_append( gstr, ": " );
+        g_string_append( gstr, value );
+        g_string_append( gstr, " }" );
+    }
+    return result;
+} /* appendKeyValues */
+
+/*
+ * Build the same array of { key: value } objects addKeyValuesToArray() does,
+ * but as text, straight from the stored strings rather than parsing them and
+ * having json-c write them out again.
+ */
+LPErr
+LPAppCopyAllWithPrefix( LPAppHandle handle, const char* prefix, char** jstr )
+{
+    g_return_val_if_fail( handle != NULL, -EINVAL );
+    g_return_val_if_fail( jstr != NULL, -EINVAL );
+
+    lockHandle( handle );
+
+    sqlite3_stmt* stmt;
+    LPErr err = getStmt( (LPAppHandle_t*)handle,
+                         NULL == prefix ? STMT_ALL : STMT_RANGE, &stmt );
+    if ( LP_ERR_NONE == err ) {
+        GString* gstr = g_string_new( "[" );
+        if ( NULL != prefix ) {
+            bindPrefixRange( stmt, prefix );
+        }
+        int result = appendKeyValues( stmt, gstr );
+        if ( SQLITE_DONE != result ) {
+            err = sqlerr_to_lperr( result );
+        }
+        (void)sqlite3_reset( stmt );
+
+        g_string_append( gstr, " ]" );
+        *jstr = NULL;
+        if ( LP_ERR_NONE == err ) {
+            *jstr = g_string_free( gstr, FALSE );
+        } else {
+            g_string_free( gstr, TRUE );
+        }
+    }
+    unlockHandle( handle );
+    return err;
+} /* LPAppCopyAllWithPrefix */
+
+/* The app's latest version, and the oldest its history goes back to. */
+static LPErr
+readSeq( LPAppHandle_t* handle, long long* last, long long* oldest )
+{
+    sqlite3_stmt* stmt;
+    LPErr err = getStmt( handle, STMT_SEQ, &stmt );
+    if ( LP_ERR_NONE == err ) {
+        int result = sqlite3_step( stmt );
+        if ( SQLITE_ROW == result ) {
+            *last = sqlite3_column_int64( stmt, 0 );
+            *oldest = sqlite3_column_int64( stmt, 1 );
+        } else if ( SQLITE_DONE == result ) {
+            *last = *oldest = 0;     /* never written since versions began */
+        } else {
+            err = sqlerr_to_lperr( result );
+        }
+        (void)sqlite3_reset( stmt );
+    }
+    return err;
+}
+
+/*
+ * All from the handle's one transaction, so the changes, the tombstones and
+ * the sequence number they bring the caller up to agree.
+ */
+LPErr
+LPAppCopyChangesSince( LPAppHandle handle, long long since, char** jstr,
+                       long long* seq )
+{
+    g_return_val_if_fail( handle != NULL, -EINVAL );
+    g_return_val_if_fail( jstr != NULL, -EINVAL );
+    g_return_val_if_fail( seq != NULL, -EINVAL );
+    LPAppHandle_t* hndl = (LPAppHandle_t*)handle;
+
+    lockHandle( handle );
+
+    long long last, oldest;
+    LPErr err = readSeq( hndl, &last, &oldest );
+    if ( LP_ERR_NONE == err && since >= 0
+         && ( since < oldest || since > last ) ) {
+        err = LP_ERR_NO_HISTORY;    /* or from another DB altogether */
+    }
+
+    GString* gstr = g_string_new( "{ \"changed\": [" );
+    sqlite3_stmt* stmt;
+    if ( LP_ERR_NONE == err
+         && LP_ERR_NONE == (err = getStmt( hndl, STMT_CHANGED, &stmt )) ) {
+        sqlite3_bind_int64( stmt, 1, since );
+        int result = appendKeyValues( stmt, gstr );
+        if ( SQLITE_DONE != result ) {
+            err = sqlerr_to_lperr( result );
+        }
+        (void)sqlite3_reset( stmt );
+    }
+
+    g_string_append( gstr, " ], \"removed\": [" );
+    /* starting over, the caller has nothing to remove */
+    if ( LP_ERR_NONE == err && since >= 0
+         && LP_ERR_NONE == (err = getStmt( hndl, STMT_REMOVED, &stmt )) ) {
+        sqlite3_bind_int64( stmt, 1, since );
+        int result;
+        bool first = true;
+        while ( SQLITE_ROW == (result = sqlite3_step( stmt )) ) {
+            const char* key = (const char*)sqlite3_column_text( stmt, 0 );
+            if ( NULL == key ) {
+                result = SQLITE_NOMEM;
+                break;
+            }
+            listItem( gstr, &first );
+            appendJsonString( gstr, key );
+        }
+        if ( SQLITE_DONE != result ) {
+            err = sqlerr_to_lperr( result );
+        }
+        (void)sqlite3_reset( stmt );
+    }
+    g_string_append( gstr, " ] }" );
+
+    *jstr = NULL;
+    if ( LP_ERR_NONE == err ) {
+        *jstr = g_string_free( gstr, FALSE );
+        *seq = last;
+    } else {
+        g_string_free( gstr, TRUE );
+    }
+
+    unlockHandle( handle );
+    return err;
+} /* LPAppCopyChangesSince */
+
+LPErr
+LPAppCopyAllCJ( LPAppHandle handle, struct json_object** json )
+{
+    return LPAppCopyAllWithPrefixCJ( handle, NULL, json );
+}
+
+LPErr
+LPAppCopyAllWithPrefixCJ( LPAppHandle handle, const char* prefix,
+                          struct json_object** json )
+{
+    g_return_val_if_fail( handle != NULL, -EINVAL );
+    g_return_val_if_fail( json != NULL, -EINVAL );
+
+    lockHandle( handle );
+
+    struct json_object* jarray = json_object_new_array();
+
+    LPErr err = addKeyValuesToArray( (LPAppHandle_t*)handle, prefix, jarray );
+
+    if ( LP_ERR_NONE == err )
+    {
+        *json = jarray;
+    }
+    else
+    {
+        json_object_put( jarray );
+    }
+    unlockHandle( handle );
+    return err;
+}
+
+LPErr
+LPAppForEach( LPAppHandle handle, const char* prefix,
+              LPAppForEachFunc func, void* ctx )
+{
+    g_return_val_if_fail( handle != NULL, -EINVAL );
+    g_return_val_if_fail( func != NULL, -EINVAL );
+    LPAppHandle_t* hndl = (LPAppHandle_t*)handle;
+
+    lockHandle( handle );
+
+    sqlite3_stmt* stmt;
+    ReadCache* cache = currentCache( hndl );
+    LPErr err;
+    /* func may read through the handle, but mustn't end its transaction
+       or free it under us, nor reload the cache we're walking */
+    ++hndl->walks;
+    if ( NULL != cache ) {
+        size_t len = NULL == prefix ? 0 : strlen( prefix );
+        size_t ii = 0 == len ? 0 : readCacheLowerBound( cache, prefix );
+        for ( ; ii < cache->count; ++ii ) {
+            const ReadCacheEntry* entry = &cache->entries[ii];
+            const char* key = readCacheKey( cache, entry );
+            if ( ( len > 0 && 0 != strncmp( key, prefix, len ) )
+                 || !(*func)( key, readCacheValue( cache, entry ), ctx ) ) {
+                break;
+            }
+        }
+        err = LP_ERR_NONE;
+    } else if ( LP_ERR_NONE == (err = getStmt( hndl, STMT_RANGE, &stmt )) ) {
+        int result;
+        /* The walk keeps the statement to itself, so that a read by func
+           that wants it (LPAppCopyAllWithPrefix, say) compiles another
+           rather than rebinding this one under us. */
+        hndl->stmts[STMT_RANGE] = NULL;
+        bindPrefixRange( stmt, prefix );
+        while ( SQLITE_ROW == (result = sqlite3_step( stmt )) ) {
+            const char* key = (const char*)sqlite3_column_text( stmt, 0 );
+            const char* value = (const char*)sqlite3_column_text( stmt, 1 );
+            if ( NULL == key || NULL == value ) {
+                result = SQLITE_NOMEM;
+                break;
+            } else if ( !(*func)( key, value, ctx ) ) {
+                result = SQLITE_DONE;
+                break;
+            }
+        }
+        if ( SQLITE_DONE != result ) {
+            err = sqlerr_to_lperr( result );
+        }
+        (void)sqlite3_reset( stmt );
+        if ( NULL == hndl->stmts[STMT_RANGE] ) {
+            hndl->stmts[STMT_RANGE] = stmt;
+        } else {
+            sqlite3_finalize( stmt );   /* func compiled another */
+        }
+    }
+    --hndl->walks;
+    unlockHandle( handle );
+    return err;
+} /* LPAppForEach */
+
+static LPErr
+setValueString( LPAppHandle handle, const char* key, const char* jstr )
+{
+    sqlite3_stmt* stmt;
+    LPErr err = getStmt( (LPAppHandle_t*)handle, STMT_SET, &stmt );
+    if ( LP_ERR_NONE == err ) {
+        sqlite3_bind_text( stmt, 1, key, -1, SQLITE_STATIC );
+        sqlite3_bind_text( stmt, 2, jstr, -1, SQLITE_STATIC );
+        sqlite3_bind_int( stmt, 3, VALUE_FLAG_CHECKED );
+        sqlite3_bind_null( stmt, 4 );
+        err = stepDone( stmt );
+    }
+    return err;
+}
+
+/* patch must be json that sqlite's json functions will take. */
+static LPErr
+mergeValueString( LPAppHandle handle, const char* key, const char* patch )
+{
+    sqlite3_stmt* stmt;
+    LPErr err = getStmt( (LPAppHandle_t*)handle, STMT_MERGE, &stmt );
+    if ( LP_ERR_NONE == err ) {
+        sqlite3_bind_text( stmt, 1, key, -1, SQLITE_STATIC );
+        sqlite3_bind_text( stmt, 2, patch, -1, SQLITE_STATIC );
+        sqlite3_bind_int( stmt, 3, VALUE_FLAG_CHECKED );
+        err = stepDone( stmt );
+        if ( LP_ERR_NONE == err
+             && 0 == sqlite3_changes( ((LPAppHandle_t*)handle)->pDb ) ) {
+            err = LP_ERR_VALUENOTJSON;  /* what's stored isn't */
+        }
+    }
+    return err;
+} /* mergeValueString */
+
+/*
+ * Store a typed value: its legacy document (a one-string array, laid out
+ * byte for byte as LPAppSetValueString and LPAppSetValueInt have always
+ * written it through json-c) and its native value, bound to ?4 by the
+ * caller.
+ */
+static LPErr
+setScalar( LPAppHandle handle, const char* key, sqlite3_stmt* stmt,
+           int type, const char* str )
+{
+    LPErr err;
+    if ( *key == '\0' ) {       /* empty string? */
+        err = LP_ERR_ILLEGALKEY;
+        (void)sqlite3_clear_bindings( stmt );
+    } else {
+        GString* doc = g_string_sized_new( strlen( str ) + 8 );
+        g_string_append( doc, "[ " );
+        appendJsonString( doc, str );
+        g_string_append( doc, " ]" );
+
+        sqlite3_bind_text( stmt, 1, key, -1, SQLITE_STATIC );
+        sqlite3_bind_text( stmt, 2, doc->str, doc->len, SQLITE_STATIC );
+        sqlite3_bind_int( stmt, 3, VALUE_FLAG_CHECKED
+                          | (type << VALUE_TYPE_SHIFT) );
+        err = stepDone( stmt );
+        (void)sqlite3_clear_bindings( stmt );
+        g_string_free( doc, TRUE );
+    }
+    return err;
+} /* setScalar */
+
+LPErr
+LPAppSetValue( LPAppHandle handle, const char* key, const char* const jstr )
+{
+    g_return_val_if_fail( handle != NULL, -EINVAL );
+    g_return_val_if_fail( key != NULL, -EINVAL );
+    g_return_val_if_fail( jstr != NULL, -EINVAL );
+
+    lockHandle( handle );
+
+    LPErr err;
+    if ( *key == '\0' ) {       /* empty string? */
+        err = LP_ERR_ILLEGALKEY;
+    } else if ( !check_is_json( jstr ) ) {
+        err = LP_ERR_VALUENOTJSON;
+    } else {
+        /* Use REPLACE, not INSERT, to avoid duplicates.  */
+        err = setValueString( handle, key, jstr );
+    }
+    unlockHandle( handle );
+    return err;
+} /* LPAppSetValue */
+
+LPErr
+LPAppSetValueString( LPAppHandle handle, const char* key, const char* const str )
+{
+    g_return_val_if_fail( handle != NULL, -EINVAL );
+    g_return_val_if_fail( key != NULL, -EINVAL );
+    g_return_val_if_fail( str != NULL, -EINVAL );
+
+    lockHandle( handle );
+
+    sqlite3_stmt* stmt;
+    LPErr err = getStmt( (LPAppHandle_t*)handle, STMT_SET, &stmt );
+    if ( LP_ERR_NONE == err ) {
+        /* SQLITE_STATIC: setScalar() clears bindings before returning */
+        sqlite3_bind_text( stmt, 4, str, -1, SQLITE_STATIC );
+        err = setScalar( handle, key, stmt, VALUE_TYPE_STRING, str );
+    }
+    unlockHandle( handle );
+    return err;
+}
+
+LPErr
+LPAppSetValueInt( LPAppHandle handle, const char* key, int intValue )
+{
+    return LPAppSetValueInt64( handle, key, intValue );
+} /* LPAppSetValueInt */
+
+LPErr
+LPAppSetValueInt64( LPAppHandle handle, const char* key, int64_t intValue )
+{
+    g_return_val_if_fail( handle != NULL, -EINVAL );
+    g_return_val_if_fail( key != NULL, -EINVAL );
+
+    lockHandle( handle );
+
+    sqlite3_stmt* stmt;
+    LPErr err = getStmt( (LPAppHandle_t*)handle, STMT_SET, &stmt );
+    if ( LP_ERR_NONE == err ) {
+        char buf[32];
+        snprintf( buf, sizeof(buf), "%" G_GINT64_FORMAT, (gint64)intValue );
+        sqlite3_bind_int64( stmt, 4, intValue );
+        err = setScalar( handle, key, stmt, VALUE_TYPE_INT64, buf );
+    }
+    unlockHandle( handle );
+    return err;
+} /* LPAppSetValueInt64 */
+
+LPErr
+LPAppSetValueDouble( LPAppHandle handle, const char* key, double doubleValue )
+{
+    g_return_val_if_fail( handle != NULL, -EINVAL );
+    g_return_val_if_fail( key != NULL, -EINVAL );
+
+    lockHandle( handle );
+
+    LPErr err = LP_ERR_PARAM_ERR;
+    if ( isfinite( doubleValue ) ) {
+        sqlite3_stmt* stmt;
+        err = getStmt( (LPAppHandle_t*)handle, STMT_SET, &stmt );
+        if ( LP_ERR_NONE == err ) {
+            char buf[G_ASCII_DTOSTR_BUF_SIZE];
+            formatDouble( doubleValue, buf );
+            sqlite3_bind_double( stmt, 4, doubleValue );
+            err = setScalar( handle, key, stmt, VALUE_TYPE_DOUBLE, buf );
+        }
+    }
+    unlockHandle( handle );
+    return err;
+} /* LPAppSetValueDouble */
+
+LPErr
+LPAppSetValueBool( LPAppHandle handle, const char* key, bool boolValue )
+{
+    g_return_val_if_fail( handle != NULL, -EINVAL );
+    g_return_val_if_fail( key != NULL, -EINVAL );
+
+    lockHandle( handle );
+
+    sqlite3_stmt* stmt;
+    LPErr err = getStmt( (LPAppHandle_t*)handle, STMT_SET, &stmt );
+    if ( LP_ERR_NONE == err ) {
+        sqlite3_bind_int( stmt, 4, boolValue ? 1 : 0 );
+        err = setScalar( handle, key, stmt, VALUE_TYPE_BOOL,
+                         boolValue ? "true" : "false" );
+    }
+    unlockHandle( handle );
+    return err;
+} /* LPAppSetValueBool */
+
+LPErr
+LPAppSetValueCJ( LPAppHandle handle, const char* key, struct json_object* json )
+{
+    g_return_val_if_fail( handle != NULL, -EINVAL );
+    g_return_val_if_fail( key != NULL, -EINVAL );
+    g_return_val_if_fail( json != NULL, -EINVAL );
+
+    lockHandle( handle );
+
+    LPErr err;
+    if ( *key == '\0' ) {       /* empty string? */
+        err = LP_ERR_ILLEGALKEY;
+    } else if ( !json_object_is_type(json, json_type_object)
+                && !json_object_is_type(json, json_type_array) ) {
+        err = LP_ERR_VALUENOTJSON;
+    } else {
+        const char* jstr = json_object_get_string( json );
+        if ( !!jstr ) {
+            err = setValueString( handle, key, jstr );
+        } else {
+            g_critical( "json supplied to %s not acceptable to json", __func__ );
+            err = LP_ERR_VALUENOTJSON;
+        }
+    }
+    unlockHandle( handle );
+    return err;
+} /* LPAppSetValueCJ */
+
+LPErr
+LPAppMergeValue( LPAppHandle handle, const char* key, const char* patch )
+{
+    g_return_val_if_fail( handle != NULL, -EINVAL );
+    g_return_val_if_fail( key != NULL, -EINVAL );
+    g_return_val_if_fail( patch != NULL, -EINVAL );
+
+    lockHandle( handle );
+
+    LPErr err;
+    if ( *key == '\0' ) {       /* empty string? */
+        err = LP_ERR_ILLEGALKEY;
+    } else if ( JSONSCAN_VALID == jsonScanText( patch, strlen( patch ) ) ) {
+        err = mergeValueString( handle, key, patch );
+    } else {
+        /* json-c takes some things sqlite won't; pass those on as json-c
+           writes them */
+        struct json_object* json = json_tokener_parse( patch );
+        if ( NULL == json || !is_toplevel_json( json ) ) {
+            err = LP_ERR_VALUENOTJSON;
+        } else {
+            err = mergeValueString( handle, key,
+                                    json_object_to_json_string( json ) );
+        }
+        json_object_put( json );
+    }
+    unlockHandle( handle );
+    return err;
+} /* LPAppMergeValue */
+
+LPErr
+LPAppMergeValueCJ( LPAppHandle handle, const char* key, struct json_object* patch )
+{
+    g_return_val_if_fail( handle != NULL, -EINVAL );
+    g_return_val_if_fail( key != NULL, -EINVAL );
+    g_return_val_if_fail( patch != NULL, -EINVAL );
+
+    lockHandle( handle );
+
+    LPErr err;
+    if ( *key == '\0' ) {       /* empty string? */
+        err = LP_ERR_ILLEGALKEY;
+    } else if ( !is_toplevel_json( patch ) ) {
+        err = LP_ERR_VALUENOTJSON;
+    } else {
+        err = mergeValueString( handle, key, json_object_to_json_string( patch ) );
+    }
+    unlockHandle( handle );
+    return err;
+} /* LPAppMergeValueCJ */
+
+LPErr
+LPAppRemoveValue( LPAppHandle handle, const char* key )
+{
+    g_return_val_if_fail( handle != NULL, -EINVAL );
+    g_return_val_if_fail( key != NULL, -EINVAL );
+    LPAppHandle_t* hndl = (LPAppHandle_t*)handle;
+
+    lockHandle( handle );
+
+    sqlite3_stmt* stmt;
+    LPErr err = getStmt( hndl, STMT_REMOVE, &stmt );
+    if ( LP_ERR_NONE == err ) {
+        sqlite3_bind_text( stmt, 1, key, -1, SQLITE_STATIC );
+        err = stepDone( stmt );
+        if ( LP_ERR_NONE == err && 0 == sqlite3_changes(hndl->pDb) )
+        {
+            err = LP_ERR_NO_SUCH_KEY;
+        }
+    }
+    unlockHandle( handle );
+    return err;
+}
+
+LPErr
+LPAppRemovePrefix( LPAppHandle handle, const char* prefix )
+{
+    g_return_val_if_fail( handle != NULL, -EINVAL );
+    g_return_val_if_fail( prefix != NULL, -EINVAL );
+    LPAppHandle_t* hndl = (LPAppHandle_t*)handle;
+
+    lockHandle( handle );
+
+    LPErr err;
+    if ( *prefix == '\0' ) {   /* that's everything: use LPAppClearData */
+        err = LP_ERR_ILLEGALKEY;
+    } else {
+        sqlite3_stmt* stmt;
+        err = getStmt( hndl, STMT_REMOVE_RANGE, &stmt );
+        if ( LP_ERR_NONE == err ) {
+            bindPrefixRange( stmt, prefix );
+            err = stepDone( stmt );
+            if ( LP_ERR_NONE == err && 0 == sqlite3_changes(hndl->pDb) )
+            {
+                err = LP_ERR_NO_SUCH_KEY;
+            }
+        }
+    }
+    unlockHandle( handle );
+    return err;
+} /* LPAppRemovePrefix */
+
+/*****************************************************************************
+* Atomic updates
+*
+* A get followed by a set loses one of two updates made at the same time by
+* different processes (luna-prop and the service, say).  Each of these makes
+* its change with one statement that only matches the row it expects, and
+* tells the caller what it found if that wasn't there.  Values stored as plain
+* json by older versions of this library are converted on the way, by an
+* update that only matches if the old text is still in place.
+*****************************************************************************/
+
+/* Goes to LP_ERR_BUSY if someone else keeps changing a legacy value. */
+#define ATOMIC_TRIES 8
+
+#define INT64_FLAGS (VALUE_FLAG_CHECKED | (VALUE_TYPE_INT64 << VALUE_TYPE_SHIFT))
+
+static bool
+addOverflows( gint64 value, gint64 delta )
+{
+    return ( delta > 0 && value > G_MAXINT64 - delta )
+        || ( delta < 0 && value < G_MININT64 - delta );
+}
+
+/*
+ * The int64 under key.  If it's stored as a legacy document rather than
+ * natively, *text gets a copy of that document for the caller to g_free.
+ */
+static LPErr
+getInt64( LPAppHandle_t* handle, const char* key, gint64* value, gchar** text )
+{
+    sqlite3_stmt* stmt;
+    int type;
+    gchar* legacy;
+    *text = NULL;
+    LPErr err = getScalar( handle, key, &stmt, &type, &legacy );
+    if ( LP_ERR_NONE == err ) {
+        if ( VALUE_TYPE_INT64 == type ) {
+            *value = sqlite3_column_int64( stmt, 2 );
+        } else if ( VALUE_TYPE_JSON == type && parseInt64( legacy, value ) ) {
+            *text = g_strdup( (const gchar*)sqlite3_column_text( stmt, 0 ) );
+        } else {
+            err = LP_ERR_WRONGTYPE;
+        }
+        (void)sqlite3_reset( stmt );
+        g_free( legacy );
+    }
+    return err;
+}
+
+/* Store value natively under key if key still holds the document oldText. */
+static LPErr
+replaceWithInt64( LPAppHandle_t* handle, const char* key, const char* oldText,
+                  gint64 value, bool* swapped )
+{
+    sqlite3_stmt* stmt;
+    LPErr err = getStmt( handle, STMT_SET_IF, &stmt );
+    if ( LP_ERR_NONE == err ) {
+        char buf[32];
+        snprintf( buf, sizeof(buf), "%" G_GINT64_FORMAT, value );
+        sqlite3_bind_int64( stmt, 4, value );
+        sqlite3_bind_text( stmt, 5, oldText, -1, SQLITE_STATIC );
+        err = setScalar( handle, key, stmt, VALUE_TYPE_INT64, buf );
+        *swapped = LP_ERR_NONE == err && 0 < sqlite3_changes( handle->pDb );
+    }
+    return err;
+}
+
+/*
+ * Add delta to a native int64, or insert one if key isn't there.  *done is
+ * false if key holds anything else, or the sum would overflow.
+ */
+static LPErr
+incrementTyped( LPAppHandle_t* handle, const char* key, gint64 delta,
+                bool* done )
+{
+    sqlite3_stmt* stmt;
+    LPErr err = getStmt( handle, STMT_INCREMENT, &stmt );
+    if ( LP_ERR_NONE == err ) {
+        sqlite3_bind_text( stmt, 1, key, -1, SQLITE_STATIC );
+        sqlite3_bind_int64( stmt, 2, delta );
+        sqlite3_bind_int( stmt, 3, INT64_FLAGS );
+        sqlite3_bind_int( stmt, 4, VALUE_TYPE_MASK );
+        err = stepDone( stmt );
+        *done = LP_ERR_NONE == err && 0 < sqlite3_changes( handle->pDb );
+    }
+    return err;
+}
+
+LPErr
+LPAppIncrement( LPAppHandle handle, const char* key, int64_t delta,
+                int64_t* newValue )
+{
+    g_return_val_if_fail( handle != NULL, -EINVAL );
+    g_return_val_if_fail( key != NULL, -EINVAL );
+    LPAppHandle_t* hndl = (LPAppHandle_t*)handle;
+
+    lockHandle( handle );
+
+    LPErr err = LP_ERR_NONE;
+    bool done = false;
+    int tries = 0;
+    if ( *key == '\0' ) {       /* empty string? */
+        err = LP_ERR_ILLEGALKEY;
+    }
+    while ( LP_ERR_NONE == err && !done && tries++ < ATOMIC_TRIES ) {
+        gint64 value = 0;
+        gchar* text = NULL;
+        err = incrementTyped( hndl, key, delta, &done );
+        if ( LP_ERR_NONE == err ) {
+            /* If that wrote, this transaction now holds the DB's write
+               lock: the value read back is the sum, not someone else's. */
+            err = getInt64( hndl, key, &value, &text );
+            if ( done ) {
+                /* nothing more to do */
+            } else if ( LP_ERR_NO_SUCH_KEY == err ) {
+                err = LP_ERR_NONE;  /* just removed: insert it next time */
+            } else if ( LP_ERR_NONE == err && addOverflows( value, delta ) ) {
+                err = LP_ERR_PARAM_ERR;
+            } else if ( LP_ERR_NONE == err && NULL != text ) {
+                value += delta;
+                err = replaceWithInt64( hndl, key, text, value, &done );
+            }
+            g_free( text );
+        }
+        if ( LP_ERR_NONE == err && done && NULL != newValue ) {
+            *newValue = value;
+        }
+    }
+    if ( LP_ERR_NONE == err && !done ) {
+        err = LP_ERR_BUSY;
+    }
+    unlockHandle( handle );
+    return err;
+} /* LPAppIncrement */
+
+LPErr
+LPAppCompareAndSetInt64( LPAppHandle handle, const char* key, int64_t expected,
+                         int64_t desired, bool* swapped, int64_t* current )
+{
+    g_return_val_if_fail( handle != NULL, -EINVAL );
+    g_return_val_if_fail( key != NULL, -EINVAL );
+    g_return_val_if_fail( swapped != NULL, -EINVAL );
+    LPAppHandle_t* hndl = (LPAppHandle_t*)handle;
+
+    lockHandle( handle );
+
+    LPErr err = LP_ERR_NONE;
+    bool done = false;
+    int tries = 0;
+    *swapped = false;
+    if ( *key == '\0' ) {       /* empty string? */
+        err = LP_ERR_ILLEGALKEY;
+    }
+    while ( LP_ERR_NONE == err && !done && tries++ < ATOMIC_TRIES ) {
+        sqlite3_stmt* stmt;
+        gint64 value = desired;
+        err = getStmt( hndl, STMT_CAS_INT64, &stmt );
+        if ( LP_ERR_NONE == err ) {
+            sqlite3_bind_text( stmt, 1, key, -1, SQLITE_STATIC );
+            sqlite3_bind_int64( stmt, 2, expected );
+            sqlite3_bind_int64( stmt, 3, desired );
+            sqlite3_bind_int( stmt, 4, VALUE_TYPE_MASK );
+            sqlite3_bind_int( stmt, 5, INT64_FLAGS & VALUE_TYPE_MASK );
+            err = stepDone( stmt );
+            done = *swapped = LP_ERR_NONE == err
+                && 0 < sqlite3_changes( hndl->pDb );
+        }
+        if ( LP_ERR_NONE == err && !done ) {
+            gchar* text;
+            err = getInt64( hndl, key, &value, &text );
+            if ( LP_ERR_NONE != err ) {
+                /* missing, or not an int64 */
+            } else if ( value != expected ) {
+                done = true;
+            } else if ( NULL != text ) {
+                err = replaceWithInt64( hndl, key, text, desired, swapped );
+                done = *swapped;
+                value = desired;
+            } /* else it became expected just now: try again */
+            g_free( text );
+        }
+        if ( done && NULL != current ) {
+            *current = value;
+        }
+    }
+    if ( LP_ERR_NONE == err && !done ) {
+        err = LP_ERR_BUSY;
+    }
+    unlockHandle( handle );
+    return err;
+} /* LPAppCompareAndSetInt64 */
+
+LPErr
+LPAppCompareAndSet( LPAppHandle handle, const char* key, const char* expected,
+                    const char* jstr, bool* swapped )
+{
+    g_return_val_if_fail( handle != NULL, -EINVAL );
+    g_return_val_if_fail( key != NULL, -EINVAL );
+    g_return_val_if_fail( jstr != NULL, -EINVAL );
+    g_return_val_if_fail( swapped != NULL, -EINVAL );
+    LPAppHandle_t* hndl = (LPAppHandle_t*)handle;
+
+    lockHandle( handle );
+
+    LPErr err;
+    *swapped = false;
+    if ( *key == '\0' ) {       /* empty string? */
+        err = LP_ERR_ILLEGALKEY;
+    } else if ( !check_is_json( jstr ) ) {
+        err = LP_ERR_VALUENOTJSON;
+    } else {
+        sqlite3_stmt* stmt;
+        err = getStmt( hndl, NULL == expected ? STMT_ADD : STMT_SET_IF, &stmt );
+        if ( LP_ERR_NONE == err ) {
+            sqlite3_bind_text( stmt, 1, key, -1, SQLITE_STATIC );
+            sqlite3_bind_text( stmt, 2, jstr, -1, SQLITE_STATIC );
+            sqlite3_bind_int( stmt, 3, VALUE_FLAG_CHECKED );
+            sqlite3_bind_null( stmt, 4 );
+            if ( NULL != expected ) {
+                sqlite3_bind_text( stmt, 5, expected, -1, SQLITE_STATIC );
+            }
+            err = stepDone( stmt );
+            *swapped = LP_ERR_NONE == err && 0 < sqlite3_changes( hndl->pDb );
+        }
+    }
+    unlockHandle( handle );
+    return err;
+} /* LPAppCompareAndSet */
+
+/*****************************************************************************
+* Batch get and set
+*
+* Each of these works through its keys with one compiled statement, inside
+* the handle's transaction, rather than paying per key for a call, a
+* statement lookup and (for sets) a separate savepoint.
+*****************************************************************************/
+
+/*
+ * Store count key/value pairs.  All keys and values are checked before
+ * anything is written, and the writes happen inside a savepoint, so either
+ * every pair is stored or (on error) none is.
+ */
+static LPErr
+setValueStrings( LPAppHandle_t* handle, const char* const* keys,
+                 const char* const* jstrs, int count )
+{
+    sqlite3_stmt* stmt;
+    sqlite3_stmt* savepoint;
+    LPErr err = getStmt( handle, STMT_SAVEPOINT, &savepoint );
+    if ( LP_ERR_NONE == err ) {
+        err = getStmt( handle, STMT_SET, &stmt );
+    }
+    if ( LP_ERR_NONE == err ) {
+        err = stepDone( savepoint );
+    }
+    if ( LP_ERR_NONE == err ) {
+        int ii;
+        for ( ii = 0; ii < count && LP_ERR_NONE == err; ++ii ) {
+            sqlite3_bind_text( stmt, 1, keys[ii], -1, SQLITE_STATIC );
+            sqlite3_bind_text( stmt, 2, jstrs[ii], -1, SQLITE_STATIC );
+            sqlite3_bind_int( stmt, 3, VALUE_FLAG_CHECKED );
+            sqlite3_bind_null( stmt, 4 );
+            err = stepDone( stmt );
+        }
+
+        sqlite3_stmt* end;
+        if ( LP_ERR_NONE != err
+             && LP_ERR_NONE == getStmt( handle, STMT_ROLLBACK_TO, &end ) ) {
+            (void)stepDone( end );
+        }
+        LPErr endErr = getStmt( handle, STMT_RELEASE, &end );
+        if ( LP_ERR_NONE == endErr ) {
+            endErr = stepDone( end );
+        }
+        if ( LP_ERR_NONE == err ) {
+            err = endErr;
+        }
+    }
+    return err;
+} /* setValueStrings */
+
+LPErr
+LPAppSetValues( LPAppHandle handle, const char* const* keys,
+                const char* const* jstrs, int count )
+{
+    g_return_val_if_fail( handle != NULL, -EINVAL );
+    g_return_val_if_fail( count >= 0, -EINVAL );
+    g_return_val_if_fail( count == 0 || (keys != NULL && jstrs != NULL), -EINVAL );
+
+    lockHandle( handle );
+
+    LPErr err = LP_ERR_NONE;
+    int ii;
+    for ( ii = 0; ii < count && LP_ERR_NONE == err; ++ii ) {
+        if ( NULL == keys[ii] || NULL == jstrs[ii] ) {
+            err = LP_ERR_PARAM_ERR;
+        } else if ( *keys[ii] == '\0' ) {
+            err = LP_ERR_ILLEGALKEY;
+        } else if ( !check_is_json( jstrs[ii] ) ) {
+            err = LP_ERR_VALUENOTJSON;
+        }
+    }
+
+    if ( LP_ERR_NONE == err && count > 0 ) {
+        err = setValueStrings( (LPAppHandle_t*)handle, keys, jstrs, count );
+    }
+    unlockHandle( handle );
+    return err;
+} /* LPAppSetValues */
+
+LPErr
+LPAppSetValuesCJ( LPAppHandle handle, struct json_object* values )
+{
+    g_return_val_if_fail( handle != NULL, -EINVAL );
+    g_return_val_if_fail( values != NULL, -EINVAL );
+
+    lockHandle( handle );
+
+    LPErr err = LP_ERR_NONE;
+    if ( !json_object_is_type( values, json_type_object ) ) {
+        err = LP_ERR_PARAM_ERR;
+    } else {
+        int count = json_object_object_length( values );
+        const char** keys = g_new( const char*, count );
+        const char** jstrs = g_new( const char*, count );
+        int ii = 0;
+
+        json_object_object_foreach( values, key, value ) {
+            if ( LP_ERR_NONE != err ) {
+                break;
+            } else if ( *key == '\0' ) {
+                err = LP_ERR_ILLEGALKEY;
+            } else if ( NULL == value || !is_toplevel_json( value ) ) {
+                err = LP_ERR_VALUENOTJSON;
+            } else {
+                keys[ii] = key;
+                jstrs[ii] = json_object_get_string( value );
+                ++ii;
+            }
+        }
+
+        if ( LP_ERR_NONE == err && count > 0 ) {
+            err = setValueStrings( (LPAppHandle_t*)handle, keys, jstrs, count );
+        }
+        g_free( keys );
+        g_free( jstrs );
+    }
+    unlockHandle( handle );
+    return err;
+} /* LPAppSetValuesCJ */
+
+LPErr
+LPAppCopyValues( LPAppHandle handle, const char* const* keys, int count,
+                 char** values, char** errors )
+{
+    g_return_val_if_fail( handle != NULL, -EINVAL );
+    g_return_val_if_fail( count >= 0, -EINVAL );
+    g_return_val_if_fail( count == 0 || keys != NULL, -EINVAL );
+    g_return_val_if_fail( values != NULL, -EINVAL );
+
+    lockHandle( handle );
+
+    sqlite3_stmt* stmt;
+    LPErr err = getStmt( (LPAppHandle_t*)handle, STMT_GET, &stmt );
+    if ( LP_ERR_NONE == err ) {
+        GString* vstr = g_string_new( "{" );
+        GString* estr = g_string_new( "{" );
+        int ii;
+
+        for ( ii = 0; ii < count && LP_ERR_NONE == err; ++ii ) {
+            const char* value = NULL;
+            LPErr keyErr;
+            if ( NULL == keys[ii] ) {
+                err = LP_ERR_PARAM_ERR;
+                break;
+            } else if ( *keys[ii] == '\0' ) {
+                keyErr = LP_ERR_ILLEGALKEY;
+            } else {
+                int flags;
+                keyErr = stepGet( stmt, keys[ii], &value, &flags );
+                if ( LP_ERR_NONE == keyErr && !storedValueOK( value, flags ) ) {
+                    g_critical( "non-json value stored: %s", value );
+                    keyErr = LP_ERR_VALUENOTJSON;
+                }
+            }
+
+            if ( LP_ERR_NONE == keyErr ) {
+                if ( vstr->len > 1 ) {
+                    g_string_append_c( vstr, ',' );
+                }
+                appendJsonString( vstr, keys[ii] );
+                g_string_append_c( vstr, ':' );
+                g_string_append( vstr, value );
+            } else if ( LP_ERR_NO_SUCH_KEY == keyErr
+                        || LP_ERR_VALUENOTJSON == keyErr
+                        || LP_ERR_ILLEGALKEY == keyErr ) {
+                if ( estr->len > 1 ) {
+                    g_string_append_c( estr, ',' );
+                }
+                appendJsonString( estr, keys[ii] );
+                g_string_append_printf( estr, ":%d", keyErr );
+            } else {
+                err = keyErr;   /* the DB's in trouble; give up */
+            }
+            (void)sqlite3_reset( stmt );
+        }
+
+        g_string_append_c( vstr, '}' );
+        g_string_append_c( estr, '}' );
+        if ( LP_ERR_NONE == err ) {
+            *values = g_string_free( vstr, FALSE );
+            if ( NULL != errors ) {
+                *errors = g_string_free( estr, FALSE );
+                estr = NULL;
+            }
+        } else {
+            g_string_free( vstr, TRUE );
+        }
+        if ( NULL != estr ) {
+            g_string_free( estr, TRUE );
+        }
+    }
+    unlockHandle( handle );
+    return err;
+} /* LPAppCopyValues */
+
+LPErr
+LPAppCopyValuesCJ( LPAppHandle handle, const char* const* keys, int count,
+                   struct json_object** values, struct json_object** errors )
+{
+    g_return_val_if_fail( values != NULL, -EINVAL );
+
+    char* vstr = NULL;
+    char* estr = NULL;
+    LPErr err = LPAppCopyValues( handle, keys, count, &vstr,
+                                 NULL == errors ? NULL : &estr );
+    if ( LP_ERR_NONE == err ) {
+        *values = json_tokener_parse( vstr );
+        if ( NULL != errors ) {
+            *errors = json_tokener_parse( estr );
+        }
+    }
+    g_free( vstr );
+    g_free( estr );
+    return err;
+} /* LPAppCopyValuesCJ */
+
+/*****************************************************************************
+* Value streams
+*
+* sqlite3_blob reads and writes a value's bytes in place, so a big value can
+* go through a buffer of the caller's choosing.  A blob can't change the
+* value's size, so a write first stores that many spaces (json doesn't mind
+* any left over) and then overwrites them.  The new row goes in under a
+* savepoint, and the bytes written are fed to a JsonScan as they go by;
+* closing the stream releases the savepoint if they made a json document
+* and rolls back to it if not.
+*
+* A packed value is read through zlib's inflate a blob chunk at a time.
+* Written values are never packed: packing needs the whole text.
+*****************************************************************************/
+
+#define INFLATE_CHUNK 16384
+
+typedef struct LPAppValueStream_t {
+    LPAppHandle_t* handle;
+    sqlite3_blob* blob;
+    gchar*   key;               /* writing only */
+    int      size;              /* of the text, and how much is read */
+    int      offset;
+    z_stream* inflater;         /* reading a packed value only */
+    uint8_t* in;
+    int      packedSize;
+    int      packedOffset;
+    bool     writing;
+    JsonScan scan;
+} LPAppValueStream_t;
+
+static LPErr
+openBlob( LPAppHandle_t* handle, sqlite3_int64 rowid, bool writing,
+          LPAppValueStream* stream )
+{
+    sqlite3_blob* blob;
+    LPErr err = sqlerr_to_lperr( sqlite3_blob_open( handle->pDb, "main",
+                                                    "data", "value", rowid,
+                                                    writing ? 1 : 0, &blob ) );
+    if ( LP_ERR_NONE == err ) {
+        LPAppValueStream_t* strm = g_new0( LPAppValueStream_t, 1 );
+        strm->handle = handle;
+        strm->blob = blob;
+        strm->size = sqlite3_blob_bytes( blob );
+        strm->writing = writing;
+        jsonScanInit( &strm->scan );
+        ++handle->streams;
+        handle->streamWriting = handle->streamWriting || writing;
+        *stream = (LPAppValueStream)strm;
+    }
+    return err;
+} /* openBlob */
+
+/* Switch a new read stream from the packed bytes to the text in them. */
+static LPErr
+startInflate( LPAppValueStream_t* strm )
+{
+    LPErr err = LP_ERR_DBERROR;     /* damaged, as lp_unpack() would say */
+    uint8_t header[PACKED_HEADER_SIZE];
+    size_t textLen;
+    strm->packedSize = strm->size;
+    strm->packedOffset = MIN( PACKED_HEADER_SIZE, strm->size );
+    if ( SQLITE_OK == sqlite3_blob_read( strm->blob, header,
+                                         strm->packedOffset, 0 )
+         && packedTextLength( header, strm->packedSize, &textLen )
+         && textLen <= INT_MAX ) {
+        strm->inflater = g_new0( z_stream, 1 );
+        if ( Z_OK == inflateInit( strm->inflater ) ) {
+            strm->in = g_malloc( INFLATE_CHUNK );
+            strm->size = (int)textLen;
+            err = LP_ERR_NONE;
+        } else {
+            g_free( strm->inflater );
+            strm->inflater = NULL;
+        }
+    }
+    return err;
+} /* startInflate */
+
+/* LPAppReadValue for a packed value: fill buf with exactly len bytes. */
+static LPErr
+inflateChunk( LPAppValueStream_t* strm, char* buf, int len )
+{
+    z_stream* zs = strm->inflater;
+    int result = SQLITE_OK;
+    int zerr = Z_OK;
+    zs->next_out = (Bytef*)buf;
+    zs->avail_out = len;
+    while ( zs->avail_out > 0 && Z_OK == zerr && SQLITE_OK == result ) {
+        if ( 0 == zs->avail_in && strm->packedOffset < strm->packedSize ) {
+            int count = MIN( INFLATE_CHUNK,
+                             strm->packedSize - strm->packedOffset );
+            result = sqlite3_blob_read( strm->blob, strm->in, count,
+                                        strm->packedOffset );
+            strm->packedOffset += count;
+            zs->next_in = strm->in;
+            zs->avail_in = count;
+        }
+        if ( SQLITE_OK == result ) {
+            zerr = inflate( zs, Z_NO_FLUSH );
+        }
+    }
+    LPErr err = sqlerr_to_lperr( result );
+    if ( LP_ERR_NONE == err && zs->avail_out > 0 ) {
+        err = LP_ERR_DBERROR;   /* ended early, or damaged */
+    }
+    return err;
+} /* inflateChunk */
+
+LPErr
+LPAppOpenValueRead( LPAppHandle handle, const char* key,
+                    LPAppValueStream* stream, size_t* size )
 {
     g_return_val_if_fail( handle != NULL, -EINVAL );
     g_return_val_if_fail( key != NULL, -EINVAL );
-    g_return_val_if_fail( jstr != NULL, -EINVAL );
-
-    gchar* value = NULL;
+    g_return_val_if_fail( stream != NULL, -EINVAL );
+    LPAppHandle_t* hndl = (LPAppHandle_t*)handle;
 
-    LPErr err = runSQL( handle, true, getValue, &value,
-                        "SELECT VALUE FROM data WHERE key = \'%q\';", key );
+    lockHandle( handle );
 
-    if ( err == 0 ) {
-        if ( !value ) {         /* will be null if getValue() never fired */
+    sqlite3_stmt* stmt;
+    LPErr err = getStmt( hndl, STMT_ROWID, &stmt );
+    if ( LP_ERR_NONE == err ) {
+        sqlite3_bind_text( stmt, 1, key, -1, SQLITE_STATIC );
+        int result = sqlite3_step( stmt );
+        sqlite3_int64 rowid = sqlite3_column_int64( stmt, 0 );
+        bool packed = sqlite3_column_int( stmt, 1 );
+        (void)sqlite3_reset( stmt );
+        if ( SQLITE_DONE == result ) {
             err = LP_ERR_NO_SUCH_KEY;
-        } else if ( !check_is_json(value) ) {
-            g_critical( "non-json value stored: %s", value );
-            err = LP_ERR_VALUENOTJSON;
+        } else if ( SQLITE_ROW != result ) {
+            err = sqlerr_to_lperr( result );
         } else {
-            *jstr = value;
-            value = NULL;
+            err = openBlob( hndl, rowid, false, stream );
+        }
+        if ( LP_ERR_NONE == err && packed ) {
+            err = startInflate( (LPAppValueStream_t*)*stream );
+            if ( LP_ERR_NONE != err ) {
+                (void)LPAppCloseValue( *stream, false );
+            }
         }
     }
-
-    g_free( (gchar*)value );
+    if ( LP_ERR_NONE == err && NULL != size ) {
+        *size = ((LPAppValueStream_t*)*stream)->size;
+    }
+    unlockHandle( handle );
     return err;
-}
+} /* LPAppOpenValueRead */
 
 LPErr
-LPAppCopyValueString( LPAppHandle handle, const char* key, char** str )
+LPAppOpenValueWrite( LPAppHandle handle, const char* key, size_t size,
+                     LPAppValueStream* stream )
 {
-    struct json_object* json;
-    LPErr err = LPAppCopyValueCJ( handle, key, &json );
-    if ( LP_ERR_NONE == err && json_object_is_type( json, json_type_array ) )
-    {
-        /* assume it's an array of length one.  Return the string at elem 0. */
-        struct json_object* child = json_object_array_get_idx( json, 0 );
+    g_return_val_if_fail( handle != NULL, -EINVAL );
+    g_return_val_if_fail( key != NULL, -EINVAL );
+    g_return_val_if_fail( stream != NULL, -EINVAL );
+    LPAppHandle_t* hndl = (LPAppHandle_t*)handle;
 
-        if ( (NULL != child) && ( json_object_is_type( child, json_type_string)) )
-        {
-            *str = g_strdup( json_object_get_string( child ) );
+    lockHandle( handle );
+
+    LPErr err;
+    sqlite3_stmt* stmt;
+    if ( *key == '\0' ) {       /* empty string? */
+        err = LP_ERR_ILLEGALKEY;
+    } else if ( size > INT_MAX || hndl->streamWriting ) {
+        err = LP_ERR_PARAM_ERR;
+    } else if ( LP_ERR_NONE == (err = getStmt( hndl, STMT_SET_SPACE, &stmt ))
+                && LP_ERR_NONE == (err = runSQL( hndl, NULL, NULL,
+                                                 "SAVEPOINT lp_stream;" )) ) {
+        sqlite3_bind_text( stmt, 1, key, -1, SQLITE_STATIC );
+        sqlite3_bind_int( stmt, 2, (int)size );
+        sqlite3_bind_int( stmt, 3, VALUE_FLAG_CHECKED );
+        err = stepDone( stmt );
+        if ( LP_ERR_NONE == err ) {
+            err = openBlob( hndl, sqlite3_last_insert_rowid( hndl->pDb ),
+                            true, stream );
         }
-        else
-        {
-            err = LP_ERR_VALUENOTJSON;
+        if ( LP_ERR_NONE == err ) {
+            ((LPAppValueStream_t*)*stream)->key = g_strdup( key );
+        }
+        if ( LP_ERR_NONE != err ) {
+            (void)runSQL( hndl, NULL, NULL,
+                          "ROLLBACK TO lp_stream; RELEASE lp_stream;" );
         }
-        json_object_put( json );
     }
+    unlockHandle( handle );
     return err;
-}
+} /* LPAppOpenValueWrite */
 
 LPErr
-LPAppCopyValueInt( LPAppHandle handle, const char* key, int* intValue )
+LPAppReadValue( LPAppValueStream stream, char* buf, size_t len, size_t* got )
 {
-    struct json_object* json;
-    LPErr err = LPAppCopyValueCJ( handle, key, &json );
-    if ( LP_ERR_NONE == err )
-    {
-        /* assume it's an array of length one.  Return the string at elem 0. */
-        struct json_object* child = json_object_array_get_idx( json, 0 );
-        if ( (NULL != child) && json_object_is_type( child, json_type_string) )
-        {
-            *intValue = atoi( json_object_get_string( child ) );
-        }
-        else
-        {
-            err = LP_ERR_VALUENOTJSON;
-        }
-        json_object_put( json );
-    }
+    g_return_val_if_fail( stream != NULL, -EINVAL );
+    g_return_val_if_fail( buf != NULL || len == 0, -EINVAL );
+    g_return_val_if_fail( got != NULL, -EINVAL );
+    LPAppValueStream_t* strm = (LPAppValueStream_t*)stream;
 
+    lockHandle( strm->handle );
+
+    int count = strm->size - strm->offset;
+    if ( len < (size_t)count ) {
+        count = (int)len;
+    }
+    LPErr err;
+    if ( NULL != strm->inflater ) {
+        err = inflateChunk( strm, buf, count );
+    } else {
+        err = sqlerr_to_lperr( sqlite3_blob_read( strm->blob, buf, count,
+                                                  strm->offset ) );
+    }
+    if ( LP_ERR_NONE == err ) {
+        strm->offset += count;
+        *got = count;
+    }
+    unlockHandle( strm->handle );
     return err;
-}
+} /* LPAppReadValue */
 
 LPErr
-LPAppCopyValueCJ( LPAppHandle handle, const char* key, struct json_object** json )
+LPAppWriteValue( LPAppValueStream stream, const char* buf, size_t len )
 {
-    g_return_val_if_fail( handle != NULL, -EINVAL );
-    g_return_val_if_fail( key != NULL, -EINVAL );
-    g_return_val_if_fail( json != NULL, -EINVAL );
+    g_return_val_if_fail( stream != NULL, -EINVAL );
+    g_return_val_if_fail( buf != NULL || len == 0, -EINVAL );
+    LPAppValueStream_t* strm = (LPAppValueStream_t*)stream;
 
-    char* jstr = NULL;
-    LPErr err = LPAppCopyValue( handle, key, &jstr );
+    lockHandle( strm->handle );
 
-    if ( LP_ERR_NONE == err )
-    {
-        err = strToJsonWithCheck( jstr, json );
+    LPErr err;
+    if ( !strm->writing || len > (size_t)(strm->size - strm->offset) ) {
+        err = LP_ERR_PARAM_ERR;
+    } else {
+        err = sqlerr_to_lperr( sqlite3_blob_write( strm->blob, buf, (int)len,
+                                                   strm->offset ) );
+        if ( LP_ERR_NONE == err ) {
+            strm->offset += len;
+            (void)jsonScanFeed( &strm->scan, buf, len );
+        }
     }
-
-    g_free( jstr );
-    return err;
-}
-
-static LPErr
-copy_as_string( struct json_object* json, char** out )
-{
-    LPErr err = LP_ERR_NONE;
-    const char* txt = json_object_get_string( json );
-    g_assert( !!txt );
-    *out = g_strdup( txt );
+    unlockHandle( strm->handle );
     return err;
-}
+} /* LPAppWriteValue */
 
-static int
-addValueToArray( void* context, int nColumns, char** colValues, char** colNames )
+/* Whether what a write stream wrote makes a json document. */
+static bool
+writtenIsJson( LPAppValueStream_t* strm )
 {
-    g_assert( nColumns == 1 );
-    struct json_object* jarray = (struct json_object*)context;
-    struct json_object* jstr = json_object_new_string( colValues[0] );
-
-    json_object_array_add( jarray, jstr );
-
-    return 0;
-} /* addValueToArray */
+    bool isJson = JSONSCAN_VALID == jsonScanFinish( &strm->scan );
+    if ( !isJson ) {
+        /* not strict json: read it back for json-c's opinion */
+        sqlite3_stmt* stmt;
+        if ( LP_ERR_NONE == getStmt( strm->handle, STMT_GET, &stmt ) ) {
+            sqlite3_bind_text( stmt, 1, strm->key, -1, SQLITE_STATIC );
+            if ( SQLITE_ROW == sqlite3_step( stmt ) ) {
+                isJson = check_is_json(
+                    (const char*)sqlite3_column_text( stmt, 0 ) );
+            }
+            (void)sqlite3_reset( stmt );
+        }
+    }
+    return isJson;
+} /* writtenIsJson */
 
 LPErr
-LPAppCopyKeys( LPAppHandle handle, char** jstr )
+LPAppCloseValue( LPAppValueStream stream, bool keep )
 {
-    LPErr err = -EINVAL;
-    g_return_val_if_fail( handle != NULL, -EINVAL );
-    g_return_val_if_fail( jstr != NULL, -EINVAL );
-
-    struct json_object* jarray = json_object_new_array();
-
-    err = runSQL( handle, true, addValueToArray, jarray, "SELECT key FROM data;" );
-
-    if ( 0 == err ) {
-        err = copy_as_string( jarray, jstr );
+    g_return_val_if_fail( stream != NULL, -EINVAL );
+    LPAppValueStream_t* strm = (LPAppValueStream_t*)stream;
+    LPAppHandle_t* hndl = strm->handle;
+
+    lockHandle( hndl );
+
+    LPErr err = sqlerr_to_lperr( sqlite3_blob_close( strm->blob ) );
+    --hndl->streams;
+    if ( strm->writing ) {
+        if ( LP_ERR_NONE != err ) {
+            keep = false;
+        } else if ( keep && !writtenIsJson( strm ) ) {
+            err = LP_ERR_VALUENOTJSON;
+            keep = false;
+        }
+        LPErr err2 = runSQL( hndl, NULL, NULL, keep
+                             ? "RELEASE lp_stream;"
+                             : "ROLLBACK TO lp_stream; RELEASE lp_stream;" );
+        if ( LP_ERR_NONE == err ) {
+            err = err2;
+        }
+        hndl->streamWriting = false;
+        dropCache( hndl );      /* may have loaded the spaces */
+    }
+    if ( NULL != strm->inflater ) {
+        (void)inflateEnd( strm->inflater );
+        g_free( strm->inflater );
+        g_free( strm->in );
     }
+    g_free( strm->key );
+    g_free( strm );
 
-    json_object_put( jarray );
+    unlockHandle( hndl );
     return err;
-} /* LPAppCopyKeys */
+} /* LPAppCloseValue */
 
-LPErr
-LPAppCopyKeysCJ( LPAppHandle handle, struct json_object** json )
-{
-    LPErr err = -EINVAL;
-    g_return_val_if_fail( handle != NULL, -EINVAL );
-    g_return_val_if_fail( json != NULL, -EINVAL );
+/*****************************************************************************
+* Asynchronous calls
+*
+* Each call is a job for a thread pool of one thread, so jobs run in the
+* order they're queued, which is all the per-appId ordering promised.  The
+* thread gets its own handle for each job, and the DB pool and options are
+* already safe to share, so the job is just the synchronous call.  Results
+* go back to the caller's context as idle sources, attached in job order and
+* so dispatched in it too.
+*****************************************************************************/
 
-    struct json_object* jarray = json_object_new_array();
+typedef enum {
+    ASYNC_COPY,
+    ASYNC_COPY_PATH,
+    ASYNC_SET,
+    ASYNC_MERGE,
+    ASYNC_REMOVE,
+    ASYNC_COPY_IF_CHANGED,
+    ASYNC_CHECKPOINT,           /* these on the appId, not through a handle */
+    ASYNC_GET_SPACE,
+    ASYNC_RECLAIM
+} AsyncOp;
+
+typedef struct AsyncCall {
+    AsyncOp  op;
+    gchar*   appId;
+    gchar*   key;
+    gchar*   path;              /* for ASYNC_COPY_PATH */
+    gchar*   value;             /* to set or merge, or as copied */
+    long long version;          /* ASYNC_COPY_IF_CHANGED's, known then found */
+    unsigned int pages;         /* ASYNC_GET_SPACE's, or ASYNC_RECLAIM's max */
+    unsigned int freePages;     /* ASYNC_GET_SPACE's */
+    LPErr    err;
+    LPAppAsyncFunc func;
+    LPAppAsyncVersionFunc versionFunc;  /* for ASYNC_COPY_IF_CHANGED */
+    LPAppAsyncSpaceFunc spaceFunc;      /* for ASYNC_GET_SPACE */
+    void*    ctx;
+    GMainContext* context;
+} AsyncCall;
+
+G_LOCK_DEFINE_STATIC( async );
+static GThreadPool* sAsyncPool;
 
-    err = runSQL( handle, true, addValueToArray, jarray, "SELECT key FROM data;" );
+static void
+freeAsyncCall( gpointer data )
+{
+    AsyncCall* call = (AsyncCall*)data;
+    g_main_context_unref( call->context );
+    g_free( call->appId );
+    g_free( call->key );
+    g_free( call->path );
+    g_free( call->value );
+    g_free( call );
+}
 
-    if ( LP_ERR_NONE == err )
-    {
-        *json = jarray;
-    }
-    else
-    {
-        json_object_put( jarray );
+static gboolean
+completeAsyncCall( gpointer data )
+{
+    AsyncCall* call = (AsyncCall*)data;
+    bool copied = ASYNC_COPY == call->op || ASYNC_COPY_PATH == call->op;
+    if ( ASYNC_COPY_IF_CHANGED == call->op ) {
+        (*call->versionFunc)( call->err, call->value, call->version,
+                              call->ctx );
+    } else if ( ASYNC_GET_SPACE == call->op ) {
+        (*call->spaceFunc)( call->err, call->pages, call->freePages,
+                            call->ctx );
+    } else {
+        (*call->func)( call->err, copied ? call->value : NULL, call->ctx );
     }
-    return err;
+    return false;
 }
 
-static int
-addKeyValueToArray( void* context, int nColumns, char** colValues, char** colNames )
+/* The synchronous call a handle call stands for, on a handle of its own. */
+static LPErr
+runHandleCall( AsyncCall* call )
 {
-    int err = -1;
-    g_assert( nColumns == 2 );
-    struct json_object* jarray = (struct json_object*)context;
-    struct json_object* obj = json_object_new_object();
-    if ( NULL != obj ) {
-        struct json_object* value = json_tokener_parse( colValues[1] );
-        if ( value && is_toplevel_json(value) ) {
-            json_object_object_add( obj, colValues[0], value );
-            json_object_array_add( jarray, obj );
-            return 0;
+    LPAppHandle handle;
+    LPErr err = ASYNC_COPY == call->op || ASYNC_COPY_PATH == call->op
+        || ASYNC_COPY_IF_CHANGED == call->op
+        ? LPAppGetHandleReadOnly( call->appId, &handle )
+        : LPAppGetHandle( call->appId, &handle );
+    if ( LP_ERR_NONE == err ) {
+        switch ( call->op ) {
+        case ASYNC_COPY:
+            err = LPAppCopyValue( handle, call->key, &call->value );
+            break;
+        case ASYNC_COPY_PATH:
+            err = LPAppCopyValuePath( handle, call->key, call->path,
+                                      &call->value );
+            break;
+        case ASYNC_SET:
+            err = LPAppSetValue( handle, call->key, call->value );
+            break;
+        case ASYNC_MERGE:
+            err = LPAppMergeValue( handle, call->key, call->value );
+            break;
+        case ASYNC_REMOVE:
+            err = LPAppRemoveValue( handle, call->key );
+            break;
+        case ASYNC_COPY_IF_CHANGED:
+            err = LPAppCopyValueIfChanged( handle, call->key, call->version,
+                                           &call->value, &call->version );
+            break;
+        default:
+            g_assert_not_reached();
+        }
+        LPErr freeErr = LPAppFreeHandle( handle, LP_ERR_NONE == err );
+        if ( LP_ERR_NONE == err ) {
+            err = freeErr;
         }
-        json_object_put( obj );
     }
-
     return err;
-} /* addValueToArray */
+} /* runHandleCall */
 
-LPErr
-LPAppCopyAll( LPAppHandle handle, char** jstr )
+static void
+runAsyncCall( gpointer data, gpointer unused )
 {
-    LPErr err;
-    g_return_val_if_fail( handle != NULL, -EINVAL );
-    g_return_val_if_fail( jstr != NULL, -EINVAL );
-
-    struct json_object* jarray = json_object_new_array();
-
-    err = runSQL( handle, true, addKeyValueToArray, jarray, "SELECT key,value FROM data;" );
-
-    if ( 0 == err ) {
-        err = copy_as_string( jarray, jstr );
+    AsyncCall* call = (AsyncCall*)data;
+    switch ( call->op ) {
+    case ASYNC_CHECKPOINT:
+        call->err = LPAppCheckpoint( call->appId );
+        break;
+    case ASYNC_GET_SPACE:
+        call->err = LPAppGetSpace( call->appId, &call->pages,
+                                   &call->freePages );
+        break;
+    case ASYNC_RECLAIM:
+        call->err = LPAppReclaimSpace( call->appId, call->pages );
+        break;
+    default:
+        call->err = runHandleCall( call );
     }
 
-    json_object_put( jarray );
-    return err;
+    /* Default, not idle, priority: the caller's waiting on this */
+    GSource* source = g_idle_source_new();
+    g_source_set_priority( source, G_PRIORITY_DEFAULT );
+    g_source_set_callback( source, completeAsyncCall, call, freeAsyncCall );
+    (void)g_source_attach( source, call->context );
+    g_source_unref( source );
+} /* runAsyncCall */
+
+static AsyncCall*
+newAsyncCall( AsyncOp op, const char* appId, const char* key,
+              LPAppAsyncFunc func, void* ctx )
+{
+    AsyncCall* call = g_new0( AsyncCall, 1 );
+    call->op = op;
+    call->appId = g_strdup( appId );
+    call->key = g_strdup( key );
+    call->func = func;
+    call->ctx = ctx;
+    call->context = g_main_context_ref_thread_default();
+    return call;
 }
 
-LPErr
-LPAppCopyAllCJ( LPAppHandle handle, struct json_object** json )
+/* Takes call, freeing it if it can't be queued. */
+static LPErr
+queueAsyncCall( AsyncCall* call )
 {
-    char* jstr = NULL;
-    LPErr err = LPAppCopyAll( handle, &jstr );
+    LPErr err = LP_ERR_NONE;
 
-    if ( LP_ERR_NONE == err )
-    {
-        err = strToJsonWithCheck( jstr, json );
+    G_LOCK( async );
+    if ( NULL == sAsyncPool ) {
+        GError* error = NULL;
+        sAsyncPool = g_thread_pool_new( runAsyncCall, NULL, 1, FALSE, &error );
+        if ( NULL == sAsyncPool ) {
+            g_critical( "%s: no thread: %s", __func__, error->message );
+            g_error_free( error );
+            err = LP_ERR_INTERNAL;
+        }
+    }
+    if ( LP_ERR_NONE == err ) {
+        (void)g_thread_pool_push( sAsyncPool, call, NULL );
+    }
+    G_UNLOCK( async );
+    if ( LP_ERR_NONE != err ) {
+        freeAsyncCall( call );
     }
-    g_free( jstr );
     return err;
+} /* queueAsyncCall */
+
+LPErr
+LPAppCopyValueAsync( const char* appId, const char* key,
+                     LPAppAsyncFunc func, void* ctx )
+{
+    g_return_val_if_fail( appId != NULL, -EINVAL );
+    g_return_val_if_fail( key != NULL, -EINVAL );
+    g_return_val_if_fail( func != NULL, -EINVAL );
+    return queueAsyncCall( newAsyncCall( ASYNC_COPY, appId, key,
+                                         func, ctx ) );
 }
 
-static LPErr
-setValueString( LPAppHandle handle, const char* key, const char* jstr )
+LPErr
+LPAppCopyValuePathAsync( const char* appId, const char* key, const char* path,
+                         LPAppAsyncFunc func, void* ctx )
 {
-        /* Use REPLACE, not INSERT, to avoid duplicates.  */
-    return runSQL( handle, true, NULL, NULL,
-                   "REPLACE INTO data VALUES( \'%q\', \'%q\' );", key, jstr );
+    g_return_val_if_fail( appId != NULL, -EINVAL );
+    g_return_val_if_fail( key != NULL, -EINVAL );
+    g_return_val_if_fail( path != NULL, -EINVAL );
+    g_return_val_if_fail( func != NULL, -EINVAL );
+    AsyncCall* call = newAsyncCall( ASYNC_COPY_PATH, appId, key, func, ctx );
+    call->path = g_strdup( path );
+    return queueAsyncCall( call );
 }
 
 LPErr
-LPAppSetValue( LPAppHandle handle, const char* key, const char* const jstr )
+LPAppSetValueAsync( const char* appId, const char* key, const char* jstr,
+                    LPAppAsyncFunc func, void* ctx )
 {
-    g_return_val_if_fail( handle != NULL, -EINVAL );
+    g_return_val_if_fail( appId != NULL, -EINVAL );
     g_return_val_if_fail( key != NULL, -EINVAL );
     g_return_val_if_fail( jstr != NULL, -EINVAL );
-
-    LPErr err;
-    if ( *key == '\0' ) {       /* empty string? */
-        err = LP_ERR_ILLEGALKEY;
-    } else if ( !check_is_json( jstr ) ) {
-        err = LP_ERR_VALUENOTJSON;
-    } else {
-        /* Use REPLACE, not INSERT, to avoid duplicates.  */
-        err = setValueString( handle, key, jstr );
-    }
-    return err;
-} /* LPAppSetValue */
+    g_return_val_if_fail( func != NULL, -EINVAL );
+    AsyncCall* call = newAsyncCall( ASYNC_SET, appId, key, func, ctx );
+    call->value = g_strdup( jstr );
+    return queueAsyncCall( call );
+}
 
 LPErr
-LPAppSetValueString( LPAppHandle handle, const char* key, const char* const str )
+LPAppMergeValueAsync( const char* appId, const char* key, const char* patch,
+                      LPAppAsyncFunc func, void* ctx )
 {
-    LPErr err = LP_ERR_MEM;
-
-    struct json_object* array = json_object_new_array();
-    if ( NULL != array )
-    {
-        struct json_object* jstr = json_object_new_string( str );
-        if ( NULL != jstr )
-        {
-            json_object_array_add( array, jstr );
-            err = LPAppSetValueCJ( handle, key, array );
-        }
-        json_object_put( array );
-    }
-    return err;
+    g_return_val_if_fail( appId != NULL, -EINVAL );
+    g_return_val_if_fail( key != NULL, -EINVAL );
+    g_return_val_if_fail( patch != NULL, -EINVAL );
+    g_return_val_if_fail( func != NULL, -EINVAL );
+    AsyncCall* call = newAsyncCall( ASYNC_MERGE, appId, key, func, ctx );
+    call->value = g_strdup( patch );
+    return queueAsyncCall( call );
 }
 
 LPErr
-LPAppSetValueInt( LPAppHandle handle, const char* key, int intValue )
+LPAppRemoveValueAsync( const char* appId, const char* key,
+                       LPAppAsyncFunc func, void* ctx )
 {
-    LPErr err = LP_ERR_MEM;
-
-    struct json_object* array = json_object_new_array();
-    if ( NULL != array )
-    {
-        char buf[32];
-        snprintf( buf, sizeof(buf), "%d", intValue );
-        struct json_object* jstr = json_object_new_string( buf );
-        if ( NULL != jstr )
-        {
-            json_object_array_add( array, jstr );
-            err = LPAppSetValueCJ( handle, key, array );
-        }
-        json_object_put( array );
-    }
-    return err;
-} /* LPAppSetValueInt */
+    g_return_val_if_fail( appId != NULL, -EINVAL );
+    g_return_val_if_fail( key != NULL, -EINVAL );
+    g_return_val_if_fail( func != NULL, -EINVAL );
+    return queueAsyncCall( newAsyncCall( ASYNC_REMOVE, appId, key,
+                                         func, ctx ) );
+}
 
 LPErr
-LPAppSetValueCJ( LPAppHandle handle, const char* key, struct json_object* json )
+LPAppCopyValueIfChangedAsync( const char* appId, const char* key,
+                              long long knownVersion,
+                              LPAppAsyncVersionFunc func, void* ctx )
 {
-    g_return_val_if_fail( handle != NULL, -EINVAL );
+    g_return_val_if_fail( appId != NULL, -EINVAL );
     g_return_val_if_fail( key != NULL, -EINVAL );
-    g_return_val_if_fail( json != NULL, -EINVAL );
-
-    LPErr err;
-    if ( *key == '\0' ) {       /* empty string? */
-        err = LP_ERR_ILLEGALKEY;
-    } else if ( !json_object_is_type(json, json_type_object)
-                && !json_object_is_type(json, json_type_array) ) {
-        err = LP_ERR_VALUENOTJSON;
-    } else {
-        const char* jstr = json_object_get_string( json );
-        if ( !!jstr ) {
-            err = setValueString( handle, key, jstr );
-        } else {
-            g_critical( "json supplied to %s not acceptable to json", __func__ );
-            err = LP_ERR_VALUENOTJSON;
-        }
-    }
-    return err;
-} /* LPAppSetValueCJ */
+    g_return_val_if_fail( func != NULL, -EINVAL );
+    AsyncCall* call = newAsyncCall( ASYNC_COPY_IF_CHANGED, appId, key,
+                                    NULL, ctx );
+    call->version = knownVersion;
+    call->versionFunc = func;
+    return queueAsyncCall( call );
+}
 
 LPErr
-LPAppRemoveValue( LPAppHandle handle, const char* key )
+LPAppCheckpointAsync( const char* appId, LPAppAsyncFunc func, void* ctx )
 {
-    g_return_val_if_fail( handle != NULL, -EINVAL );
-    g_return_val_if_fail( key != NULL, -EINVAL );
-    LPAppHandle_t* hndl = (LPAppHandle_t*)handle;
+    g_return_val_if_fail( appId != NULL, -EINVAL );
+    g_return_val_if_fail( func != NULL, -EINVAL );
+    return queueAsyncCall( newAsyncCall( ASYNC_CHECKPOINT, appId, NULL,
+                                         func, ctx ) );
+}
 
-    LPErr err = -EINVAL;
+LPErr
+LPAppGetSpaceAsync( const char* appId, LPAppAsyncSpaceFunc func, void* ctx )
+{
+    g_return_val_if_fail( appId != NULL, -EINVAL );
+    g_return_val_if_fail( func != NULL, -EINVAL );
+    AsyncCall* call = newAsyncCall( ASYNC_GET_SPACE, appId, NULL, NULL, ctx );
+    call->spaceFunc = func;
+    return queueAsyncCall( call );
+}
 
-    err = runSQL( handle, true, NULL, NULL, "DELETE FROM data WHERE key = \'%q\';", key );
-    if (0 == sqlite3_changes(hndl->pDb))
-    {
-        err = LP_ERR_NO_SUCH_KEY;
-    }
-    return err;
+LPErr
+LPAppReclaimSpaceAsync( const char* appId, unsigned int maxPages,
+                        LPAppAsyncFunc func, void* ctx )
+{
+    g_return_val_if_fail( appId != NULL, -EINVAL );
+    g_return_val_if_fail( maxPages > 0, LP_ERR_PARAM_ERR );
+    g_return_val_if_fail( func != NULL, -EINVAL );
+    AsyncCall* call = newAsyncCall( ASYNC_RECLAIM, appId, NULL, func, ctx );
+    call->pages = maxPages;
+    return queueAsyncCall( call );
 }
 
 /*****************************************************************************
@@ -1348,6 +5357,15 @@ LPErrorString( LPErr err, char** str )
     case LP_ERR_PERM:
         msg = "Permission Error";
         break;
+    case LP_ERR_WRONGTYPE:
+        msg = "value is not of the type asked for";
+        break;
+    case LP_ERR_NOT_MODIFIED:
+        msg = "value has not changed";
+        break;
+    case LP_ERR_NO_HISTORY:
+        msg = "changes that far back are no longer known";
+        break;
     }
 
     if ( !msg ) {
@@ -0,0 +1,81 @@
+// Copyright (c) 2026 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+/* -*-mode: C; fill-column: 78; c-basic-offset: 4; -*- */
+
+#include "packvalue.h"
+
+#include <stdlib.h>
+#include <zlib.h>
+
+uint8_t*
+packValue( const char* text, size_t len, size_t* packedLen )
+{
+    uint8_t* packed = NULL;
+    uLongf bound = compressBound( len );
+    if ( len <= PACKED_MAX_TEXT && len > PACKED_HEADER_SIZE
+         && NULL != (packed = malloc( PACKED_HEADER_SIZE + bound )) ) {
+        packed[0] = len >> 24;
+        packed[1] = len >> 16;
+        packed[2] = len >> 8;
+        packed[3] = len;
+        if ( Z_OK != compress2( packed + PACKED_HEADER_SIZE, &bound,
+                                (const Bytef*)text, len,
+                                Z_DEFAULT_COMPRESSION )
+             || PACKED_HEADER_SIZE + bound >= len ) {
+            free( packed );     /* doesn't shrink: not worth inflating */
+            packed = NULL;
+        } else {
+            *packedLen = PACKED_HEADER_SIZE + bound;
+        }
+    }
+    return packed;
+}
+
+bool
+packedTextLength( const uint8_t* packed, size_t len, size_t* textLen )
+{
+    bool ok = len > PACKED_HEADER_SIZE;
+    if ( ok ) {
+        *textLen = ((uint32_t)packed[0] << 24) | ((uint32_t)packed[1] << 16)
+            | ((uint32_t)packed[2] << 8) | packed[3];
+        ok = *textLen <= PACKED_MAX_TEXT
+            && *textLen <= (uint64_t)(len - PACKED_HEADER_SIZE)
+                           * PACKED_MAX_RATIO;
+    }
+    return ok;
+}
+
+char*
+unpackValue( const uint8_t* packed, size_t len, size_t* textLen )
+{
+    char* text = NULL;
+    size_t want;
+    if ( packedTextLength( packed, len, &want )
+         && NULL != (text = malloc( want + 1 )) ) {
+        uLongf got = want;
+        if ( Z_OK != uncompress( (Bytef*)text, &got,
+                                 packed + PACKED_HEADER_SIZE,
+                                 len - PACKED_HEADER_SIZE )
+             || got != want ) {
+            free( text );
+            text = NULL;
+        } else {
+            text[want] = '\0';
+            *textLen = want;
+        }
+    }
+    return text;
+}
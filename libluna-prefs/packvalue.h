@@ -0,0 +1,60 @@
+// Copyright (c) 2026 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+/* -*-mode: C; fill-column: 78; c-basic-offset: 4; -*- */
+
+#ifndef _PACKVALUE_H_
+#define _PACKVALUE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Compressed values, as LP_OPT_COMPRESS_MIN stores them: the text's length
+ * as 4 big-endian bytes, then the text as a zlib stream.  They go in the
+ * value column as BLOBs, where text values are TEXT, so the column's type
+ * says which a row holds and anything that puts text back there -- a
+ * restore, an older library -- needs no flag kept in step with it.
+ */
+
+#define PACKED_HEADER_SIZE 4
+#define PACKED_MAX_TEXT    1000000000  /* sqlite's default max length */
+#define PACKED_MAX_RATIO   1032        /* deflate's best possible ratio */
+
+/*
+ * Compress len bytes of text.  Returns a malloc()ed packed value and sets
+ * *packedLen, or returns NULL if that wouldn't be smaller than the text
+ * (or memory ran out), in which case the text is stored as it is.
+ */
+uint8_t* packValue( const char* text, size_t len, size_t* packedLen );
+
+/*
+ * The text of a packed value, malloc()ed, NUL terminated and its length
+ * (less the NUL) in *textLen; NULL if packed is damaged -- its header
+ * doesn't pass packedTextLength(), or the stream doesn't inflate to exactly
+ * that much text -- or memory ran out.
+ */
+char* unpackValue( const uint8_t* packed, size_t len, size_t* textLen );
+
+/*
+ * Length of a packed value's text, from its header.  The header can't be
+ * trusted with an allocation, so false if it claims more than
+ * PACKED_MAX_TEXT, or more than a stream of the size that follows could
+ * inflate to, as well as if packed is too short to have one.
+ */
+bool packedTextLength( const uint8_t* packed, size_t len, size_t* textLen );
+
+#endif /* #ifndef _PACKVALUE_H_ */
@@ -0,0 +1,122 @@
+// Copyright (c) 2026 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+/* -*-mode: C; fill-column: 78; c-basic-offset: 4; -*- */
+
+#include "readcache.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define MIN_ARENA   1024
+#define MIN_ENTRIES 32
+
+ReadCache*
+readCacheNew( size_t limit )
+{
+    ReadCache* cache = calloc( 1, sizeof(ReadCache) );
+    if ( NULL != cache ) {
+        cache->complete = true;
+        /* offsets are 32 bits */
+        cache->limit = limit < READCACHE_MAX_SIZE ? limit : READCACHE_MAX_SIZE;
+    }
+    return cache;
+}
+
+void
+readCacheFree( ReadCache* cache )
+{
+    if ( NULL != cache ) {
+        free( cache->arena );
+        free( cache->entries );
+        free( cache );
+    }
+}
+
+/* Grow *buf to hold at least need units of size bytes, doubling. */
+static bool
+reserve( void** buf, size_t* have, size_t need, size_t size, size_t min )
+{
+    bool ok = true;
+    if ( need > *have ) {
+        size_t want = *have < min ? min : *have;
+        while ( want < need ) {
+            want *= 2;
+        }
+        void* grown = realloc( *buf, want * size );
+        if ( NULL == grown ) {
+            ok = false;
+        } else {
+            *buf = grown;
+            *have = want;
+        }
+    }
+    return ok;
+}
+
+bool
+readCacheAdd( ReadCache* cache, const char* key, size_t keyLen,
+              const char* value, size_t valueLen, bool isJson )
+{
+    size_t bytes = keyLen + 1 + valueLen + 1;
+    size_t used = cache->size + (cache->count + 1) * sizeof(ReadCacheEntry);
+
+    if ( !cache->complete || used + bytes > cache->limit
+         || !reserve( (void**)&cache->arena, &cache->alloced,
+                      cache->size + bytes, 1, MIN_ARENA )
+         || !reserve( (void**)&cache->entries, &cache->maxEntries,
+                      cache->count + 1, sizeof(ReadCacheEntry), MIN_ENTRIES ) ) {
+        cache->complete = false;
+    } else {
+        ReadCacheEntry* entry = &cache->entries[cache->count++];
+        entry->key = cache->size;
+        entry->value = cache->size + keyLen + 1;
+        entry->isJson = isJson;
+        memcpy( cache->arena + entry->key, key, keyLen );
+        cache->arena[entry->key + keyLen] = '\0';
+        memcpy( cache->arena + entry->value, value, valueLen );
+        cache->arena[entry->value + valueLen] = '\0';
+        cache->size += bytes;
+    }
+    return cache->complete;
+}
+
+size_t
+readCacheLowerBound( const ReadCache* cache, const char* key )
+{
+    size_t lo = 0;
+    size_t hi = cache->count;
+    while ( lo < hi ) {
+        size_t mid = lo + (hi - lo) / 2;
+        if ( strcmp( cache->arena + cache->entries[mid].key, key ) < 0 ) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+const ReadCacheEntry*
+readCacheFind( const ReadCache* cache, const char* key )
+{
+    size_t ii = readCacheLowerBound( cache, key );
+    const ReadCacheEntry* entry = NULL;
+    if ( ii < cache->count
+         && 0 == strcmp( cache->arena + cache->entries[ii].key, key ) ) {
+        entry = &cache->entries[ii];
+    }
+    return entry;
+}
@@ -0,0 +1,87 @@
+// Copyright (c) 2026 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+/* -*-mode: C; fill-column: 78; c-basic-offset: 4; -*- */
+
+#ifndef _READCACHE_H_
+#define _READCACHE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * An immutable copy of an app DB's key/value pairs, for answering reads
+ * without going to sqlite.  Keys and values live back to back, NUL
+ * terminated and in key order, in one arena; an array of offsets into it,
+ * in the same order, is binary searched.  So a lookup touches the offsets
+ * and the few keys it compares against, and a prefix walk reads the arena
+ * front to back.  Nothing per entry is allocated.
+ *
+ * It knows nothing about when it's out of date: version and changes are
+ * for the owner to stamp it with and compare against.
+ */
+
+typedef struct ReadCacheEntry {
+    uint32_t key;           /* offsets in the arena */
+    uint32_t value;
+    bool     isJson;        /* false if the stored value was found not to be */
+} ReadCacheEntry;
+
+#define READCACHE_MAX_SIZE UINT32_MAX
+
+typedef struct ReadCache {
+    int64_t version;        /* owner's stamps, from when it was loaded */
+    int64_t changes;
+    bool    complete;       /* false if the DB didn't fit */
+    size_t  limit;          /* bytes it may grow to */
+    size_t  count;
+    size_t  size;           /* arena bytes used */
+    size_t  alloced;
+    char*   arena;
+    ReadCacheEntry* entries;
+    size_t  maxEntries;
+} ReadCache;
+
+ReadCache* readCacheNew( size_t limit );
+void readCacheFree( ReadCache* cache );
+
+/*
+ * Append a pair.  Keys must come in strictly increasing strcmp() order.
+ * Returns false, and leaves the cache not complete, once the pairs no longer
+ * fit within the limit.
+ */
+bool readCacheAdd( ReadCache* cache, const char* key, size_t keyLen,
+                   const char* value, size_t valueLen, bool isJson );
+
+/* The entry for key, or NULL if there's none. */
+const ReadCacheEntry* readCacheFind( const ReadCache* cache, const char* key );
+
+/* Index of the first entry whose key is >= key; count if there's none. */
+size_t readCacheLowerBound( const ReadCache* cache, const char* key );
+
+static inline const char*
+readCacheKey( const ReadCache* cache, const ReadCacheEntry* entry )
+{
+    return cache->arena + entry->key;
+}
+
+static inline const char*
+readCacheValue( const ReadCache* cache, const ReadCacheEntry* entry )
+{
+    return cache->arena + entry->value;
+}
+
+#endif /* #ifndef _READCACHE_H_ */
@@ -20,6 +20,7 @@
 #include <errno.h>
 #include <sys/stat.h>
 #include "database.h"
+#include <lunaprefs.h>
 
 const char* backup_db_file = "/var/preferences/lunaprefs_backup.db";
 const char* prefs_dir = "/var/preferences";
@@ -189,13 +190,24 @@ static GList* make_list(const char* path)
     return db_files;
 }
 
+/**
+ * Back up one prefs database
+ *
+ * @param file Database file name.
+ * @param data Non-NULL if file is the shared store, which holds every app's
+ *             rows; each is backed up as if from the app's own database, so
+ *             the backup can be restored whichever layout is in use.
+ */
 void create_backup(gpointer file, gpointer data)
 {
     syslog(LOG_DEBUG, "%s db_path = %s ", __func__, (char*)file );
     gchar* db_path = (gchar*) file;
+    bool shared = (data != NULL);
 
     gchar* key_copy;
     gchar* value_copy;
+    gchar* unpacked;
+    gchar* app_path;
 
     int step_result;
     if( ! db_path )
@@ -213,7 +225,7 @@ void create_backup(gpointer file, gpointer data)
     syslog(LOG_DEBUG, "%s db_path = %s file", db_path , (char*)file );
 
     if (!prepare_statement(readDb, &prefs_db_statement,
-        "select key, value from data"))
+        shared ? "select key, value, app from data" : "select key, value from data"))
     {
         return;
     }
@@ -222,14 +234,36 @@ void create_backup(gpointer file, gpointer data)
     while(step_result == SQLITE_ROW )
     {
         key_copy  = (gchar*)sqlite3_column_text(prefs_db_statement, 0 );
-        value_copy= (gchar*)sqlite3_column_text(prefs_db_statement, 1 );
+        unpacked = NULL;
+        if (sqlite3_column_type(prefs_db_statement, 1) == SQLITE_BLOB)
+        {
+            // compressed by LP_OPT_COMPRESS_MIN; back up the text
+            if (LPAppUnpackStoredValue(sqlite3_column_blob(prefs_db_statement, 1),
+                                       sqlite3_column_bytes(prefs_db_statement, 1),
+                                       &unpacked) != LP_ERR_NONE)
+            {
+                syslog(LOG_ERR, "Failed to unpack value of key : %s", key_copy);
+            }
+            value_copy = unpacked;
+        }
+        else
+        {
+            value_copy= (gchar*)sqlite3_column_text(prefs_db_statement, 1 );
+        }
+
+        app_path = shared ? g_build_filename(prefs_dir,
+                                             (gchar*)sqlite3_column_text(prefs_db_statement, 2),
+                                             "prefsDB.sl", (gchar*)NULL)
+                          : g_strdup(db_path);
 
-        syslog(LOG_DEBUG, "path : %s, key : %s, value : %s", db_path, key_copy, value_copy );
+        syslog(LOG_DEBUG, "path : %s, key : %s, value : %s", app_path, key_copy, value_copy );
 
-        if( ! backup_action( db_path , key_copy, value_copy ) )
+        if( ! backup_action( app_path , key_copy, value_copy ) )
         {
             syslog(LOG_ERR, "backup_action() Failed");
         }
+        g_free(app_path);
+        g_free(unpacked);
         step_result = sqlite3_step(prefs_db_statement);
     }
 
@@ -240,7 +274,7 @@ void create_backup(gpointer file, gpointer data)
     }
 }
 
-static bool read_and_backup_list(GList* db_files, const gchar* abs_temp_path)
+static bool read_and_backup_list(GList* db_files, bool shared, const gchar* abs_temp_path)
 {
     syslog(LOG_DEBUG, "%s", __func__ );
     if ( !open_database( abs_temp_path , &backUpDb ) )
@@ -252,7 +286,7 @@ static bool read_and_backup_list(GList* db_files, const gchar* abs_temp_path)
     setup_database();
     if( !exec_command(backUpDb, "begin immediate transaction") )
       return FALSE;
-    g_list_foreach(db_files, create_backup, NULL);
+    g_list_foreach(db_files, create_backup, shared ? GINT_TO_POINTER(1) : NULL);
     exec_command(backUpDb, "commit");
     finalize_statement(&backup_statement);
     if( !close_database(backUpDb) )
@@ -277,11 +311,13 @@ bool create_prefs_backup()
     // Delete old backup database file
     unlink(abs_temp_path);
 
-    // make prefs database files list
-    GList* db_files = make_list(prefs_dir);
+    // make prefs database files list; with the shared store there's only the one
+    const char* shared_path = LPAppSharedStorePath();
+    GList* db_files = shared_path ? g_list_append(NULL, g_strdup(shared_path))
+                                  : make_list(prefs_dir);
 
     // make backup
-    bool result = read_and_backup_list(db_files, abs_temp_path);
+    bool result = read_and_backup_list(db_files, shared_path != NULL, abs_temp_path);
     free_list_and_data(db_files);
     return result;
 }
@@ -432,6 +468,57 @@ bool restore_action(const gchar* path)
     return true;
 }
 
+/**
+ * Restore one app's backed-up rows into the shared store
+ *
+ * Writes go through the library, as any app's would, so they wait their turn
+ * for the store rather than leaving per-app databases behind for a migration
+ * to fold in, which isn't safe with the service running.
+ *
+ * @param path The app's per-app database path, as recorded in the backup.
+ */
+static bool restore_shared_action(const gchar* path)
+{
+    syslog(LOG_DEBUG, "%s path %s", __func__, path );
+    gchar* parent_dir = g_path_get_dirname(path);
+    gchar* app_id = g_path_get_basename(parent_dir);
+    LPAppHandle handle;
+
+    LPErr err = LPAppGetHandle(app_id, &handle);
+    if (err != LP_ERR_NONE)
+    {
+        syslog(LOG_ERR, "Failed to get handle for %s : %d", app_id, err);
+        g_free(app_id);
+        g_free(parent_dir);
+        return false;
+    }
+
+    sqlite3_reset(prefs_db_statement);
+    sqlite3_bind_text( prefs_db_statement, 1, path , -1, SQLITE_TRANSIENT);
+
+    int ret = sqlite3_step(prefs_db_statement);
+    while(ret == SQLITE_ROW )
+    {
+        const gchar* key = (const gchar*)sqlite3_column_text(prefs_db_statement, 0 );
+        const gchar* value = (const gchar*)sqlite3_column_text(prefs_db_statement, 1 );
+        err = LPAppSetValue(handle, key, value);
+        if (err != LP_ERR_NONE)
+        {
+            syslog(LOG_ERR, "Failed to restore %s key : %s, value : %s err : %d", app_id, key, value, err);
+        }
+        ret = sqlite3_step(prefs_db_statement);
+    }
+
+    err = LPAppFreeHandle(handle, true);
+    if (ret != SQLITE_DONE || err != LP_ERR_NONE)
+    {
+        syslog(LOG_ERR, "Failed to restore %s (%d, %d)", app_id, ret, err);
+    }
+    g_free(app_id);
+    g_free(parent_dir);
+    return ret == SQLITE_DONE && err == LP_ERR_NONE;
+}
+
 bool begin_restore(const gchar* db_file)
 {
     syslog(LOG_DEBUG, "%s", __func__ );
@@ -439,6 +526,7 @@ bool begin_restore(const gchar* db_file)
     gchar* app_db_path = NULL;
     GList* restore_db_list = NULL;
     GList* list_iter = NULL;
+    bool shared = (LPAppSharedStorePath() != NULL);
 
     if( ! db_file )
     {
@@ -477,6 +565,17 @@ bool begin_restore(const gchar* db_file)
         return false;
     }
 
+    // with the shared store in use, per-app databases would be ignored
+    while( list_iter && shared )
+    {
+        if( !restore_shared_action( (gchar* ) list_iter->data) )
+        {
+            free_list_and_data(restore_db_list);
+            return false;
+        }
+        list_iter = list_iter->next;
+    }
+
     while( list_iter )
     {
         gchar* parent_dir = g_path_get_dirname( (gchar* ) list_iter->data );
@@ -70,6 +70,15 @@ static bool sUseSyslog = false;
 #define GET_ALL_SYS_PROP_OBJ_API "getAllSysPropertiesObj"
 
 #define EXIT_TIMER_SECONDS 30
+#define APP_DB_POOL_SIZE 32
+#define CHECKPOINT_DELAY_SECONDS 2
+#define MAINTENANCE_IDLE_MS 1000    /* quiet this long before we start */
+#define MAINTENANCE_TICK_MS 250     /* one app's slice per tick */
+#define MAINTENANCE_PAGES 64        /* most pages given back per slice */
+#define MAINTENANCE_FREE_RATIO 0.25 /* free share of a DB worth shrinking */
+#define MAINTENANCE_MIN_FREE 16     /* fewer free pages aren't worth it */
+#define APP_DB_READ_CACHE_BYTES (64 * 1024)
+#define APP_DB_BUSY_TIMEOUT_MS 250
 
 #define FREE_IF_SET(lserrp)                     \
     if ( LSErrorIsSet( lserrp ) ) {             \
@@ -97,12 +106,16 @@ sourceFunc( gpointer data )
  * - Should be called immediately before g_main_loop_run to start timer for luna bus
  *   internal default category /com/palm/luna/private.
  */
+static gint64 sLastRequest = 0;
+
 static void
 reset_timer( void )
 {
     g_debug( "%s()", __func__ );
     static GSource* s_source = NULL;
 
+    sLastRequest = g_get_monotonic_time();
+
     if ( NULL != s_source ) {
         g_source_destroy( s_source );
     }
@@ -112,6 +125,211 @@ reset_timer( void )
     (void)g_source_attach( s_source, NULL );
 }
 
+/*
+ * App DBs run in WAL mode with automatic checkpoints off, so a set never
+ * pays for copying the log back into the DB.  Instead we note which apps
+ * were written and checkpoint them a little later, on the library's async
+ * thread, so the main loop never waits on a checkpoint's fsync.
+ */
+static GHashTable* sDirtyApps = NULL;
+static guint sCheckpointTimer = 0;
+
+static void
+checkpointDone( LPErr err, const char* jstr, void* ctx )
+{
+    gchar* appId = (gchar*)ctx;
+    if ( LP_ERR_NONE != err ) {
+        g_warning( "%s: checkpoint of %s failed: %d", __func__, appId, err );
+    }
+    g_free( appId );
+}
+
+/* async false is for when we're exiting, with no main loop to report to */
+static void
+checkpointDirtyApps( bool async )
+{
+    if ( NULL != sDirtyApps ) {
+        GHashTableIter iter;
+        gpointer appId;
+        g_hash_table_iter_init( &iter, sDirtyApps );
+        while ( g_hash_table_iter_next( &iter, &appId, NULL ) ) {
+            gchar* ctx = g_strdup( (const char*)appId );
+            if ( !async
+                 || LP_ERR_NONE != LPAppCheckpointAsync( ctx, checkpointDone,
+                                                         ctx ) ) {
+                checkpointDone( LPAppCheckpoint( ctx ), NULL, ctx );
+            }
+        }
+        g_hash_table_remove_all( sDirtyApps );
+    }
+} /* checkpointDirtyApps */
+
+static gboolean
+checkpointTimerFunc( gpointer data )
+{
+    sCheckpointTimer = 0;
+    checkpointDirtyApps( true );
+    return false;
+}
+
+/* The timer is not pushed back by later writes: a busy app still gets
+   checkpointed every CHECKPOINT_DELAY_SECONDS, keeping its log short. */
+static void
+scheduleCheckpoint( const char* appId )
+{
+    if ( NULL == sDirtyApps ) {
+        sDirtyApps = g_hash_table_new_full( g_str_hash, g_str_equal,
+                                            g_free, NULL );
+    }
+    if ( !g_hash_table_lookup_extended( sDirtyApps, appId, NULL, NULL ) ) {
+        g_hash_table_insert( sDirtyApps, g_strdup( appId ), NULL );
+    }
+    if ( 0 == sCheckpointTimer ) {
+        sCheckpointTimer = g_timeout_add_seconds( CHECKPOINT_DELAY_SECONDS,
+                                                  checkpointTimerFunc, NULL );
+    }
+} /* scheduleCheckpoint */
+
+/*
+ * Apps whose DBs may have free pages to give back, noted as they're
+ * written.  Reclaiming runs only once no request has come in for
+ * MAINTENANCE_IDLE_MS, and then a slice of one DB per tick.  Like the
+ * checkpoints it runs on the library's async thread, so the main loop never
+ * waits on it, and a request arriving mid-way waits on that thread behind
+ * at most MAINTENANCE_PAGES pages' work.
+ */
+static GHashTable* sMaintainApps = NULL;
+static guint sMaintenanceTimer = 0;
+static bool sMaintaining = false;   /* a slice is on the async thread */
+
+typedef struct MaintainSlice {
+    gchar* appId;
+    bool   more;                /* appId needs more slices after this one */
+} MaintainSlice;
+
+static bool
+maintenanceIdle( void )
+{
+    gint64 idle = g_get_monotonic_time() - sLastRequest;
+    return idle >= MAINTENANCE_IDLE_MS * G_TIME_SPAN_MILLISECOND;
+}
+
+static void
+finishSlice( MaintainSlice* slice, LPErr err )
+{
+    if ( LP_ERR_BUSY == err ) {
+        slice->more = true;     /* somebody's writing; next tick */
+    } else if ( LP_ERR_NONE != err ) {
+        g_warning( "%s: maintenance of %s failed: %d", __func__,
+                   slice->appId, err );
+        slice->more = false;
+    }
+    if ( !slice->more ) {
+        (void)g_hash_table_remove( sMaintainApps, slice->appId );
+    }
+    g_free( slice->appId );
+    g_free( slice );
+    sMaintaining = false;
+} /* finishSlice */
+
+static void
+reclaimDone( LPErr err, const char* jstr, void* ctx )
+{
+    finishSlice( (MaintainSlice*)ctx, err );
+}
+
+static void
+spaceDone( LPErr err, unsigned int pages, unsigned int freePages, void* ctx )
+{
+    MaintainSlice* slice = (MaintainSlice*)ctx;
+    if ( LP_ERR_NONE == err && freePages >= MAINTENANCE_MIN_FREE
+         && freePages >= pages * MAINTENANCE_FREE_RATIO ) {
+        slice->more = freePages > MAINTENANCE_PAGES;
+        if ( !maintenanceIdle() ) {
+            slice->more = true; /* a request came in meanwhile: later */
+        } else {
+            err = LPAppReclaimSpaceAsync( slice->appId, MAINTENANCE_PAGES,
+                                          reclaimDone, slice );
+            if ( LP_ERR_NONE == err ) {
+                return;         /* reclaimDone finishes it */
+            }
+        }
+    }
+    finishSlice( slice, err );
+} /* spaceDone */
+
+static gboolean
+maintenanceTimerFunc( gpointer data )
+{
+    if ( !sMaintaining && maintenanceIdle() ) {
+        GHashTableIter iter;
+        gpointer appId;
+        g_hash_table_iter_init( &iter, sMaintainApps );
+        if ( g_hash_table_iter_next( &iter, &appId, NULL ) ) {
+            MaintainSlice* slice = g_new0( MaintainSlice, 1 );
+            slice->appId = g_strdup( (const char*)appId );
+            sMaintaining = true;
+            LPErr err = LPAppGetSpaceAsync( slice->appId, spaceDone, slice );
+            if ( LP_ERR_NONE != err ) {
+                finishSlice( slice, err );
+            }
+        }
+    }
+
+    /* an app stays in sMaintainApps until its slice is done */
+    if ( 0 == g_hash_table_size( sMaintainApps ) ) {
+        sMaintenanceTimer = 0;
+        return false;
+    }
+    return true;
+} /* maintenanceTimerFunc */
+
+static void
+scheduleMaintenance( const char* appId )
+{
+    if ( NULL == sMaintainApps ) {
+        sMaintainApps = g_hash_table_new_full( g_str_hash, g_str_equal,
+                                               g_free, NULL );
+    }
+    if ( !g_hash_table_lookup_extended( sMaintainApps, appId, NULL, NULL ) ) {
+        g_hash_table_insert( sMaintainApps, g_strdup( appId ), NULL );
+    }
+    if ( 0 == sMaintenanceTimer ) {
+        sMaintenanceTimer = g_timeout_add( MAINTENANCE_TICK_MS,
+                                           maintenanceTimerFunc, NULL );
+    }
+} /* scheduleMaintenance */
+
+/* A bus call waiting on one of the library's async calls, which keep the
+   DB's fsyncs off the main loop.  Holds a ref on message until replied to. */
+typedef struct PendingCall {
+    LSHandle*  sh;
+    LSMessage* message;
+    gchar*     appId;
+    gchar*     key;
+} PendingCall;
+
+static PendingCall*
+newPendingCall( LSHandle* sh, LSMessage* message, const gchar* appId,
+                const gchar* key )
+{
+    PendingCall* call = g_new0( PendingCall, 1 );
+    call->sh = sh;
+    call->message = message;
+    LSMessageRef( message );
+    call->appId = g_strdup( appId );
+    call->key = g_strdup( key );
+    return call;
+}
+
+static void
+freePendingCall( PendingCall* call )
+{
+    LSMessageUnref( call->message );
+    g_free( call->appId );
+    g_free( call->key );
+    g_free( call );
+}
 
 static void
 errorReplyStr( LSHandle* lsh, LSMessage* message, const char* errString )
@@ -230,9 +448,30 @@ replyWithValue( LSHandle* sh, LSMessage* message, LSError* lserror,
     return LSMessageReply( sh, message, value, lserror );
 } /* replyWithValue */
 
+/* Reply with { key: jsonVal, returnValue: true }; takes jsonVal. */
 static bool
-replyWithKeyValue( LSHandle* sh, LSMessage* message, LSError* lserror,
-                   const gchar* key, const gchar* value )
+replyWithKeyObject( LSHandle* sh, LSMessage* message, LSError* lserror,
+                    const gchar* key, struct json_object* jsonVal )
+{
+    struct json_object* result = json_object_new_object();
+    g_assert( !!result );
+    g_assert( !!key );
+    json_object_object_add( result, key, jsonVal );
+
+    add_true_result( result );
+
+    const char* text = json_object_to_json_string( result );
+    g_assert( !!text );
+    bool success = replyWithValue( sh, message, lserror, text );
+
+    json_object_put( result );
+
+    return success;
+} /* replyWithKeyObject */
+
+/* A stored value as it goes in a reply. */
+static struct json_object*
+valueObject( const gchar* value )
 {
     g_assert( !!value );
     struct json_object* jsonVal = json_tokener_parse( value );
@@ -251,21 +490,15 @@ replyWithKeyValue( LSHandle* sh, LSMessage* message, LSError* lserror,
             jsonVal = json_object_new_string( value );
         }
     }
+    return jsonVal;
+} /* valueObject */
 
-    struct json_object* result = json_object_new_object();
-    g_assert( !!result );
-    g_assert( !!key );
-    json_object_object_add( result, key, jsonVal );
-
-    add_true_result( result );
-
-    const char* text = json_object_to_json_string( result );
-    g_assert( !!text );
-    bool success = replyWithValue( sh, message, lserror, text );
-
-    json_object_put( result );
-
-    return success;
+static bool
+replyWithKeyValue( LSHandle* sh, LSMessage* message, LSError* lserror,
+                   const gchar* key, const gchar* value )
+{
+    return replyWithKeyObject( sh, message, lserror, key,
+                               valueObject( value ) );
 } /* replyWithKeyValue */
 
 static struct json_object*
@@ -1091,23 +1324,31 @@ static LSMethod sysPropGetMethods[] = {
    { },
 };
 
-typedef LPErr (*AppGetter)( LPAppHandle handle, struct json_object** json );
+typedef LPErr (*AppGetter)( LPAppHandle handle, const char* prefix,
+                            struct json_object** json );
 
 static bool
 appGet_internal( LSHandle* sh, LSMessage* message, AppGetter getter, bool asObj )
 {
     LPErr err = LP_ERR_NONE;
     gchar* appId = NULL;
+    gchar* prefix = NULL;
     struct json_object* json = NULL;
     LPAppHandle handle = NULL;
 
     if ( parseMessage( message,
                        "appId", json_type_string, &appId,
                        NULL ) ) {
-        err = LPAppGetHandle( appId, &handle );
+        /* prefix is optional, so parseMessage() can't fetch it */
+        if ( !parseMessage( message, "prefix", json_type_string, &prefix,
+                            NULL ) ) {
+            prefix = NULL;
+        }
+
+        err = LPAppGetHandleReadOnly( appId, &handle );
         if ( 0 != err ) goto error;
 
-        err = (*getter)( handle, &json );
+        err = (*getter)( handle, prefix, &json );
         if ( 0 != err ) goto error;
 
         if ( asObj ) {
@@ -1133,6 +1374,7 @@ appGet_internal( LSHandle* sh, LSMessage* message, AppGetter getter, bool asObj
         (void)LPAppFreeHandle( handle, FALSE );
     }
     g_free( appId );
+    g_free( prefix );
     json_object_put( json );
 
     return true;
@@ -1152,11 +1394,13 @@ Get all property keys for an application as a string array.
 \subsection com_palm_preferences_app_properties_get_app_keys_syntax Syntax:
 \code
 {
-    "appId": string
+    "appId": string,
+    "prefix": string
 }
 \endcode
 
 \param appId Id for the application.
+\param prefix Optional.  Only keys starting with this are returned, in key order.
 
 \subsection com_palm_preferences_app_properties_get_app_keys_returns_succesful Returns with a succesful call:
 \code
@@ -1200,7 +1444,7 @@ appGetKeys( LSHandle* sh, LSMessage* message, void* user_data )
 {
     reset_timer();
     g_debug( "%s(%s)", __func__, LSMessageGetPayload(message) );
-    return appGet_internal( sh, message, LPAppCopyKeysCJ, false );
+    return appGet_internal( sh, message, LPAppCopyKeysWithPrefixCJ, false );
 }
 
 /*!
@@ -1217,11 +1461,13 @@ Get all property keys for an application as a JSON object.
 \subsection com_palm_preferences_app_properties_get_app_keys_obj_syntax Syntax:
 \code
 {
-    "appId": string
+    "appId": string,
+    "prefix": string
 }
 \endcode
 
 \param appId Id for the application.
+\param prefix Optional.  Only keys starting with this are returned, in key order.
 
 \subsection com_palm_preferences_app_properties_get_app_keys_obj_returns Returns:
 \code
@@ -1265,7 +1511,7 @@ appGetKeysObj( LSHandle* sh, LSMessage* message, void* user_data )
 {
     reset_timer();
     g_debug( "%s(%s)", __func__, LSMessageGetPayload(message) );
-    return appGet_internal( sh, message, LPAppCopyKeysCJ, true );
+    return appGet_internal( sh, message, LPAppCopyKeysWithPrefixCJ, true );
 }
 
 /*!
@@ -1282,11 +1528,13 @@ Get all properties set to an application as an object array.
 \subsection com_palm_preferences_app_properties_get_all_app_properties_syntax Syntax:
 \code
 {
-    "appId": string
+    "appId": string,
+    "prefix": string
 }
 \endcode
 
 \param appId Id for the application.
+\param prefix Optional.  Only keys starting with this are returned, in key order.
 
 \subsection com_palm_preferences_app_properties_get_all_app_properties_returns_succesful Returns with a succesful call:
 \code
@@ -1356,7 +1604,7 @@ appGetAll( LSHandle* sh, LSMessage* message, void* user_data )
 {
     g_debug( "%s(%s)", __func__, LSMessageGetPayload(message) );
     reset_timer();
-    return appGet_internal( sh, message, LPAppCopyAllCJ, false );
+    return appGet_internal( sh, message, LPAppCopyAllWithPrefixCJ, false );
 } /* appGetAll */
 
 /*!
@@ -1373,11 +1621,13 @@ Get all properties set to an application as an object.
 \subsection com_palm_preferences_app_properties_get_all_app_properties_obj_syntax Syntax:
 \code
 {
-    "appId": string
+    "appId": string,
+    "prefix": string
 }
 \endcode
 
 \param appId Id for the application.
+\param prefix Optional.  Only keys starting with this are returned, in key order.
 
 \subsection com_palm_preferences_app_properties_get_all_app_properties_obj_returns Returns:
 \code
@@ -1445,9 +1695,91 @@ appGetAllObj( LSHandle* sh, LSMessage* message, void* user_data )
 {
     g_debug( "%s(%s)", __func__, LSMessageGetPayload(message) );
     reset_timer();
-    return appGet_internal( sh, message, LPAppCopyAllCJ, true );
+    return appGet_internal( sh, message, LPAppCopyAllWithPrefixCJ, true );
 } /* appGetAllObj */
 
+static void
+appGetValueDone( LPErr err, const char* value, void* ctx )
+{
+    PendingCall* call = (PendingCall*)ctx;
+    if ( LP_ERR_NONE == err ) {
+        LSError lserror;
+        LSErrorInit( &lserror );
+        if ( !replyWithKeyValue( call->sh, call->message, &lserror,
+                                 call->key, value ) ) {
+            LSErrorPrint( &lserror, stderr );
+            FREE_IF_SET( &lserror );
+        }
+    } else {
+        errorReplyErr( call->sh, call->message, err );
+    }
+    freePendingCall( call );
+}
+
+/* As appGetValueDone, but what a path selects may be any json value, and
+   goes in the reply as it is ("null" parses to NULL, which is null). */
+static void
+appGetValuePathDone( LPErr err, const char* value, void* ctx )
+{
+    PendingCall* call = (PendingCall*)ctx;
+    if ( LP_ERR_NONE == err ) {
+        LSError lserror;
+        LSErrorInit( &lserror );
+        if ( !replyWithKeyObject( call->sh, call->message, &lserror,
+                                  call->key, json_tokener_parse( value ) ) ) {
+            LSErrorPrint( &lserror, stderr );
+            FREE_IF_SET( &lserror );
+        }
+    } else {
+        errorReplyErr( call->sh, call->message, err );
+    }
+    freePendingCall( call );
+}
+
+/* As appGetValueDone, for a caller with ifNoneMatch: adds the etag, and
+   in place of an unchanged value says so. */
+static void
+appGetValueTaggedDone( LPErr err, const char* value, long long version,
+                       void* ctx )
+{
+    PendingCall* call = (PendingCall*)ctx;
+    if ( LP_ERR_NONE == err || LP_ERR_NOT_MODIFIED == err ) {
+        struct json_object* result = json_object_new_object();
+        if ( LP_ERR_NONE == err ) {
+            json_object_object_add( result, call->key, valueObject( value ) );
+        } else {
+            json_object_object_add( result, "notModified",
+                                    json_object_new_boolean( true ) );
+        }
+        gchar* etag = g_strdup_printf( "%lld", version );
+        json_object_object_add( result, "etag",
+                                json_object_new_string( etag ) );
+        g_free( etag );
+        add_true_result( result );
+
+        LSError lserror;
+        LSErrorInit( &lserror );
+        if ( !replyWithValue( call->sh, call->message, &lserror,
+                              json_object_to_json_string( result ) ) ) {
+            LSErrorPrint( &lserror, stderr );
+            FREE_IF_SET( &lserror );
+        }
+        json_object_put( result );
+    } else {
+        errorReplyErr( call->sh, call->message, err );
+    }
+    freePendingCall( call );
+}
+
+/* An etag from an earlier reply, or -1 to match nothing. */
+static long long
+parseETag( const gchar* etag )
+{
+    gchar* end;
+    long long version = g_ascii_strtoll( etag, &end, 10 );
+    return ( '\0' == *etag || '\0' != *end ) ? -1 : version;
+}
+
 /*!
 \page com_palm_preferences_app_properties
 \n
@@ -1457,16 +1789,29 @@ appGetAllObj( LSHandle* sh, LSMessage* message, void* user_data )
 
 com.palm.preferences/appProperties/getAppProperty
 
-Get an application property for a specific key.
+Get an application property for a specific key, or with \e path, only
+the part of it that path selects.  With \e ifNoneMatch, a caller that
+polls a property gets it only when it has changed.
 
 \subsection com_palm_preferences_app_properties_get_app_property_syntax Syntax:
 \code
 {
-    "appId": string
+    "appId": string,
+    "key": string,
+    "path": string,
+    "ifNoneMatch": string
 }
 \endcode
 
 \param appId Id for the application.
+\param key Key for the property.
+\param path Optional.  A JSON path into the property, such as
+       "$.audio.eq[3]": "$" is the property, ".name" one of its members and
+       "[n]" an array element.  The reply then has what's there under
+       <key>, which may be any json value.
+\param ifNoneMatch Optional, and not with path.  The etag from an earlier
+       reply, or "" for none.  The reply then has the property's current
+       etag, and if that's the one given, notModified in place of <key>.
 
 \subsection com_palm_preferences_app_properties_get_app_property_returns Returns:
 \code
@@ -1478,6 +1823,8 @@ Get an application property for a specific key.
 \endcode
 
 \param <key> Object containing the property for this key.
+\param etag With ifNoneMatch: changes whenever the property does.
+\param notModified With ifNoneMatch: true if the property is unchanged.
 \param returnValue Indicates if the call was succesful.
 \param errorText Describes the error.
 
@@ -1511,7 +1858,7 @@ appGetValue( LSHandle* sh, LSMessage* message, void* user_data )
     g_debug( "%s(%s)", __func__, LSMessageGetPayload(message) );
     reset_timer();
 
-    LPErr err = -1;           /* not 0 */
+    LPErr err;
 
     gchar* appId = NULL;
     gchar* key = NULL;
@@ -1519,28 +1866,38 @@ appGetValue( LSHandle* sh, LSMessage* message, void* user_data )
                        "appId", json_type_string, &appId,
                        "key", json_type_string, &key,
                        NULL ) ) {
-        LPAppHandle handle;
-        gchar* value = NULL;
-
-        LSError lserror;
-        LSErrorInit(&lserror);
+        /* path is optional, so parseMessage() can't fetch it with the rest */
+        gchar* path = NULL;
+        if ( !parseMessage( message, "path", json_type_string, &path, NULL ) ) {
+            path = NULL;
+        }
+        gchar* etag = NULL;
+        if ( !parseMessage( message, "ifNoneMatch", json_type_string, &etag,
+                            NULL ) ) {
+            etag = NULL;
+        }
 
-        err = LPAppGetHandle( appId, &handle );
-        if ( 0 != err ) goto error;
-        err = LPAppCopyValue( handle, key, &value );
-        if ( 0 != err ) goto err_with_handle;
-        if ( !replyWithKeyValue( sh, message, &lserror, key, value ) ) goto err_with_handle;
-        err = 0;
-        LSErrorPrint(&lserror, stderr);
-        FREE_IF_SET (&lserror);
-    err_with_handle:
-        errorReplyErr( sh, message, err );
-        err = LPAppFreeHandle( handle, true );
-        if ( 0 != err ) goto error;
-    error:
+        PendingCall* call = newPendingCall( sh, message, appId, key );
+        if ( NULL != etag && NULL != path ) {
+            err = LP_ERR_PARAM_ERR;
+            g_free( path );
+        } else if ( NULL != etag ) {
+            err = LPAppCopyValueIfChangedAsync( appId, key, parseETag( etag ),
+                                                appGetValueTaggedDone, call );
+        } else if ( NULL == path ) {
+            err = LPAppCopyValueAsync( appId, key, appGetValueDone, call );
+        } else {
+            err = LPAppCopyValuePathAsync( appId, key, path,
+                                           appGetValuePathDone, call );
+            g_free( path );
+        }
+        if ( LP_ERR_NONE != err ) {
+            errorReplyErr( sh, message, err );
+            freePendingCall( call );
+        }
+        g_free( etag );
         g_free( appId );
         g_free( key );
-        g_free( value );
     } else {
         errorReplyStr( sh, message, "no appId or key parameter found" );
     }
@@ -1559,6 +1916,21 @@ getStringParam( struct json_object* param, char** str )
     return ok;
 }
 
+/* Completion of setAppProperty, mergeAppProperty and removeAppProperty. */
+static void
+appWriteDone( LPErr err, const char* unused, void* ctx )
+{
+    PendingCall* call = (PendingCall*)ctx;
+    if ( LP_ERR_NONE == err ) {
+        scheduleCheckpoint( call->appId );
+        scheduleMaintenance( call->appId );
+        successReply( call->sh, call->message );
+    } else {
+        errorReplyErr( call->sh, call->message, err );
+    }
+    freePendingCall( call );
+}
+
 /*!
 \page com_palm_preferences_app_properties
 \n
@@ -1620,7 +1992,6 @@ appSetValue( LSHandle* sh, LSMessage* message, void* user_data )
     reset_timer();
 
     g_debug( "%s(%s)", __func__, LSMessageGetPayload(message) );
-    bool success = false;
     LPErr err;
 
     struct json_object* payload = json_tokener_parse( LSMessageGetPayload( message ) );
@@ -1640,18 +2011,17 @@ appSetValue( LSHandle* sh, LSMessage* message, void* user_data )
         } else if ( !value ) {
             errorReplyStrMissingParam( sh, message, "value" );
         } else {
-            LPAppHandle handle;
-            if ((err = LPAppGetHandle( appIdString, &handle )) == LP_ERR_NONE)
-            {
-                gchar* valString = json_object_get_string( value );
-                if ( valString ) {
-                    err = LPAppSetValue( handle, keyString, valString );
-                } else {
-                    err = LP_ERR_VALUENOTJSON;
+            const gchar* valString = json_object_get_string( value );
+            if ( valString ) {
+                PendingCall* call = newPendingCall( sh, message,
+                                                    appIdString, keyString );
+                err = LPAppSetValueAsync( appIdString, keyString, valString,
+                                          appWriteDone, call );
+                if ( LP_ERR_NONE != err ) {
+                    freePendingCall( call );
                 }
-
-                (void)LPAppFreeHandle( handle, true );
-                success = LP_ERR_NONE == err;
+            } else {
+                err = LP_ERR_VALUENOTJSON;
             }
 
             errorReplyErr( sh, message, err );
@@ -1661,13 +2031,118 @@ appSetValue( LSHandle* sh, LSMessage* message, void* user_data )
         g_free( appIdString );
         json_object_put( payload );
     }
-    if ( success ) {
-        successReply( sh, message );
-    }
 
     return true;
 } /* appSetValue */
 
+/*!
+\page com_palm_preferences_app_properties
+\n
+\section com_palm_preferences_app_properties_merge_app_property mergeAppProperty
+
+\e Public.
+
+com.palm.preferences/appProperties/mergeAppProperty
+
+Change some fields of an application property, leaving the rest as they
+are.  \e patch is a JSON merge patch (RFC 7396): its members replace the
+property's members of the same name, objects are merged member by member,
+and members set to null are removed.  If the property doesn't exist, the
+patch (less its nulls) becomes it.
+
+\subsection com_palm_preferences_app_properties_merge_app_property_syntax Syntax:
+\code
+{
+    "appId": string,
+    "key": string,
+    "patch": object
+}
+\endcode
+
+\param appId Id for the application.
+\param key Key for the property.
+\param patch Changes to make to the property.
+
+\subsection com_palm_preferences_app_properties_merge_app_property_returns Returns:
+\code
+{
+    "returnValue": boolean,
+    "errorText": string
+}
+\endcode
+
+\param returnValue Indicates if the call was succesful.
+\param errorText Describes the error.
+
+\subsection com_palm_preferences_app_properties_merge_app_property_examples Examples:
+\code
+luna-send -n 1 -f luna://com.palm.preferences/appProperties/mergeAppProperty '{"appId": "com.palm.app.calendar", "key": "oneMoreKey", "patch": {"anotherInt": 4} }'
+\endcode
+
+Example response for a succesful call:
+\code
+{
+    "returnValue": true
+}
+\endcode
+
+Example response for a failed call:
+\code
+{
+    "returnValue": false,
+    "errorText": "illegal value (not a json document)"
+}
+\endcode
+*/
+static bool
+appMergeValue( LSHandle* sh, LSMessage* message, void* user_data )
+{
+    reset_timer();
+
+    g_debug( "%s(%s)", __func__, LSMessageGetPayload(message) );
+    LPErr err;
+
+    struct json_object* payload = json_tokener_parse( LSMessageGetPayload( message ) );
+    if ( payload ) {
+        struct json_object* appId = json_object_object_get( payload, "appId" );
+        struct json_object* key = json_object_object_get( payload, "key");
+        struct json_object* patch = json_object_object_get( payload, "patch");
+        gchar* appIdString = NULL;
+        gchar* keyString = NULL;
+
+        if ( !getStringParam( appId, &appIdString ) ) {
+            errorReplyStrMissingParam( sh, message, "appId" );
+        } else if ( g_strcmp0(g_strstrip(appIdString),"") == 0) {
+            errorReplyStrMissingParam( sh, message, "appId" );
+        } else if ( !getStringParam( key, &keyString ) ) {
+            errorReplyStrMissingParam( sh, message, "key" );
+        } else if ( !patch ) {
+            errorReplyStrMissingParam( sh, message, "patch" );
+        } else {
+            const gchar* patchString = json_object_get_string( patch );
+            if ( patchString ) {
+                PendingCall* call = newPendingCall( sh, message,
+                                                    appIdString, keyString );
+                err = LPAppMergeValueAsync( appIdString, keyString, patchString,
+                                            appWriteDone, call );
+                if ( LP_ERR_NONE != err ) {
+                    freePendingCall( call );
+                }
+            } else {
+                err = LP_ERR_VALUENOTJSON;
+            }
+
+            errorReplyErr( sh, message, err );
+        }
+
+        g_free( keyString );
+        g_free( appIdString );
+        json_object_put( payload );
+    }
+
+    return true;
+} /* appMergeValue */
+
 /*!
 \page com_palm_preferences_app_properties
 \n
@@ -1725,24 +2200,12 @@ appRemoveValue( LSHandle* sh, LSMessage* message, void* user_data )
                        "key", json_type_string, &key,
                        NULL ) )
     {
-        LPAppHandle handle;
-        LPErr err = LPAppGetHandle( appId, &handle );
-        if ( LP_ERR_NONE == err )
-        {
-            err = LPAppRemoveValue( handle, key );
-            if (LP_ERR_NONE == err)
-            {
-                successReply( sh, message );
-            }
-            else
-            {
-                errorReplyErr( sh, message, err );
-            }
-            (void)LPAppFreeHandle( handle, true );
-        }
-        else
+        PendingCall* call = newPendingCall( sh, message, appId, key );
+        LPErr err = LPAppRemoveValueAsync( appId, key, appWriteDone, call );
+        if ( LP_ERR_NONE != err )
         {
-            errorReplyErr( sh, message, err);
+            errorReplyErr( sh, message, err );
+            freePendingCall( call );
         }
     }
     else
@@ -2049,6 +2512,7 @@ static LSMethod appPropMethods[] = {
    { "getAllAppPropertiesObj", appGetAllObj },
    { "getAppProperty", appGetValue },
    { "setAppProperty", appSetValue },
+   { "mergeAppProperty", appMergeValue },
    { "removeAppProperty", appRemoveValue },
    { },
 };
@@ -2134,6 +2598,27 @@ main( int argc, char** argv )
 
     g_log_set_default_handler(logFilter, NULL);
 
+    /* We serve every app, so keep more of their DBs open between requests
+       than the library does by default. */
+    (void)LPAppSetPoolLimits( APP_DB_POOL_SIZE, EXIT_TIMER_SECONDS );
+
+    /* WAL lets readers and a writer proceed together, and with it NORMAL sync
+       only risks the last few commits on power loss, never corruption.  We
+       checkpoint ourselves; see scheduleCheckpoint. */
+    (void)LPAppSetDefaultOption( LP_OPT_JOURNAL_MODE, LP_JOURNAL_WAL );
+    (void)LPAppSetDefaultOption( LP_OPT_SYNCHRONOUS, LP_SYNC_NORMAL );
+    (void)LPAppSetDefaultOption( LP_OPT_WAL_AUTOCHECKPOINT, 0 );
+
+    /* Most app DBs are small and read far more than written: serve reads
+       from memory.  The cache checks for writes by luna-prop and other
+       direct users of the DB, so it's never stale. */
+    (void)LPAppSetDefaultOption( LP_OPT_READ_CACHE, APP_DB_READ_CACHE_BYTES );
+
+    /* Ride out luna-prop or a backup holding a DB briefly rather than fail
+       the request; kept short as reads wait on the main loop.  Idle-time
+       maintenance never waits whatever this says. */
+    (void)LPAppSetDefaultOption( LP_OPT_BUSY_TIMEOUT, APP_DB_BUSY_TIMEOUT_MS );
+
     LSErrorInit( &lserror );
 
     g_debug( "%s() in %s starting", __func__, __FILE__ );
@@ -2199,6 +2684,9 @@ main( int argc, char** argv )
 
         g_main_loop_run( g_mainloop );
         g_main_loop_unref( g_mainloop );
+
+        checkpointDirtyApps( false );
+        (void)LPAppTrimPool( true );
     } while (false);
 
     if (!retVal)
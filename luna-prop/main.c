@@ -46,7 +46,8 @@ usage( char** namep, const char* fmt, ... )
              "    [[-k] key_name          # print (or delete, with -k) entry_for_key \\\n"
              "        |-s key_name value  # set value for key_name \\\n"
              "        |-a ]               # dump all key/value pairs \\\n"
-             , name );
+             "  or: %s -M                 # move all apps' props into one shared DB\n"
+             , name, name );
     fprintf( stderr, "\teg: %s -n com.palm.browser\n", name );
     fprintf( stderr, "\teg: %s -n com.palm.browser currentURL\n", name );
     fprintf( stderr, "\teg: %s com.palm.properties.installer\n", name );
@@ -93,12 +94,13 @@ main( int argc, char** argv )
     bool set = false;
     bool all = false;
     bool shellMode = false;
+    bool migrate = false;
     char* setValue = NULL;
     int exclusives = 0;
     gchar* freeMe = NULL;
 
     for ( ; ; ) {
-        int opt = getopt( argc, argv, "a?hk:mn:s:" );
+        int opt = getopt( argc, argv, "a?hk:mMn:s:" );
         if ( opt == -1 ) {
             break;
         }
@@ -114,6 +116,9 @@ main( int argc, char** argv )
         case 'm':
             shellMode = true;
             break;
+        case 'M':
+            migrate = true;
+            break;
         case 'n':
             appId = optarg;
             break;
@@ -141,7 +146,9 @@ main( int argc, char** argv )
         }
     }
 
-    if ( set && !appId ) {
+    if ( migrate && (exclusives > 0 || !!appId || !!key || shellMode) ) {
+        usage( argv, "-M takes no other arguments" );
+    } else if ( set && !appId ) {
         usage( argv, "system properties are read-only; use -n" );
     } else if ( exclusives > 1 ) {
         usage( argv, "pass at most 1 of -a, -k and -s" );
@@ -181,9 +188,19 @@ main( int argc, char** argv )
     gchar* value = NULL;
     LPErr err;
 
-    if ( NULL != appId ) {
+    /* The service may have the DB mid-write; nobody's waiting on us. */
+    (void)LPAppSetDefaultOption( LP_OPT_BUSY_TIMEOUT, 2000 );
+
+    if ( migrate ) {
+        /* moves nothing, and says so, if an app's DB stays busy that long */
+        err = LPAppMigrateToSharedStore();
+    } else if ( NULL != appId ) {
         LPAppHandle handle;
-        err = LPAppGetHandle( appId, &handle );
+        if ( delete || set ) {
+            err = LPAppGetHandle( appId, &handle );
+        } else {
+            err = LPAppGetHandleReadOnly( appId, &handle );
+        }
         if ( err == 0 ) {
             if ( NULL == key ) {
                 if ( all ) {
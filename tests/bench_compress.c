@@ -0,0 +1,123 @@
+// Copyright (c) 2026 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+/* -*-mode: C; fill-column: 78; c-basic-offset: 4; -*- */
+
+/*
+ * What LP_OPT_COMPRESS_MIN costs and saves: the same settings document,
+ * a few KB of it, stored under many keys with compression off and on, and
+ * the DB file's size and the time per set and per copy for each.
+ *
+ *   bench_compress [keys [compress min]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <glib.h>
+
+#include "lunaprefs.h"
+
+#define APP_ID "com.webos.test.bench-compress"
+#define DB_PATH "/var/preferences/" APP_ID "/prefsDB.sl"
+
+/* Settings as an app might keep them: repetitive, as most are. */
+static gchar*
+settingsDocument( void )
+{
+    GString* gstr = g_string_new( "{ \"version\": 3, \"channels\": [ " );
+    int ii;
+    for ( ii = 0; ii < 24; ++ii ) {
+        g_string_append_printf( gstr, "%s{ \"number\": %d, \"name\":"
+                                " \"Channel %d\", \"favorite\": %s,"
+                                " \"locked\": false, \"audio\": \"stereo\","
+                                " \"logo\": \"/usr/share/logos/ch%03d.png\" }",
+                                ii ? ", " : "", ii + 1, ii + 1,
+                                ii % 3 ? "false" : "true", ii + 1 );
+    }
+    g_string_append( gstr, " ] }" );
+    return g_string_free( gstr, FALSE );
+}
+
+static void
+runOnce( const char* doc, int nKeys, long long compressMin )
+{
+    LPAppHandle handle;
+    char key[32];
+    struct stat st;
+    int ii;
+
+    (void)LPAppClearData( APP_ID );
+    if ( LP_ERR_NONE != LPAppGetHandle( APP_ID, &handle )
+         || LP_ERR_NONE != LPAppSetOption( handle, LP_OPT_COMPRESS_MIN,
+                                           compressMin ) ) {
+        exit( 1 );
+    }
+
+    gint64 start = g_get_monotonic_time();
+    for ( ii = 0; ii < nKeys; ++ii ) {
+        snprintf( key, sizeof(key), "key%d", ii );
+        if ( LP_ERR_NONE != LPAppSetValue( handle, key, doc ) ) {
+            fprintf( stderr, "set %s failed\n", key );
+            exit( 1 );
+        }
+    }
+    double setUs = (double)(g_get_monotonic_time() - start) / nKeys;
+
+    start = g_get_monotonic_time();
+    for ( ii = 0; ii < nKeys; ++ii ) {
+        char* jstr;
+        snprintf( key, sizeof(key), "key%d", ii );
+        if ( LP_ERR_NONE != LPAppCopyValue( handle, key, &jstr )
+             || 0 != strcmp( jstr, doc ) ) {
+            fprintf( stderr, "copy %s failed\n", key );
+            exit( 1 );
+        }
+        g_free( jstr );
+    }
+    double copyUs = (double)(g_get_monotonic_time() - start) / nKeys;
+
+    (void)LPAppFreeHandle( handle, true );
+    (void)LPAppTrimPool( true );
+    long long size = 0 == stat( DB_PATH, &st ) ? (long long)st.st_size : -1;
+
+    printf( "%-14lld %10lld %10.2f %10.2f\n", compressMin, size, setUs,
+            copyUs );
+}
+
+int
+main( int argc, char** argv )
+{
+    int nKeys = argc > 1 ? atoi( argv[1] ) : 500;
+    long long compressMin = argc > 2 ? atoll( argv[2] ) : 256;
+    gchar* doc = settingsDocument();
+
+    if ( NULL != LPAppSharedStorePath() ) {
+        printf( "shared store in use; the file holds every app's prefs\n" );
+        return 0;
+    }
+
+    printf( "%d keys of %zu bytes each\n", nKeys, strlen( doc ) );
+    printf( "%-14s %10s %10s %10s\n", "compress min", "file bytes",
+            "set us", "copy us" );
+    runOnce( doc, nKeys, 0 );
+    runOnce( doc, nKeys, compressMin );
+
+    (void)LPAppClearData( APP_ID );
+    g_free( doc );
+    return 0;
+}
@@ -0,0 +1,126 @@
+// Copyright (c) 2026 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+/* -*-mode: C; fill-column: 78; c-basic-offset: 4; -*- */
+
+/*
+ * What checking that a value is json costs: parsing it with json-c, as
+ * check_is_json() used to for every value, against jsonScanText().
+ *
+ *   bench_jsonscan [milliseconds per measurement]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include <json.h>
+
+#include "jsonscan.h"
+
+static const char sSettings[] =
+    "{ \"brightness\": 80, \"volume\": 12, \"muted\": false,"
+    " \"locale\": \"en-US\", \"timeZone\": \"America/Los_Angeles\","
+    " \"wallpaper\": { \"path\": \"/media/internal/wallpapers/dawn.jpg\","
+    " \"scale\": 1.5 }, \"recent\": [ \"mail\", \"calendar\", \"photos\" ] }";
+
+static const char sUrls[] =
+    "[ \"https://www.example.com/\", \"https://news.example.org/today\","
+    " \"http://intranet.example.net/wiki/Main_Page\","
+    " \"https://search.example.com/?q=luna+prefs&lang=en\" ]";
+
+/* Many objects of settings, about 31KB: a big app's whole state. */
+static gchar*
+bigDocument( void )
+{
+    GString* gstr = g_string_new( "{ " );
+    int ii;
+    for ( ii = 0; ii < 276; ++ii ) {
+        g_string_append_printf( gstr, "%s\"item%d\": { \"id\": %d,"
+                                " \"title\": \"Item number %d\","
+                                " \"enabled\": %s, \"weight\": %d.%02d,"
+                                " \"tags\": [ \"a\", \"b\", \"c\" ] }",
+                                ii ? ", " : "", ii, ii, ii,
+                                ii % 2 ? "true" : "false", ii, ii % 100 );
+    }
+    g_string_append( gstr, " }" );
+    return g_string_free( gstr, FALSE );
+}
+
+/* ns per call, running it for about ms milliseconds */
+static double
+timeParse( const char* text, int ms )
+{
+    gint64 start = g_get_monotonic_time();
+    gint64 stop = start + ms * 1000;
+    long calls = 0;
+    gint64 now;
+    do {
+        int ii;
+        for ( ii = 0; ii < 64; ++ii ) {
+            json_object_put( json_tokener_parse( text ) );
+        }
+        calls += 64;
+    } while ( (now = g_get_monotonic_time()) < stop );
+    return (now - start) * 1000.0 / calls;
+}
+
+static double
+timeScan( const char* text, int ms )
+{
+    size_t len = strlen( text );
+    gint64 start = g_get_monotonic_time();
+    gint64 stop = start + ms * 1000;
+    long calls = 0;
+    gint64 now;
+    do {
+        int ii;
+        for ( ii = 0; ii < 64; ++ii ) {
+            if ( JSONSCAN_VALID != jsonScanText( text, len ) ) {
+                fprintf( stderr, "not valid: %.40s...\n", text );
+                exit( 1 );
+            }
+        }
+        calls += 64;
+    } while ( (now = g_get_monotonic_time()) < stop );
+    return (now - start) * 1000.0 / calls;
+}
+
+int
+main( int argc, char** argv )
+{
+    int ms = argc > 1 ? atoi( argv[1] ) : 500;
+    gchar* big = bigDocument();
+    const struct {
+        const char* name;
+        const char* text;
+    } docs[] = {
+        { "[\"123\"]", "[\"123\"]" },
+        { "settings object", sSettings },
+        { "list of URLs", sUrls },
+        { "object of objects", big },
+    };
+    int ii;
+
+    printf( "%-20s %7s %12s %12s\n", "", "bytes", "json-c ns", "scan ns" );
+    for ( ii = 0; ii < G_N_ELEMENTS( docs ); ++ii ) {
+        printf( "%-20s %7zu %12.0f %12.0f\n", docs[ii].name,
+                strlen( docs[ii].text ), timeParse( docs[ii].text, ms ),
+                timeScan( docs[ii].text, ms ) );
+    }
+    g_free( big );
+    return 0;
+}
@@ -0,0 +1,259 @@
+// Copyright (c) 2026 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+/* -*-mode: C; fill-column: 78; c-basic-offset: 4; -*- */
+
+/*
+ * Per-app DBs against the shared store: the cost of opening an app's prefs
+ * and reading a key, of a set and its commit, and of reading every app's
+ * rows as the service's backup does.  Many apps' prefs are written, timed,
+ * moved with LPAppMigrateToSharedStore and timed again.
+ *
+ * Migrating moves every app's prefs on the device, so this refuses to run
+ * if any app but its own has prefs, and removes the shared store after.
+ *
+ *   bench_shared [apps [keys [wal]]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib.h>
+#include <sqlite3.h>
+
+#include "lunaprefs.h"
+
+#define PREFS_DIR "/var/preferences"
+#define APP_PREFIX "com.webos.test.bench-shared."
+
+static bool
+isOurs( const gchar* name )
+{
+    return 0 == strncmp( name, APP_PREFIX, strlen( APP_PREFIX ) );
+}
+
+/* Whether any app but ours has prefs of its own. */
+static bool
+othersHavePrefs( void )
+{
+    GDir* dir = g_dir_open( PREFS_DIR, 0, NULL );
+    const gchar* name;
+    bool found = false;
+    while ( !found && NULL != dir && NULL != (name = g_dir_read_name( dir )) ) {
+        gchar* file = g_build_filename( PREFS_DIR, name, "prefsDB.sl", NULL );
+        found = !isOurs( name ) && g_file_test( file, G_FILE_TEST_EXISTS );
+        g_free( file );
+    }
+    if ( NULL != dir ) {
+        g_dir_close( dir );
+    }
+    return found;
+}
+
+static void
+appId( char* buf, size_t len, int ii )
+{
+    snprintf( buf, len, APP_PREFIX "%d", ii );
+}
+
+/* us per app to get a handle, read a key and let the handle go */
+static double
+timeOpen( int nApps )
+{
+    char app[64];
+    int ii;
+
+    (void)LPAppTrimPool( true );
+    gint64 start = g_get_monotonic_time();
+    for ( ii = 0; ii < nApps; ++ii ) {
+        LPAppHandle handle;
+        char* jstr;
+        appId( app, sizeof(app), ii );
+        if ( LP_ERR_NONE != LPAppGetHandle( app, &handle )
+             || LP_ERR_NONE != LPAppCopyValue( handle, "key0", &jstr ) ) {
+            fprintf( stderr, "open %s failed\n", app );
+            exit( 1 );
+        }
+        g_free( jstr );
+        (void)LPAppFreeHandle( handle, false );
+    }
+    return (double)(g_get_monotonic_time() - start) / nApps;
+}
+
+/* us per app to set a key and commit it */
+static double
+timeWrite( int nApps, const char* value )
+{
+    char app[64];
+    int ii;
+
+    gint64 start = g_get_monotonic_time();
+    for ( ii = 0; ii < nApps; ++ii ) {
+        LPAppHandle handle;
+        appId( app, sizeof(app), ii );
+        if ( LP_ERR_NONE != LPAppGetHandle( app, &handle )
+             || LP_ERR_NONE != LPAppSetValue( handle, "key0", value )
+             || LP_ERR_NONE != LPAppFreeHandle( handle, true ) ) {
+            fprintf( stderr, "write %s failed\n", app );
+            exit( 1 );
+        }
+    }
+    return (double)(g_get_monotonic_time() - start) / nApps;
+}
+
+static int
+readRows( const char* file, const char* sql )
+{
+    sqlite3* db;
+    sqlite3_stmt* stmt;
+    int rows = 0;
+    if ( SQLITE_OK == sqlite3_open_v2( file, &db, SQLITE_OPEN_READONLY, NULL )
+         && SQLITE_OK == sqlite3_prepare_v2( db, sql, -1, &stmt, NULL ) ) {
+        while ( SQLITE_ROW == sqlite3_step( stmt ) ) {
+            (void)sqlite3_column_text( stmt, 0 );
+            (void)sqlite3_column_text( stmt, 1 );
+            ++rows;
+        }
+        sqlite3_finalize( stmt );
+    }
+    sqlite3_close( db );
+    return rows;
+}
+
+/* ms to read every app's rows, the way create_prefs_backup() does */
+static double
+timeBackup( int nRows )
+{
+    const char* shared = LPAppSharedStorePath();
+    int rows = 0;
+
+    gint64 start = g_get_monotonic_time();
+    if ( NULL != shared ) {
+        rows = readRows( shared, "SELECT key, value, app FROM data" );
+    } else {
+        GDir* dir = g_dir_open( PREFS_DIR, 0, NULL );
+        const gchar* name;
+        while ( NULL != dir && NULL != (name = g_dir_read_name( dir )) ) {
+            gchar* file = g_build_filename( PREFS_DIR, name, "prefsDB.sl",
+                                            NULL );
+            if ( g_file_test( file, G_FILE_TEST_EXISTS ) ) {
+                rows += readRows( file, "SELECT key, value FROM data" );
+            }
+            g_free( file );
+        }
+        if ( NULL != dir ) {
+            g_dir_close( dir );
+        }
+    }
+    double ms = (double)(g_get_monotonic_time() - start) / 1000;
+
+    if ( rows != nRows ) {
+        fprintf( stderr, "backup read %d rows, not %d\n", rows, nRows );
+        exit( 1 );
+    }
+    return ms;
+}
+
+static void
+clearApps( int nApps )
+{
+    char app[64];
+    int ii;
+    for ( ii = 0; ii < nApps; ++ii ) {
+        appId( app, sizeof(app), ii );
+        (void)LPAppClearData( app );
+    }
+}
+
+int
+main( int argc, char** argv )
+{
+    int nApps = argc > 1 ? atoi( argv[1] ) : 200;
+    int nKeys = argc > 2 ? atoi( argv[2] ) : 20;
+    bool wal = argc > 3 && 0 == strcmp( argv[3], "wal" );
+    char app[64];
+    char key[32];
+    double open[2], write[2], backup[2];
+    int ii, kk;
+
+    if ( NULL != LPAppSharedStorePath() ) {
+        printf( "shared store already in use; nothing to compare\n" );
+        return 0;
+    }
+    if ( othersHavePrefs() ) {
+        printf( "other apps have prefs, which migrating would move;"
+                " run this on a scratch device\n" );
+        return 0;
+    }
+    if ( wal ) {
+        (void)LPAppSetDefaultOption( LP_OPT_JOURNAL_MODE, LP_JOURNAL_WAL );
+    }
+
+    clearApps( nApps );
+    for ( ii = 0; ii < nApps; ++ii ) {
+        LPAppHandle handle;
+        appId( app, sizeof(app), ii );
+        if ( LP_ERR_NONE != LPAppGetHandle( app, &handle ) ) {
+            return 1;
+        }
+        for ( kk = 0; kk < nKeys; ++kk ) {
+            snprintf( key, sizeof(key), "key%d", kk );
+            (void)LPAppSetValue( handle, key, "{ \"value\": 0 }" );
+        }
+        if ( LP_ERR_NONE != LPAppFreeHandle( handle, true ) ) {
+            return 1;
+        }
+    }
+
+    for ( ii = 0; ii < 2; ++ii ) {
+        if ( 1 == ii ) {
+            (void)LPAppTrimPool( true );
+            if ( LP_ERR_NONE != LPAppMigrateToSharedStore() ) {
+                fprintf( stderr, "migration failed\n" );
+                clearApps( nApps );
+                return 1;
+            }
+        }
+        open[ii] = timeOpen( nApps );
+        write[ii] = timeWrite( nApps, "{ \"value\": 1 }" );
+        backup[ii] = timeBackup( nApps * nKeys );
+    }
+
+    printf( "%d apps x %d keys, %s journal\n", nApps, nKeys,
+            wal ? "WAL" : "default" );
+    printf( "                     per-app     shared\n" );
+    printf( "open + get (us)   %10.1f %10.1f\n", open[0], open[1] );
+    printf( "set + commit (us) %10.1f %10.1f\n", write[0], write[1] );
+    printf( "backup read (ms)  %10.1f %10.1f\n", backup[0], backup[1] );
+
+    /* back to per-app DBs, there being only ours in the shared one */
+    clearApps( nApps );
+    (void)LPAppTrimPool( true );
+    gchar* shared = g_strdup( LPAppSharedStorePath() );
+    if ( NULL != shared ) {
+        static const char* const sSuffixes[] = {
+            "-journal", "-wal", "-shm", ""
+        };
+        for ( ii = 0; ii < G_N_ELEMENTS( sSuffixes ); ++ii ) {
+            gchar* path = g_strconcat( shared, sSuffixes[ii], NULL );
+            (void)unlink( path );
+            g_free( path );
+        }
+        g_free( shared );
+    }
+    return 0;
+}
@@ -0,0 +1,175 @@
+// Copyright (c) 2026 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+/* -*-mode: C; fill-column: 78; c-basic-offset: 4; -*- */
+
+/*
+ * Per-call cost of get and set on a long-lived handle, against what they
+ * cost before statements were cached: SQL formatted with sqlite3_mprintf and
+ * compiled by sqlite3_exec for every call, on the same DB file and inside
+ * one transaction, as the handle's calls are.
+ *
+ *   bench_stmtcache [keys [rounds]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <glib.h>
+#include <sqlite3.h>
+
+#include "lunaprefs.h"
+
+#define APP_ID "com.webos.test.bench-stmtcache"
+#define DB_PATH "/var/preferences/" APP_ID "/prefsDB.sl"
+
+static int
+countRow( void* ctx, int nCols, char** vals, char** names )
+{
+    ++*(int*)ctx;
+    return 0;
+}
+
+static double
+perCall( gint64 start, int calls )
+{
+    return (double)(g_get_monotonic_time() - start) / calls;
+}
+
+/* The old way: format, compile, run and throw away, every call. */
+static void
+benchExec( int nKeys, int rounds, double* getUs, double* setUs )
+{
+    sqlite3* db;
+    int found = 0;
+    int ii, rr;
+
+    if ( SQLITE_OK != sqlite3_open( DB_PATH, &db ) ) {
+        fprintf( stderr, "can't open %s\n", DB_PATH );
+        exit( 1 );
+    }
+    sqlite3_exec( db, "BEGIN;", NULL, NULL, NULL );
+
+    gint64 start = g_get_monotonic_time();
+    for ( rr = 0; rr < rounds; ++rr ) {
+        for ( ii = 0; ii < nKeys; ++ii ) {
+            char* sql = sqlite3_mprintf( "SELECT value FROM data"
+                                         " WHERE key = 'key%d';", ii );
+            sqlite3_exec( db, sql, countRow, &found, NULL );
+            sqlite3_free( sql );
+        }
+    }
+    *getUs = perCall( start, nKeys * rounds );
+
+    start = g_get_monotonic_time();
+    for ( rr = 0; rr < rounds; ++rr ) {
+        for ( ii = 0; ii < nKeys; ++ii ) {
+            char* sql = sqlite3_mprintf( "REPLACE INTO data( key, value )"
+                                         " VALUES( 'key%d', '[%d]' );",
+                                         ii, rr );
+            sqlite3_exec( db, sql, NULL, NULL, NULL );
+            sqlite3_free( sql );
+        }
+    }
+    *setUs = perCall( start, nKeys * rounds );
+
+    sqlite3_exec( db, "ROLLBACK;", NULL, NULL, NULL );
+    sqlite3_close( db );
+    if ( found != nKeys * rounds ) {
+        fprintf( stderr, "exec: found %d of %d\n", found, nKeys * rounds );
+        exit( 1 );
+    }
+}
+
+/* The library as it is: one handle, its statements compiled once. */
+static void
+benchHandle( int nKeys, int rounds, double* getUs, double* setUs )
+{
+    LPAppHandle handle;
+    char key[32];
+    char val[32];
+    int ii, rr;
+
+    if ( LP_ERR_NONE != LPAppGetHandle( APP_ID, &handle ) ) {
+        exit( 1 );
+    }
+
+    gint64 start = g_get_monotonic_time();
+    for ( rr = 0; rr < rounds; ++rr ) {
+        for ( ii = 0; ii < nKeys; ++ii ) {
+            char* jstr;
+            snprintf( key, sizeof(key), "key%d", ii );
+            if ( LP_ERR_NONE != LPAppCopyValue( handle, key, &jstr ) ) {
+                fprintf( stderr, "handle: no %s\n", key );
+                exit( 1 );
+            }
+            free( jstr );
+        }
+    }
+    *getUs = perCall( start, nKeys * rounds );
+
+    start = g_get_monotonic_time();
+    for ( rr = 0; rr < rounds; ++rr ) {
+        for ( ii = 0; ii < nKeys; ++ii ) {
+            snprintf( key, sizeof(key), "key%d", ii );
+            snprintf( val, sizeof(val), "[%d]", rr );
+            (void)LPAppSetValue( handle, key, val );
+        }
+    }
+    *setUs = perCall( start, nKeys * rounds );
+
+    (void)LPAppFreeHandle( handle, false );
+}
+
+int
+main( int argc, char** argv )
+{
+    int nKeys = argc > 1 ? atoi( argv[1] ) : 1000;
+    int rounds = argc > 2 ? atoi( argv[2] ) : 20;
+    LPAppHandle handle;
+    char key[32];
+    double execGet, execSet, hndlGet, hndlSet;
+    int ii;
+
+    if ( NULL != LPAppSharedStorePath() ) {
+        printf( "shared store in use; nothing to compare\n" );
+        return 0;
+    }
+
+    (void)LPAppClearData( APP_ID );
+    if ( LP_ERR_NONE != LPAppGetHandle( APP_ID, &handle ) ) {
+        return 1;
+    }
+    for ( ii = 0; ii < nKeys; ++ii ) {
+        snprintf( key, sizeof(key), "key%d", ii );
+        (void)LPAppSetValue( handle, key, "[0]" );
+    }
+    if ( LP_ERR_NONE != LPAppFreeHandle( handle, true ) ) {
+        return 1;
+    }
+    (void)LPAppTrimPool( true );
+
+    benchExec( nKeys, rounds, &execGet, &execSet );
+    benchHandle( nKeys, rounds, &hndlGet, &hndlSet );
+
+    printf( "%d keys, %d rounds, us per call\n", nKeys, rounds );
+    printf( "        exec  handle\n" );
+    printf( "get  %7.2f %7.2f\n", execGet, hndlGet );
+    printf( "set  %7.2f %7.2f\n", execSet, hndlSet );
+
+    (void)LPAppTrimPool( true );
+    (void)LPAppClearData( APP_ID );
+    return 0;
+}
@@ -0,0 +1,84 @@
+// Copyright (c) 2026 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+/* -*-mode: C; fill-column: 78; c-basic-offset: 4; -*- */
+
+/*
+ * What the test_ programs share: checks that count failures and say where,
+ * and a fresh handle on an app with no prefs.  Each program includes this
+ * once and returns testResult() from main.
+ */
+
+#ifndef _LPTEST_H_
+#define _LPTEST_H_
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <glib.h>
+
+#include "lunaprefs.h"
+
+static int sFailures = 0;
+
+static void
+checkAt( bool ok, const char* what, const char* file, int line )
+{
+    if ( !ok && ++sFailures <= 50 ) {
+        fprintf( stderr, "FAIL %s:%d: %s\n", file, line, what );
+    }
+}
+
+#define CHECK( cond ) checkAt( (cond), #cond, __FILE__, __LINE__ )
+
+/* A call expected to return want; says what it got instead. */
+#define CHECK_ERR( call, want ) do {                                    \
+        LPErr err_ = (call);                                            \
+        if ( err_ != (want) && ++sFailures <= 50 ) {                    \
+            fprintf( stderr, "FAIL %s:%d: %s gave %d, not %d\n",        \
+                     __FILE__, __LINE__, #call, err_, (want) );         \
+        }                                                               \
+    } while ( 0 )
+
+/* *jstr is as expected; frees it. */
+#define CHECK_STR( jstr, want ) do {                                    \
+        char* str_ = (jstr);                                            \
+        checkAt( NULL != str_ && 0 == strcmp( str_, (want) ),           \
+                 #jstr " is " #want, __FILE__, __LINE__ );              \
+        if ( NULL != str_ && 0 != strcmp( str_, (want) ) ) {            \
+            fprintf( stderr, "  got %s\n", str_ );                      \
+        }                                                               \
+        g_free( str_ );                                                 \
+    } while ( 0 )
+
+/* A handle on appId, cleared of whatever an earlier run left. */
+static LPAppHandle
+freshHandle( const char* appId )
+{
+    LPAppHandle handle = NULL;
+    (void)LPAppClearData( appId );
+    CHECK_ERR( LPAppGetHandle( appId, &handle ), LP_ERR_NONE );
+    return handle;
+}
+
+static int
+testResult( const char* name )
+{
+    printf( "%s: %d failures\n", name, sFailures );
+    return 0 == sFailures ? 0 : 1;
+}
+
+#endif /* #ifndef _LPTEST_H_ */
@@ -0,0 +1,128 @@
+// Copyright (c) 2026 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+/* -*-mode: C; fill-column: 78; c-basic-offset: 4; -*- */
+
+/*
+ * LPAppForEach, from sqlite and from the read cache: the keys it visits and
+ * in what order, stopping early, and a callback that reads through the
+ * handle -- including with the calls that share LPAppForEach's statement --
+ * without disturbing the walk or the key and value it was handed.
+ */
+
+#include "lptest.h"
+
+#define APP_ID "com.webos.test.foreach"
+#define N_KEYS 10
+
+typedef struct Walk {
+    LPAppHandle handle;
+    GString* keys;              /* visited, comma separated */
+    int calls;
+    int stopAfter;              /* 0 for never */
+    bool reads;                 /* read through the handle in visit() */
+} Walk;
+
+static bool
+visit( const char* key, const char* value, void* ctx )
+{
+    Walk* walk = (Walk*)ctx;
+    gchar* keyWas = g_strdup( key );
+    gchar* valueWas = g_strdup( value );
+    char want[32];
+
+    snprintf( want, sizeof(want), "[%s]", key + 1 );
+    CHECK( 'a' != key[0] || 0 == strcmp( value, want ) );
+
+    if ( walk->reads ) {
+        char* jstr;
+        CHECK_ERR( LPAppCopyAllWithPrefix( walk->handle, "b", &jstr ),
+                   LP_ERR_NONE );
+        CHECK_STR( jstr, "[ { \"b0\": [0] }, { \"b1\": [1] } ]" );
+        CHECK_ERR( LPAppCopyKeysWithPrefix( walk->handle, "b", &jstr ),
+                   LP_ERR_NONE );
+        g_free( jstr );
+        CHECK_ERR( LPAppCopyValue( walk->handle, "b1", &jstr ), LP_ERR_NONE );
+        CHECK_STR( jstr, "[1]" );
+        /* what we were handed is untouched */
+        CHECK( 0 == strcmp( key, keyWas ) && 0 == strcmp( value, valueWas ) );
+    }
+
+    g_string_append_printf( walk->keys, "%s%s", walk->calls ? "," : "", key );
+    g_free( keyWas );
+    g_free( valueWas );
+    return ++walk->calls != walk->stopAfter && walk->calls < 100;
+}
+
+static void
+walkAndCheck( LPAppHandle handle, const char* prefix, int stopAfter,
+              bool reads, const char* want )
+{
+    Walk walk = { handle, g_string_new( NULL ), 0, stopAfter, reads };
+    CHECK_ERR( LPAppForEach( handle, prefix, visit, &walk ), LP_ERR_NONE );
+    CHECK( 0 == strcmp( walk.keys->str, want ) );
+    if ( 0 != strcmp( walk.keys->str, want ) ) {
+        fprintf( stderr, "  prefix %s visited %s\n", prefix, walk.keys->str );
+    }
+    g_string_free( walk.keys, TRUE );
+}
+
+static void
+runWalks( LPAppHandle handle )
+{
+    const char* allA = "a0,a1,a2,a3,a4,a5,a6,a7,a8,a9";
+    const char* all = "a0,a1,a2,a3,a4,a5,a6,a7,a8,a9,b0,b1";
+    char* jstr;
+
+    walkAndCheck( handle, "a", 0, false, allA );
+    walkAndCheck( handle, "a", 0, true, allA );
+    walkAndCheck( handle, "a", 3, true, "a0,a1,a2" );
+    walkAndCheck( handle, NULL, 0, true, all );
+    walkAndCheck( handle, "", 0, false, all );
+    walkAndCheck( handle, "zz", 0, true, "" );
+
+    /* and the calls sharing its statement still work after */
+    CHECK_ERR( LPAppCopyAllWithPrefix( handle, "a9", &jstr ), LP_ERR_NONE );
+    CHECK_STR( jstr, "[ { \"a9\": [9] } ]" );
+}
+
+int
+main( int argc, char** argv )
+{
+    LPAppHandle handle = freshHandle( APP_ID );
+    char key[16], value[16];
+    int ii;
+
+    for ( ii = 0; ii < N_KEYS; ++ii ) {
+        snprintf( key, sizeof(key), "a%d", ii );
+        snprintf( value, sizeof(value), "[%d]", ii );
+        CHECK_ERR( LPAppSetValue( handle, key, value ), LP_ERR_NONE );
+    }
+    CHECK_ERR( LPAppSetValue( handle, "b0", "[0]" ), LP_ERR_NONE );
+    CHECK_ERR( LPAppSetValue( handle, "b1", "[1]" ), LP_ERR_NONE );
+
+    runWalks( handle );         /* from sqlite */
+    CHECK_ERR( LPAppFreeHandle( handle, true ), LP_ERR_NONE );
+
+    /* options go on before the handle's first use */
+    CHECK_ERR( LPAppGetHandle( APP_ID, &handle ), LP_ERR_NONE );
+    CHECK_ERR( LPAppSetOption( handle, LP_OPT_READ_CACHE, 64 * 1024 ),
+               LP_ERR_NONE );
+    runWalks( handle );         /* from the read cache */
+    CHECK_ERR( LPAppFreeHandle( handle, false ), LP_ERR_NONE );
+    (void)LPAppClearData( APP_ID );
+    return testResult( "foreach" );
+}
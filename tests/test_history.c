@@ -0,0 +1,94 @@
+// Copyright (c) 2026 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+/* -*-mode: C; fill-column: 78; c-basic-offset: 4; -*- */
+
+/*
+ * LPAppCopyChangesSince: a first copy from -1, then only what was set and
+ * removed since each sequence number, a key removed and set again counting
+ * as changed, and LP_ERR_NO_HISTORY for a number the app's history can't
+ * answer for -- one it never gave out, or one from before a clear.
+ */
+
+#include "lptest.h"
+
+#define APP_ID "com.webos.test.history"
+
+static long long
+checkChanges( LPAppHandle handle, long long since, const char* want )
+{
+    char* jstr = NULL;
+    long long seq = -1;
+    CHECK_ERR( LPAppCopyChangesSince( handle, since, &jstr, &seq ),
+               LP_ERR_NONE );
+    CHECK_STR( jstr, want );
+    CHECK( seq >= since );
+    return seq;
+}
+
+int
+main( int argc, char** argv )
+{
+    LPAppHandle handle = freshHandle( APP_ID );
+    char* jstr;
+    long long seq, first, last;
+
+    seq = checkChanges( handle, -1,
+                        "{ \"changed\": [ ], \"removed\": [ ] }" );
+
+    CHECK_ERR( LPAppSetValue( handle, "a", "[1]" ), LP_ERR_NONE );
+    CHECK_ERR( LPAppSetValue( handle, "b", "{\"x\":1}" ), LP_ERR_NONE );
+    CHECK_ERR( LPAppSetValueInt( handle, "c", 3 ), LP_ERR_NONE );
+    first = checkChanges( handle, -1, "{ \"changed\": [ { \"a\": [1] },"
+                          " { \"b\": {\"x\":1} }, { \"c\": [ \"3\" ] } ],"
+                          " \"removed\": [ ] }" );
+    checkChanges( handle, first, "{ \"changed\": [ ], \"removed\": [ ] }" );
+
+    CHECK_ERR( LPAppRemoveValue( handle, "a" ), LP_ERR_NONE );
+    CHECK_ERR( LPAppSetValue( handle, "b", "[2]" ), LP_ERR_NONE );
+    seq = checkChanges( handle, first, "{ \"changed\": [ { \"b\": [2] } ],"
+                        " \"removed\": [ \"a\" ] }" );
+
+    /* removed and set again is changed; set and removed is removed */
+    CHECK_ERR( LPAppRemoveValue( handle, "b" ), LP_ERR_NONE );
+    CHECK_ERR( LPAppSetValue( handle, "b", "[3]" ), LP_ERR_NONE );
+    CHECK_ERR( LPAppSetValue( handle, "d", "[4]" ), LP_ERR_NONE );
+    CHECK_ERR( LPAppRemoveValue( handle, "d" ), LP_ERR_NONE );
+    last = checkChanges( handle, seq, "{ \"changed\": [ { \"b\": [3] } ],"
+                         " \"removed\": [ \"d\" ] }" );
+    /* and from further back it all adds up */
+    checkChanges( handle, first, "{ \"changed\": [ { \"b\": [3] } ],"
+                  " \"removed\": [ \"a\", \"d\" ] }" );
+
+    /* numbers it never gave out */
+    CHECK_ERR( LPAppCopyChangesSince( handle, last + 1, &jstr, &seq ),
+               LP_ERR_NO_HISTORY );
+    CHECK_ERR( LPAppCopyChangesSince( handle, first - 10, &jstr, &seq ),
+               LP_ERR_NO_HISTORY );
+    CHECK_ERR( LPAppFreeHandle( handle, true ), LP_ERR_NONE );
+
+    /* nor from before the app's prefs were cleared */
+    handle = freshHandle( APP_ID );
+    CHECK_ERR( LPAppSetValue( handle, "a", "[1]" ), LP_ERR_NONE );
+    CHECK_ERR( LPAppCopyChangesSince( handle, last, &jstr, &seq ),
+               LP_ERR_NO_HISTORY );
+    checkChanges( handle, -1, "{ \"changed\": [ { \"a\": [1] } ],"
+                  " \"removed\": [ ] }" );
+
+    CHECK_ERR( LPAppFreeHandle( handle, true ), LP_ERR_NONE );
+    (void)LPAppClearData( APP_ID );
+    return testResult( "history" );
+}
@@ -0,0 +1,286 @@
+// Copyright (c) 2026 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+/* -*-mode: C; fill-column: 78; c-basic-offset: 4; -*- */
+
+/*
+ * jsonScanText() against json_tokener_parse(), which it stands in front of.
+ * For every document in a fixed corpus, and in many generated and mutated
+ * ones: whatever the scanner calls JSONSCAN_VALID json-c must parse to an
+ * object or array, and feeding the same text through jsonScanFeed() in
+ * pieces, split anywhere, must give the same answer as scanning it whole.
+ *
+ *   test_jsonscan [documents [seed]]
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include <json.h>
+
+#include "jsonscan.h"
+
+/* Strict json the scanner must vouch for. */
+static const char* const sValid[] = {
+    "[]", "{}", "[ ]", " { } ", "\t[\n]\r\n",
+    "[\"123\"]", "[ \"123\" ]", "[0]", "[-0]", "[1.5e10]", "[-1.25E-3]",
+    "[true,false,null]", "[\"\"]", "[\"\\\"\\\\\\/\\b\\f\\n\\r\\t\"]",
+    "[\"\\u00e9\\u20AC\"]", "[\"caf\xc3\xa9\"]",
+    "{\"a\":1,\"b\":[2,3],\"c\":{\"d\":\"e\"}}",
+    "{ \"url\": \"http://example.com/a?b=c&d=e\", \"on\": true }",
+    "[[[[[[[[[[[[[[[[]]]]]]]]]]]]]]]]",                 /* depth 16 */
+    "[123456789012345678]",
+    "[\"a string long enough to go through the wide string skip paths, "
+    "more than thirty-two bytes at a time and then some more\"]",
+};
+
+/* Not strict json, or not something the scanner vouches for. */
+static const char* const sUnknown[] = {
+    "", " ", "1", "\"str\"", "true", "null",   /* not a container */
+    "[", "]", "[1,]", "[,1]", "{\"a\"}", "{\"a\":}", "{\"a\" 1}",
+    "{1:2}", "{'a':1}", "['a']", "[01]", "[1.]", "[.5]", "[1e]", "[+1]",
+    "[tru]", "[True]", "[nul]", "[\"\\x\"]", "[\"\\u12\"]", "[\"a\nb\"]",
+    "[] []", "[]x", "/* c */ []", "[1 2]",
+    "[[[[[[[[[[[[[[[[[]]]]]]]]]]]]]]]]]",               /* depth 17 */
+    "[1234567890123456789]",                             /* past int64 */
+    "[1e1234]", "[\"\\u0000\"]", "[\"\\ud83d\\ude00\"]",
+};
+
+static int sFailures = 0;
+
+static void
+fail( const char* what, const char* text, int r1, int r2 )
+{
+    if ( ++sFailures <= 20 ) {
+        fprintf( stderr, "FAIL %s (%d vs %d): %s\n", what, r1, r2, text );
+    }
+}
+
+static bool
+jsonCAccepts( const char* text )
+{
+    struct json_object* obj = json_tokener_parse( text );
+    bool ok = NULL != obj
+        && ( json_object_is_type( obj, json_type_object )
+             || json_object_is_type( obj, json_type_array ) );
+    json_object_put( obj );
+    return ok;
+}
+
+static JsonScanResult
+scanInPieces( const char* text, const size_t* cuts, int nCuts )
+{
+    JsonScan scan;
+    size_t len = strlen( text );
+    size_t from = 0;
+    int ii;
+
+    jsonScanInit( &scan );
+    for ( ii = 0; ii <= nCuts; ++ii ) {
+        size_t to = ii < nCuts ? cuts[ii] : len;
+        if ( JSONSCAN_UNKNOWN == jsonScanFeed( &scan, text + from,
+                                               to - from ) ) {
+            return JSONSCAN_UNKNOWN;
+        }
+        from = to;
+    }
+    return jsonScanFinish( &scan );
+}
+
+/* The checks every document gets.  Returns the scanner's answer. */
+static JsonScanResult
+check( const char* text )
+{
+    size_t len = strlen( text );
+    JsonScanResult whole = jsonScanText( text, len );
+    size_t cuts[8];
+    size_t ii;
+    int jj;
+
+    if ( JSONSCAN_VALID == whole && !jsonCAccepts( text ) ) {
+        fail( "valid but json-c rejects", text, whole, 0 );
+    }
+
+    /* every single split of short documents; random ones of long */
+    if ( len <= 64 ) {
+        for ( ii = 0; ii <= len; ++ii ) {
+            JsonScanResult split = scanInPieces( text, &ii, 1 );
+            if ( split != whole ) {
+                fail( "split differs", text, whole, split );
+                break;
+            }
+        }
+    }
+    for ( jj = 0; jj < 4 && len > 0; ++jj ) {
+        int nCuts = g_random_int_range( 1, G_N_ELEMENTS( cuts ) + 1 );
+        int kk;
+        for ( kk = 0; kk < nCuts; ++kk ) {
+            cuts[kk] = g_random_int_range( 0, len + 1 );
+        }
+        for ( kk = 1; kk < nCuts; ++kk ) {      /* keep them in order */
+            size_t cut = cuts[kk];
+            int mm = kk;
+            for ( ; mm > 0 && cuts[mm - 1] > cut; --mm ) {
+                cuts[mm] = cuts[mm - 1];
+            }
+            cuts[mm] = cut;
+        }
+        JsonScanResult split = scanInPieces( text, cuts, nCuts );
+        if ( split != whole ) {
+            fail( "chunks differ", text, whole, split );
+        }
+    }
+    return whole;
+}
+
+static const char* const sStrings[] = {
+    "", "a", "key", "caf\xc3\xa9", "\\\"", "\\\\", "\\/", "\\n\\t",
+    "\\u0041", "\\u00ff", "\\uffff", "http://example.com/path",
+    "0123456789abcdefghijklmnopqrstuvwxyz0123456789abcdefghijklmnopqrs",
+};
+
+static const char* const sNumbers[] = {
+    "0", "-0", "7", "-12", "3.25", "-0.5", "1e3", "2E-7", "6.02e+23",
+    "999999999999999999", "-999999999999999999",
+};
+
+static void
+genSpace( GString* gstr )
+{
+    static const char* const sSpace[] = {
+        "", "", "", " ", "\n", "\t ", "\r\n"
+    };
+    g_string_append( gstr, sSpace[ g_random_int_range( 0,
+                                   G_N_ELEMENTS( sSpace ) ) ] );
+}
+
+static void
+genValue( GString* gstr, int depth, bool container )
+{
+    int kind = container ? g_random_int_range( 0, 2 )
+        : g_random_int_range( 0, depth < 18 ? 7 : 5 );
+    int nn, ii;
+
+    genSpace( gstr );
+    switch ( kind ) {
+    case 0:
+    case 1:
+        if ( depth >= 18 ) {
+            g_string_append( gstr, 0 == kind ? "[]" : "{}" );
+            break;
+        }
+        g_string_append_c( gstr, 0 == kind ? '[' : '{' );
+        nn = g_random_int_range( 0, 5 );
+        for ( ii = 0; ii < nn; ++ii ) {
+            if ( ii > 0 ) {
+                g_string_append_c( gstr, ',' );
+            }
+            if ( 1 == kind ) {
+                genSpace( gstr );
+                g_string_append_printf( gstr, "\"%s\"", sStrings[
+                    g_random_int_range( 0, G_N_ELEMENTS( sStrings ) ) ] );
+                genSpace( gstr );
+                g_string_append_c( gstr, ':' );
+            }
+            genValue( gstr, depth + 1, false );
+        }
+        genSpace( gstr );
+        g_string_append_c( gstr, 0 == kind ? ']' : '}' );
+        break;
+    case 2:
+        g_string_append_printf( gstr, "\"%s\"", sStrings[
+            g_random_int_range( 0, G_N_ELEMENTS( sStrings ) ) ] );
+        break;
+    case 3:
+        g_string_append( gstr, sNumbers[
+            g_random_int_range( 0, G_N_ELEMENTS( sNumbers ) ) ] );
+        break;
+    case 4:
+        g_string_append( gstr, g_random_int_range( 0, 3 ) == 0 ? "true"
+                         : g_random_int_range( 0, 2 ) ? "false" : "null" );
+        break;
+    default:
+        genValue( gstr, depth + 1, true );
+    }
+    genSpace( gstr );
+}
+
+/* Break a document: change, drop, add or cut bytes. */
+static void
+mutate( GString* gstr )
+{
+    static const char sBytes[] = "[]{}\",:\\ 0-e.tfnu\x01\x7f\xc3\xa9";
+    int nn = g_random_int_range( 1, 4 );
+    int ii;
+
+    for ( ii = 0; ii < nn && gstr->len > 0; ++ii ) {
+        int at = g_random_int_range( 0, gstr->len );
+        char ch = sBytes[ g_random_int_range( 0, sizeof(sBytes) - 1 ) ];
+        switch ( g_random_int_range( 0, 4 ) ) {
+        case 0: gstr->str[at] = ch; break;
+        case 1: g_string_erase( gstr, at, 1 ); break;
+        case 2: g_string_insert_c( gstr, at, ch ); break;
+        default: g_string_truncate( gstr, at );
+        }
+    }
+}
+
+int
+main( int argc, char** argv )
+{
+    int nDocs = argc > 1 ? atoi( argv[1] ) : 20000;
+    guint32 seed = argc > 2 ? strtoul( argv[2], NULL, 0 ) : 20261016;
+    int nValid = 0;
+    int ii;
+
+    g_random_set_seed( seed );
+
+    for ( ii = 0; ii < G_N_ELEMENTS( sValid ); ++ii ) {
+        JsonScanResult result = check( sValid[ii] );
+        if ( JSONSCAN_VALID != result ) {
+            fail( "should be valid", sValid[ii], result, JSONSCAN_VALID );
+        }
+    }
+    for ( ii = 0; ii < G_N_ELEMENTS( sUnknown ); ++ii ) {
+        JsonScanResult result = check( sUnknown[ii] );
+        if ( JSONSCAN_UNKNOWN != result ) {
+            fail( "should be unknown", sUnknown[ii], result,
+                  JSONSCAN_UNKNOWN );
+        }
+    }
+
+    for ( ii = 0; ii < nDocs; ++ii ) {
+        GString* gstr = g_string_new( NULL );
+        genValue( gstr, 0, true );
+        if ( JSONSCAN_VALID == check( gstr->str ) ) {
+            ++nValid;
+        }
+        mutate( gstr );
+        (void)check( gstr->str );
+        g_string_free( gstr, TRUE );
+    }
+
+    printf( "%d documents (seed %u), %d generated ones valid, %d failures\n",
+            2 * nDocs, seed, nValid, sFailures );
+    /* generated documents are strict json unless nested too deep */
+    if ( nValid < nDocs / 2 ) {
+        fprintf( stderr, "FAIL too few generated documents were valid\n" );
+        ++sFailures;
+    }
+    return 0 == sFailures ? 0 : 1;
+}
@@ -0,0 +1,111 @@
+// Copyright (c) 2026 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+/* -*-mode: C; fill-column: 78; c-basic-offset: 4; -*- */
+
+/*
+ * LPAppMergeValue: merge patches onto objects, nulls removing members, an
+ * array patch replacing the value, a patch onto no value, and
+ * LP_ERR_VALUENOTJSON for a patch that isn't an object or array or a
+ * stored value that isn't json, the value being left as it was.
+ */
+
+#include <sqlite3.h>
+
+#include "lptest.h"
+
+#define APP_ID "com.webos.test.merge"
+#define DB_PATH "/var/preferences/" APP_ID "/prefsDB.sl"
+
+static void
+checkValue( LPAppHandle handle, const char* key, const char* want )
+{
+    char* jstr = NULL;
+    CHECK_ERR( LPAppCopyValue( handle, key, &jstr ), LP_ERR_NONE );
+    CHECK_STR( jstr, want );
+}
+
+/* Stores text that isn't json under key, as only a direct writer of the
+   app's own DB could. */
+static void
+storeNotJson( const char* key )
+{
+    sqlite3* db;
+    bool done = false;
+    if ( SQLITE_OK == sqlite3_open( DB_PATH, &db ) ) {
+        char* sql = sqlite3_mprintf( "INSERT INTO data( key, value )"
+                                     " VALUES( %Q, '{ not json' );", key );
+        done = SQLITE_OK == sqlite3_exec( db, sql, NULL, NULL, NULL );
+        sqlite3_free( sql );
+    }
+    sqlite3_close( db );
+    CHECK( done );
+}
+
+int
+main( int argc, char** argv )
+{
+    LPAppHandle handle = freshHandle( APP_ID );
+    char* jstr;
+
+    /* onto no value: the patch less its nulls */
+    CHECK_ERR( LPAppMergeValue( handle, "o", "{ \"a\": 1, \"b\": null }" ),
+               LP_ERR_NONE );
+    checkValue( handle, "o", "{\"a\":1}" );
+
+    CHECK_ERR( LPAppMergeValue( handle, "o", "{ \"b\": { \"c\": 2 } }" ),
+               LP_ERR_NONE );
+    checkValue( handle, "o", "{\"a\":1,\"b\":{\"c\":2}}" );
+    CHECK_ERR( LPAppMergeValue( handle, "o",
+                                "{ \"a\": null, \"b\": { \"d\": [3] } }" ),
+               LP_ERR_NONE );
+    checkValue( handle, "o", "{\"b\":{\"c\":2,\"d\":[3]}}" );
+
+    /* an array replaces whatever's there */
+    CHECK_ERR( LPAppMergeValue( handle, "o", "[1, 2]" ), LP_ERR_NONE );
+    checkValue( handle, "o", "[1,2]" );
+    CHECK_ERR( LPAppMergeValue( handle, "o", "{ \"a\": 1 }" ), LP_ERR_NONE );
+    checkValue( handle, "o", "{\"a\":1}" );
+
+    /* and typed values are merged as the json they read as */
+    CHECK_ERR( LPAppSetValueString( handle, "s", "x" ), LP_ERR_NONE );
+    CHECK_ERR( LPAppMergeValue( handle, "s", "{ \"a\": 1 }" ), LP_ERR_NONE );
+    checkValue( handle, "s", "{\"a\":1}" );
+
+    /* patches that aren't an object or array */
+    CHECK_ERR( LPAppMergeValue( handle, "o", "1" ), LP_ERR_VALUENOTJSON );
+    CHECK_ERR( LPAppMergeValue( handle, "o", "\"a\"" ), LP_ERR_VALUENOTJSON );
+    CHECK_ERR( LPAppMergeValue( handle, "o", "null" ), LP_ERR_VALUENOTJSON );
+    CHECK_ERR( LPAppMergeValue( handle, "o", "{ \"a\": " ),
+               LP_ERR_VALUENOTJSON );
+    CHECK_ERR( LPAppMergeValue( handle, "o", "" ), LP_ERR_VALUENOTJSON );
+    CHECK_ERR( LPAppMergeValue( handle, "none", "7" ), LP_ERR_VALUENOTJSON );
+    checkValue( handle, "o", "{\"a\":1}" );
+    CHECK_ERR( LPAppCopyValue( handle, "none", &jstr ), LP_ERR_NO_SUCH_KEY );
+    CHECK_ERR( LPAppFreeHandle( handle, true ), LP_ERR_NONE );
+
+    /* onto a stored value that isn't json */
+    if ( NULL == LPAppSharedStorePath() ) {
+        storeNotJson( "bad" );
+        CHECK_ERR( LPAppGetHandle( APP_ID, &handle ), LP_ERR_NONE );
+        CHECK_ERR( LPAppMergeValue( handle, "bad", "{ \"a\": 1 }" ),
+                   LP_ERR_VALUENOTJSON );
+        CHECK_ERR( LPAppFreeHandle( handle, true ), LP_ERR_NONE );
+    }
+
+    (void)LPAppClearData( APP_ID );
+    return testResult( "merge" );
+}
@@ -0,0 +1,88 @@
+// Copyright (c) 2026 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+/* -*-mode: C; fill-column: 78; c-basic-offset: 4; -*- */
+
+/*
+ * LPAppCopyValuePath: members and elements picked out of a value, scalars
+ * coming back as json text, LP_ERR_NO_SUCH_KEY for no key or nothing at the
+ * path, and LP_ERR_PARAM_ERR for a malformed path whatever the value.
+ */
+
+#include "lptest.h"
+
+#define APP_ID "com.webos.test.paths"
+
+static void
+checkPath( LPAppHandle handle, const char* key, const char* path,
+           LPErr want, const char* wantJson )
+{
+    char* jstr = NULL;
+    CHECK_ERR( LPAppCopyValuePath( handle, key, path, &jstr ), want );
+    if ( LP_ERR_NONE == want ) {
+        CHECK_STR( jstr, wantJson );
+    } else {
+        CHECK( NULL == jstr );
+    }
+}
+
+int
+main( int argc, char** argv )
+{
+    LPAppHandle handle = freshHandle( APP_ID );
+    static const char* const sMalformed[] = {
+        "", "audio", "$.", "$[", "$[x]", "$.audio[", "$$",
+    };
+    int ii;
+
+    CHECK_ERR( LPAppSetValue( handle, "settings",
+                              "{ \"audio\": { \"eq\": [ 1, 2, 3, 4 ],"
+                              " \"mode\": \"stereo\", \"mute\": false },"
+                              " \"name\": null }" ), LP_ERR_NONE );
+    CHECK_ERR( LPAppSetValueString( handle, "s", "text" ), LP_ERR_NONE );
+
+    checkPath( handle, "settings", "$.audio.eq[3]", LP_ERR_NONE, "4" );
+    checkPath( handle, "settings", "$.audio.eq", LP_ERR_NONE, "[1,2,3,4]" );
+    checkPath( handle, "settings", "$.audio.mode", LP_ERR_NONE,
+               "\"stereo\"" );
+    checkPath( handle, "settings", "$.audio.mute", LP_ERR_NONE, "false" );
+    checkPath( handle, "settings", "$.name", LP_ERR_NONE, "null" );
+    checkPath( handle, "settings", "$", LP_ERR_NONE,
+               "{\"audio\":{\"eq\":[1,2,3,4],\"mode\":\"stereo\","
+               "\"mute\":false},\"name\":null}" );
+    checkPath( handle, "s", "$[0]", LP_ERR_NONE, "\"text\"" );
+
+    /* nothing there */
+    checkPath( handle, "settings", "$.audio.eq[4]", LP_ERR_NO_SUCH_KEY,
+               NULL );
+    checkPath( handle, "settings", "$.video", LP_ERR_NO_SUCH_KEY, NULL );
+    checkPath( handle, "settings", "$.audio.mode.x", LP_ERR_NO_SUCH_KEY,
+               NULL );
+    checkPath( handle, "none", "$.audio", LP_ERR_NO_SUCH_KEY, NULL );
+
+    /* malformed, with a key or without */
+    for ( ii = 0; ii < G_N_ELEMENTS( sMalformed ); ++ii ) {
+        checkPath( handle, "settings", sMalformed[ii], LP_ERR_PARAM_ERR,
+                   NULL );
+        checkPath( handle, "none", sMalformed[ii], LP_ERR_PARAM_ERR, NULL );
+    }
+
+    /* and the value's still there to read */
+    checkPath( handle, "settings", "$.audio.eq[0]", LP_ERR_NONE, "1" );
+    CHECK_ERR( LPAppFreeHandle( handle, true ), LP_ERR_NONE );
+    (void)LPAppClearData( APP_ID );
+    return testResult( "paths" );
+}
@@ -0,0 +1,87 @@
+// Copyright (c) 2026 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+/* -*-mode: C; fill-column: 78; c-basic-offset: 4; -*- */
+
+/*
+ * LPAppGetHandleReadOnly: every setter and remover refuses with
+ * LP_ERR_PERM and leaves the value alone, and reads see the DB as it was at
+ * the first one until LPAppCommit or LPAppRollback ends the snapshot.
+ */
+
+#include "lptest.h"
+
+#define APP_ID "com.webos.test.readonly"
+
+static void
+checkValue( LPAppHandle handle, const char* key, const char* want )
+{
+    char* jstr = NULL;
+    CHECK_ERR( LPAppCopyValue( handle, key, &jstr ), LP_ERR_NONE );
+    CHECK_STR( jstr, want );
+}
+
+int
+main( int argc, char** argv )
+{
+    LPAppHandle writer, reader;
+    LPAppValueStream stream;
+    char* jstr;
+
+    /* so the writer can commit while the reader reads */
+    CHECK_ERR( LPAppSetDefaultOption( LP_OPT_JOURNAL_MODE, LP_JOURNAL_WAL ),
+               LP_ERR_NONE );
+    writer = freshHandle( APP_ID );
+
+    CHECK_ERR( LPAppSetValue( writer, "a", "[1]" ), LP_ERR_NONE );
+    CHECK_ERR( LPAppCommit( writer ), LP_ERR_NONE );
+
+    CHECK_ERR( LPAppGetHandleReadOnly( APP_ID, &reader ), LP_ERR_NONE );
+    checkValue( reader, "a", "[1]" );
+
+    CHECK_ERR( LPAppSetValue( reader, "a", "[2]" ), LP_ERR_PERM );
+    CHECK_ERR( LPAppSetValueString( reader, "a", "2" ), LP_ERR_PERM );
+    CHECK_ERR( LPAppSetValueInt( reader, "a", 2 ), LP_ERR_PERM );
+    CHECK_ERR( LPAppSetValueInt64( reader, "a", 2 ), LP_ERR_PERM );
+    CHECK_ERR( LPAppSetValueDouble( reader, "a", 2.5 ), LP_ERR_PERM );
+    CHECK_ERR( LPAppSetValueBool( reader, "a", true ), LP_ERR_PERM );
+    CHECK_ERR( LPAppMergeValue( reader, "a", "{ \"b\": 2 }" ), LP_ERR_PERM );
+    CHECK_ERR( LPAppRemoveValue( reader, "a" ), LP_ERR_PERM );
+    CHECK_ERR( LPAppSetValue( reader, "new", "[2]" ), LP_ERR_PERM );
+    CHECK_ERR( LPAppOpenValueWrite( reader, "a", 8, &stream ), LP_ERR_PERM );
+    checkValue( reader, "a", "[1]" );
+    checkValue( writer, "a", "[1]" );
+    CHECK_ERR( LPAppCopyValue( reader, "new", &jstr ), LP_ERR_NO_SUCH_KEY );
+
+    /* a snapshot: the writer's commit isn't seen until it's ended */
+    CHECK_ERR( LPAppSetValue( writer, "a", "[3]" ), LP_ERR_NONE );
+    CHECK_ERR( LPAppCommit( writer ), LP_ERR_NONE );
+    checkValue( reader, "a", "[1]" );
+    CHECK_ERR( LPAppCommit( reader ), LP_ERR_NONE );
+    checkValue( reader, "a", "[3]" );
+
+    CHECK_ERR( LPAppSetValue( writer, "a", "[4]" ), LP_ERR_NONE );
+    CHECK_ERR( LPAppCommit( writer ), LP_ERR_NONE );
+    checkValue( reader, "a", "[3]" );
+    CHECK_ERR( LPAppRollback( reader ), LP_ERR_NONE );
+    checkValue( reader, "a", "[4]" );
+
+    /* freeing with commit true or false is all the same to it */
+    CHECK_ERR( LPAppFreeHandle( reader, true ), LP_ERR_NONE );
+    CHECK_ERR( LPAppFreeHandle( writer, true ), LP_ERR_NONE );
+    (void)LPAppClearData( APP_ID );
+    return testResult( "readonly" );
+}
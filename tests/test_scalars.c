@@ -0,0 +1,118 @@
+// Copyright (c) 2026 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+/* -*-mode: C; fill-column: 78; c-basic-offset: 4; -*- */
+
+/*
+ * The typed getters against the typed setters and older ["123"] values:
+ * what each reads back, and LP_ERR_WRONGTYPE where the value is of another
+ * type or, for LPAppCopyValueInt, too big for an int.
+ */
+
+#include <limits.h>
+
+#include "lptest.h"
+
+#define APP_ID "com.webos.test.scalars"
+
+static void
+checkInt( LPAppHandle handle, const char* key, LPErr want, int wantValue )
+{
+    int value = 12345;
+    LPErr err = LPAppCopyValueInt( handle, key, &value );
+    CHECK_ERR( err, want );
+    if ( LP_ERR_NONE == want ) {
+        CHECK( value == wantValue );
+    } else {
+        CHECK( 12345 == value );    /* untouched */
+    }
+}
+
+int
+main( int argc, char** argv )
+{
+    LPAppHandle handle = freshHandle( APP_ID );
+    int64_t int64Value;
+    double doubleValue;
+    bool boolValue;
+    char* str;
+
+    CHECK_ERR( LPAppSetValueInt( handle, "int", -7 ), LP_ERR_NONE );
+    CHECK_ERR( LPAppSetValueInt64( handle, "max", INT_MAX ), LP_ERR_NONE );
+    CHECK_ERR( LPAppSetValueInt64( handle, "min", INT_MIN ), LP_ERR_NONE );
+    CHECK_ERR( LPAppSetValueInt64( handle, "big", 3000000000LL ),
+               LP_ERR_NONE );
+    CHECK_ERR( LPAppSetValueInt64( handle, "small", -3000000000LL ),
+               LP_ERR_NONE );
+    CHECK_ERR( LPAppSetValueDouble( handle, "double", -2.75 ), LP_ERR_NONE );
+    CHECK_ERR( LPAppSetValueDouble( handle, "nearMin", -2147483648.5 ),
+               LP_ERR_NONE );
+    CHECK_ERR( LPAppSetValueDouble( handle, "huge", 1e20 ), LP_ERR_NONE );
+    CHECK_ERR( LPAppSetValueDouble( handle, "tiny", -1e20 ), LP_ERR_NONE );
+    CHECK_ERR( LPAppSetValueBool( handle, "bool", true ), LP_ERR_NONE );
+    CHECK_ERR( LPAppSetValueString( handle, "string", "42 apples" ),
+               LP_ERR_NONE );
+    CHECK_ERR( LPAppSetValue( handle, "legacy", "[\"17\"]" ), LP_ERR_NONE );
+    CHECK_ERR( LPAppSetValue( handle, "legacyBig", "[\"99999999999\"]" ),
+               LP_ERR_NONE );
+    CHECK_ERR( LPAppSetValue( handle, "object", "{ \"a\": 1 }" ),
+               LP_ERR_NONE );
+
+    checkInt( handle, "int", LP_ERR_NONE, -7 );
+    checkInt( handle, "max", LP_ERR_NONE, INT_MAX );
+    checkInt( handle, "min", LP_ERR_NONE, INT_MIN );
+    checkInt( handle, "big", LP_ERR_WRONGTYPE, 0 );
+    checkInt( handle, "small", LP_ERR_WRONGTYPE, 0 );
+    checkInt( handle, "double", LP_ERR_NONE, -2 );
+    checkInt( handle, "nearMin", LP_ERR_NONE, INT_MIN );
+    checkInt( handle, "huge", LP_ERR_WRONGTYPE, 0 );
+    checkInt( handle, "tiny", LP_ERR_WRONGTYPE, 0 );
+    checkInt( handle, "bool", LP_ERR_NONE, 1 );
+    checkInt( handle, "string", LP_ERR_NONE, 42 );
+    checkInt( handle, "legacy", LP_ERR_NONE, 17 );
+    checkInt( handle, "legacyBig", LP_ERR_WRONGTYPE, 0 );
+    checkInt( handle, "object", LP_ERR_VALUENOTJSON, 0 );
+    checkInt( handle, "none", LP_ERR_NO_SUCH_KEY, 0 );
+
+    CHECK_ERR( LPAppCopyValueInt64( handle, "big", &int64Value ),
+               LP_ERR_NONE );
+    CHECK( 3000000000LL == int64Value );
+    CHECK_ERR( LPAppCopyValueInt64( handle, "legacyBig", &int64Value ),
+               LP_ERR_NONE );
+    CHECK( 99999999999LL == int64Value );
+    CHECK_ERR( LPAppCopyValueInt64( handle, "double", &int64Value ),
+               LP_ERR_WRONGTYPE );
+    CHECK_ERR( LPAppCopyValueDouble( handle, "big", &doubleValue ),
+               LP_ERR_NONE );
+    CHECK( 3000000000.0 == doubleValue );
+    CHECK_ERR( LPAppCopyValueDouble( handle, "huge", &doubleValue ),
+               LP_ERR_NONE );
+    CHECK( 1e20 == doubleValue );
+    CHECK_ERR( LPAppCopyValueBool( handle, "bool", &boolValue ),
+               LP_ERR_NONE );
+    CHECK( boolValue );
+    CHECK_ERR( LPAppCopyValueBool( handle, "int", &boolValue ),
+               LP_ERR_WRONGTYPE );
+
+    /* and the typed values still read as json */
+    CHECK_ERR( LPAppCopyValueString( handle, "big", &str ), LP_ERR_NONE );
+    CHECK_STR( str, "3000000000" );
+
+    CHECK_ERR( LPAppFreeHandle( handle, true ), LP_ERR_NONE );
+    (void)LPAppClearData( APP_ID );
+    return testResult( "scalars" );
+}
@@ -0,0 +1,136 @@
+// Copyright (c) 2026 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+/* -*-mode: C; fill-column: 78; c-basic-offset: 4; -*- */
+
+/*
+ * Value streams: a value written and read back a chunk at a time, and the
+ * documented refusals -- writing past the size given, keeping what isn't
+ * json, a second write stream, and ending the transaction, a write
+ * stream's savepoint or the handle while a stream is open.
+ */
+
+#include "lptest.h"
+
+#define APP_ID "com.webos.test.streams"
+
+static void
+checkValue( LPAppHandle handle, const char* key, const char* want )
+{
+    char* jstr = NULL;
+    CHECK_ERR( LPAppCopyValue( handle, key, &jstr ), LP_ERR_NONE );
+    CHECK_STR( jstr, want );
+}
+
+/* Writes text in chunks of 3 into a stream of size bytes. */
+static LPErr
+writeValue( LPAppHandle handle, const char* key, size_t size,
+            const char* text, bool keep )
+{
+    LPAppValueStream stream;
+    size_t len = strlen( text ), done;
+    LPErr err = LPAppOpenValueWrite( handle, key, size, &stream );
+    for ( done = 0; LP_ERR_NONE == err && done < len; done += 3 ) {
+        err = LPAppWriteValue( stream, text + done, MIN( 3, len - done ) );
+    }
+    CHECK_ERR( err, LP_ERR_NONE );
+    return LPAppCloseValue( stream, keep );
+}
+
+/* Reads key in chunks of 4 and checks it comes to want. */
+static void
+readValue( LPAppHandle handle, const char* key, const char* want )
+{
+    LPAppValueStream stream;
+    GString* gstr = g_string_new( NULL );
+    char buf[4];
+    size_t size = 0, got = 1;
+    CHECK_ERR( LPAppOpenValueRead( handle, key, &stream, &size ),
+               LP_ERR_NONE );
+    CHECK( strlen( want ) == size );
+    while ( got > 0 ) {
+        CHECK_ERR( LPAppReadValue( stream, buf, sizeof(buf), &got ),
+                   LP_ERR_NONE );
+        g_string_append_len( gstr, buf, got );
+        if ( gstr->len > size ) {
+            break;
+        }
+    }
+    CHECK( 0 == strcmp( gstr->str, want ) );
+    CHECK_ERR( LPAppCloseValue( stream, false ), LP_ERR_NONE );
+    g_string_free( gstr, TRUE );
+}
+
+int
+main( int argc, char** argv )
+{
+    LPAppHandle handle = freshHandle( APP_ID );
+    LPAppValueStream stream, reader;
+    size_t size;
+
+    /* exactly the size, and less, the rest left as spaces */
+    CHECK_ERR( writeValue( handle, "a", 18, "{ \"list\": [1, 2] }", true ),
+               LP_ERR_NONE );
+    checkValue( handle, "a", "{ \"list\": [1, 2] }" );
+    readValue( handle, "a", "{ \"list\": [1, 2] }" );
+    CHECK_ERR( writeValue( handle, "b", 12, "[\"x\"]", true ), LP_ERR_NONE );
+    readValue( handle, "b", "[\"x\"]       " );
+
+    /* not kept, or not json: the old value stays */
+    CHECK_ERR( writeValue( handle, "a", 3, "[7]", false ), LP_ERR_NONE );
+    checkValue( handle, "a", "{ \"list\": [1, 2] }" );
+    CHECK_ERR( writeValue( handle, "a", 8, "not json", true ),
+               LP_ERR_VALUENOTJSON );
+    checkValue( handle, "a", "{ \"list\": [1, 2] }" );
+    CHECK_ERR( writeValue( handle, "new", 4, "[1", true ),
+               LP_ERR_VALUENOTJSON );
+    CHECK_ERR( LPAppOpenValueRead( handle, "new", &stream, &size ),
+               LP_ERR_NO_SUCH_KEY );
+
+    /* past the size */
+    CHECK_ERR( LPAppSavepoint( handle ), LP_ERR_NONE );
+    CHECK_ERR( LPAppOpenValueWrite( handle, "c", 4, &stream ), LP_ERR_NONE );
+    CHECK_ERR( LPAppWriteValue( stream, "[1, 2]", 6 ), LP_ERR_PARAM_ERR );
+    CHECK_ERR( LPAppWriteValue( stream, "[12]", 4 ), LP_ERR_NONE );
+    CHECK_ERR( LPAppWriteValue( stream, " ", 1 ), LP_ERR_PARAM_ERR );
+
+    /* one write stream at a time, and nothing ends under it */
+    CHECK_ERR( LPAppOpenValueWrite( handle, "d", 4, &reader ),
+               LP_ERR_PARAM_ERR );
+    CHECK_ERR( LPAppSavepoint( handle ), LP_ERR_PARAM_ERR );
+    CHECK_ERR( LPAppReleaseSavepoint( handle ), LP_ERR_PARAM_ERR );
+    CHECK_ERR( LPAppRollbackSavepoint( handle ), LP_ERR_PARAM_ERR );
+    CHECK_ERR( LPAppCommit( handle ), LP_ERR_PARAM_ERR );
+    CHECK_ERR( LPAppRollback( handle ), LP_ERR_PARAM_ERR );
+    CHECK_ERR( LPAppFreeHandle( handle, true ), LP_ERR_PARAM_ERR );
+    CHECK_ERR( LPAppCloseValue( stream, true ), LP_ERR_NONE );
+    checkValue( handle, "c", "[12]" );
+    CHECK_ERR( LPAppReleaseSavepoint( handle ), LP_ERR_NONE );
+
+    /* nor under a read stream */
+    CHECK_ERR( LPAppOpenValueRead( handle, "c", &reader, &size ),
+               LP_ERR_NONE );
+    CHECK_ERR( LPAppSavepoint( handle ), LP_ERR_NONE );
+    CHECK_ERR( LPAppReleaseSavepoint( handle ), LP_ERR_NONE );
+    CHECK_ERR( LPAppCommit( handle ), LP_ERR_PARAM_ERR );
+    CHECK_ERR( LPAppFreeHandle( handle, true ), LP_ERR_PARAM_ERR );
+    CHECK_ERR( LPAppCloseValue( reader, false ), LP_ERR_NONE );
+    CHECK_ERR( LPAppCommit( handle ), LP_ERR_NONE );
+
+    CHECK_ERR( LPAppFreeHandle( handle, true ), LP_ERR_NONE );
+    (void)LPAppClearData( APP_ID );
+    return testResult( "streams" );
+}
@@ -0,0 +1,191 @@
+// Copyright (c) 2026 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+/* -*-mode: C; fill-column: 78; c-basic-offset: 4; -*- */
+
+/*
+ * One handle shared by 1, 2, 4 and 8 threads.  Each thread runs rounds of
+ * an increment of a shared counter, a set and get of its own key, a peek
+ * under LPAppLockHandle, and a get-then-set of a second shared counter that
+ * is only safe under the lock.  Nothing may fail, every thread must read
+ * back what it wrote, and no update to either counter may be lost.  Prints
+ * the time per round for each thread count.
+ *
+ *   test_threads [rounds per thread]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+
+#include "lunaprefs.h"
+
+#define APP_ID "com.webos.test.threads"
+#define MAX_THREADS 8
+
+typedef struct Worker {
+    LPAppHandle handle;
+    int id;
+    int rounds;
+    int failures;
+} Worker;
+
+static void
+expect( Worker* worker, bool ok, const char* what, LPErr err )
+{
+    if ( !ok ) {
+        if ( ++worker->failures <= 5 ) {
+            fprintf( stderr, "FAIL thread %d: %s (err %d)\n",
+                     worker->id, what, err );
+        }
+    }
+}
+
+static gpointer
+runWorker( gpointer data )
+{
+    Worker* worker = data;
+    LPAppHandle handle = worker->handle;
+    char key[32];
+    int rr;
+
+    snprintf( key, sizeof(key), "thread%d", worker->id );
+    for ( rr = 0; rr < worker->rounds; ++rr ) {
+        int64_t value;
+        char* jstr;
+        const char* peeked;
+        LPErr err;
+
+        err = LPAppIncrement( handle, "counter", 1, NULL );
+        expect( worker, LP_ERR_NONE == err, "increment", err );
+
+        err = LPAppSetValueInt64( handle, key, rr );
+        expect( worker, LP_ERR_NONE == err, "set own key", err );
+        err = LPAppCopyValueInt64( handle, key, &value );
+        expect( worker, LP_ERR_NONE == err && value == rr,
+                "typed get of own key", err );
+
+        err = LPAppCopyValue( handle, key, &jstr );
+        expect( worker, LP_ERR_NONE == err, "copy own key", err );
+        if ( LP_ERR_NONE == err ) {
+            char want[32];
+            snprintf( want, sizeof(want), "[ \"%d\" ]", rr );
+            expect( worker, 0 == strcmp( jstr, want ), "copied text", err );
+            g_free( jstr );
+        }
+
+        /* the peeked pointer is only good while the lock is held */
+        LPAppLockHandle( handle );
+        err = LPAppPeekValue( handle, "counter", &peeked );
+        expect( worker, LP_ERR_NONE == err && '[' == peeked[0],
+                "peek counter", err );
+        LPAppUnlockHandle( handle );
+
+        /* a get and a dependent set: lost updates unless locked */
+        LPAppLockHandle( handle );
+        err = LPAppCopyValueInt64( handle, "locked", &value );
+        if ( LP_ERR_NO_SUCH_KEY == err ) {
+            value = 0;
+            err = LP_ERR_NONE;
+        }
+        expect( worker, LP_ERR_NONE == err, "get locked counter", err );
+        err = LPAppSetValueInt64( handle, "locked", value + 1 );
+        expect( worker, LP_ERR_NONE == err, "set locked counter", err );
+        LPAppUnlockHandle( handle );
+    }
+    return NULL;
+}
+
+/* Run nThreads workers on one handle; returns the number of failures. */
+static int
+runThreads( LPAppHandle handle, int nThreads, int rounds, int64_t* total )
+{
+    Worker workers[MAX_THREADS];
+    GThread* threads[MAX_THREADS];
+    int failures = 0;
+    int ii;
+
+    gint64 start = g_get_monotonic_time();
+    for ( ii = 0; ii < nThreads; ++ii ) {
+        workers[ii].handle = handle;
+        workers[ii].id = ii;
+        workers[ii].rounds = rounds;
+        workers[ii].failures = 0;
+        threads[ii] = g_thread_new( "worker", runWorker, &workers[ii] );
+    }
+    for ( ii = 0; ii < nThreads; ++ii ) {
+        g_thread_join( threads[ii] );
+        failures += workers[ii].failures;
+    }
+    gint64 elapsed = g_get_monotonic_time() - start;
+    *total += (int64_t)nThreads * rounds;
+
+    int64_t counter = -1, locked = -1;
+    (void)LPAppCopyValueInt64( handle, "counter", &counter );
+    (void)LPAppCopyValueInt64( handle, "locked", &locked );
+    if ( counter != *total || locked != *total ) {
+        fprintf( stderr, "FAIL %d threads: counters %lld and %lld, not %lld\n",
+                 nThreads, (long long)counter, (long long)locked,
+                 (long long)*total );
+        ++failures;
+    }
+
+    printf( "%d threads: %6.2f us per round, %8.0f rounds/s\n", nThreads,
+            (double)elapsed / ((double)nThreads * rounds),
+            (double)nThreads * rounds * G_USEC_PER_SEC / elapsed );
+    return failures;
+}
+
+int
+main( int argc, char** argv )
+{
+    int rounds = argc > 1 ? atoi( argv[1] ) : 2000;
+    LPAppHandle handle;
+    int64_t total = 0;
+    int failures = 0;
+    int nThreads;
+
+    (void)LPAppClearData( APP_ID );
+    LPErr err = LPAppGetHandle( APP_ID, &handle );
+    if ( LP_ERR_NONE != err ) {
+        fprintf( stderr, "FAIL LPAppGetHandle: %d\n", err );
+        return 1;
+    }
+    for ( nThreads = 1; nThreads <= MAX_THREADS; nThreads *= 2 ) {
+        failures += runThreads( handle, nThreads, rounds, &total );
+    }
+    err = LPAppFreeHandle( handle, true );
+    if ( LP_ERR_NONE != err ) {
+        fprintf( stderr, "FAIL LPAppFreeHandle: %d\n", err );
+        ++failures;
+    }
+
+    /* and it all got committed */
+    int64_t counter = -1;
+    if ( LP_ERR_NONE == LPAppGetHandle( APP_ID, &handle ) ) {
+        (void)LPAppCopyValueInt64( handle, "counter", &counter );
+        (void)LPAppFreeHandle( handle, false );
+    }
+    if ( counter != total ) {
+        fprintf( stderr, "FAIL committed counter %lld, not %lld\n",
+                 (long long)counter, (long long)total );
+        ++failures;
+    }
+
+    (void)LPAppClearData( APP_ID );
+    return 0 == failures ? 0 : 1;
+}
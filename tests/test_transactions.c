@@ -0,0 +1,133 @@
+// Copyright (c) 2026 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+/* -*-mode: C; fill-column: 78; c-basic-offset: 4; -*- */
+
+/*
+ * LPAppCommit, LPAppRollback and savepoints: what each keeps and undoes, as
+ * seen from a second handle, and LP_ERR_PARAM_ERR where they're documented
+ * to refuse -- with no savepoint open, and from an LPAppForEach callback,
+ * whether the walk is from sqlite or from the read cache.
+ */
+
+#include "lptest.h"
+
+#define APP_ID "com.webos.test.transactions"
+
+/* key's value as another handle sees it, or "none" */
+static gchar*
+committed( const char* key )
+{
+    LPAppHandle other;
+    char* jstr = NULL;
+    CHECK_ERR( LPAppGetHandle( APP_ID, &other ), LP_ERR_NONE );
+    if ( LP_ERR_NONE != LPAppCopyValue( other, key, &jstr ) ) {
+        jstr = g_strdup( "none" );
+    }
+    (void)LPAppFreeHandle( other, false );
+    return jstr;
+}
+
+static bool
+endFromCallback( const char* key, const char* value, void* ctx )
+{
+    LPAppHandle handle = (LPAppHandle)ctx;
+    CHECK_ERR( LPAppCommit( handle ), LP_ERR_PARAM_ERR );
+    CHECK_ERR( LPAppRollback( handle ), LP_ERR_PARAM_ERR );
+    CHECK_ERR( LPAppRollbackSavepoint( handle ), LP_ERR_PARAM_ERR );
+    CHECK_ERR( LPAppFreeHandle( handle, false ), LP_ERR_PARAM_ERR );
+    return true;
+}
+
+static void
+checkCallbacks( LPAppHandle handle )
+{
+    char* jstr;
+    CHECK_ERR( LPAppSetValue( handle, "walked", "[1]" ), LP_ERR_NONE );
+    CHECK_ERR( LPAppSavepoint( handle ), LP_ERR_NONE );
+    CHECK_ERR( LPAppForEach( handle, NULL, endFromCallback, handle ),
+               LP_ERR_NONE );
+    /* none of it took: the savepoint and the set are still there */
+    CHECK_ERR( LPAppReleaseSavepoint( handle ), LP_ERR_NONE );
+    CHECK_ERR( LPAppCopyValue( handle, "walked", &jstr ), LP_ERR_NONE );
+    CHECK_STR( jstr, "[1]" );
+    CHECK_ERR( LPAppCommit( handle ), LP_ERR_NONE );
+    CHECK_STR( committed( "walked" ), "[1]" );
+}
+
+int
+main( int argc, char** argv )
+{
+    LPAppHandle handle = freshHandle( APP_ID );
+    char* jstr;
+
+    /* nothing to end yet is fine */
+    CHECK_ERR( LPAppCommit( handle ), LP_ERR_NONE );
+    CHECK_ERR( LPAppRollback( handle ), LP_ERR_NONE );
+
+    CHECK_ERR( LPAppSetValue( handle, "a", "[1]" ), LP_ERR_NONE );
+    CHECK_STR( committed( "a" ), "none" );
+    CHECK_ERR( LPAppCommit( handle ), LP_ERR_NONE );
+    CHECK_STR( committed( "a" ), "[1]" );
+
+    CHECK_ERR( LPAppSetValue( handle, "a", "[2]" ), LP_ERR_NONE );
+    CHECK_ERR( LPAppRollback( handle ), LP_ERR_NONE );
+    CHECK_ERR( LPAppCopyValue( handle, "a", &jstr ), LP_ERR_NONE );
+    CHECK_STR( jstr, "[1]" );
+
+    /* savepoints: none open */
+    CHECK_ERR( LPAppReleaseSavepoint( handle ), LP_ERR_PARAM_ERR );
+    CHECK_ERR( LPAppRollbackSavepoint( handle ), LP_ERR_PARAM_ERR );
+
+    /* nested: roll back the inner, release the outer */
+    CHECK_ERR( LPAppSavepoint( handle ), LP_ERR_NONE );
+    CHECK_ERR( LPAppSetValue( handle, "b", "[1]" ), LP_ERR_NONE );
+    CHECK_ERR( LPAppSavepoint( handle ), LP_ERR_NONE );
+    CHECK_ERR( LPAppSetValue( handle, "b", "[2]" ), LP_ERR_NONE );
+    CHECK_ERR( LPAppSetValue( handle, "c", "[2]" ), LP_ERR_NONE );
+    CHECK_ERR( LPAppRollbackSavepoint( handle ), LP_ERR_NONE );
+    CHECK_ERR( LPAppCopyValue( handle, "b", &jstr ), LP_ERR_NONE );
+    CHECK_STR( jstr, "[1]" );
+    CHECK_ERR( LPAppCopyValue( handle, "c", &jstr ), LP_ERR_NO_SUCH_KEY );
+    CHECK_ERR( LPAppReleaseSavepoint( handle ), LP_ERR_NONE );
+    CHECK_ERR( LPAppReleaseSavepoint( handle ), LP_ERR_PARAM_ERR );
+    CHECK_STR( committed( "b" ), "none" );     /* released isn't committed */
+    CHECK_ERR( LPAppCommit( handle ), LP_ERR_NONE );
+    CHECK_STR( committed( "b" ), "[1]" );
+
+    /* a commit closes whatever savepoints are open */
+    CHECK_ERR( LPAppSavepoint( handle ), LP_ERR_NONE );
+    CHECK_ERR( LPAppSavepoint( handle ), LP_ERR_NONE );
+    CHECK_ERR( LPAppSetValue( handle, "d", "[1]" ), LP_ERR_NONE );
+    CHECK_ERR( LPAppCommit( handle ), LP_ERR_NONE );
+    CHECK_ERR( LPAppRollbackSavepoint( handle ), LP_ERR_PARAM_ERR );
+    CHECK_STR( committed( "d" ), "[1]" );
+
+    checkCallbacks( handle );   /* walking sqlite */
+    CHECK_ERR( LPAppFreeHandle( handle, true ), LP_ERR_NONE );
+
+    CHECK_ERR( LPAppGetHandle( APP_ID, &handle ), LP_ERR_NONE );
+    CHECK_ERR( LPAppSetOption( handle, LP_OPT_READ_CACHE, 64 * 1024 ),
+               LP_ERR_NONE );
+    CHECK_ERR( LPAppRemoveValue( handle, "walked" ), LP_ERR_NONE );
+    CHECK_ERR( LPAppCommit( handle ), LP_ERR_NONE );
+    checkCallbacks( handle );   /* walking the read cache */
+    CHECK_ERR( LPAppFreeHandle( handle, true ), LP_ERR_NONE );
+
+    (void)LPAppClearData( APP_ID );
+    return testResult( "transactions" );
+}
@@ -0,0 +1,107 @@
+// Copyright (c) 2026 LG Electronics, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+
+/* -*-mode: C; fill-column: 78; c-basic-offset: 4; -*- */
+
+/*
+ * Versions and the calls that use them: each write moves a value's version
+ * on, LPAppCopyValueIfChanged answers LP_ERR_NOT_MODIFIED only for the
+ * current one, and once the app's DB is cleared and written again -- as
+ * fast as it can be -- no version from before comes back, so a caller
+ * holding one is never told its stale copy is current.
+ */
+
+#include "lptest.h"
+
+#define APP_ID "com.webos.test.versions"
+#define N_WRITES 2000
+
+static long long
+versionOf( LPAppHandle handle, const char* key )
+{
+    LPValueInfo info = { -1, -1, -1 };
+    CHECK_ERR( LPAppGetValueInfo( handle, key, &info ), LP_ERR_NONE );
+    return info.version;
+}
+
+/* Sets key N_WRITES times, committing each; returns the last version. */
+static long long
+writeMany( LPAppHandle handle, const char* key )
+{
+    long long last = -1;
+    char value[32];
+    int ii;
+    for ( ii = 0; ii < N_WRITES; ++ii ) {
+        snprintf( value, sizeof(value), "[%d]", ii );
+        CHECK_ERR( LPAppSetValue( handle, key, value ), LP_ERR_NONE );
+        CHECK_ERR( LPAppCommit( handle ), LP_ERR_NONE );
+        long long version = versionOf( handle, key );
+        CHECK( last < 0 || version == last + 1 );
+        last = version;
+    }
+    return last;
+}
+
+int
+main( int argc, char** argv )
+{
+    LPAppHandle handle = freshHandle( APP_ID );
+    LPValueInfo info;
+    char* jstr;
+    long long version, seq;
+
+    CHECK_ERR( LPAppGetValueInfo( handle, "a", &info ), LP_ERR_NO_SUCH_KEY );
+    CHECK_ERR( LPAppSetValue( handle, "a", "[1]" ), LP_ERR_NONE );
+    CHECK_ERR( LPAppGetValueInfo( handle, "a", &info ), LP_ERR_NONE );
+    CHECK( info.version > 0 && info.mtime > 0 && 3 == info.size );
+
+    CHECK_ERR( LPAppCopyValueIfChanged( handle, "a", info.version, &jstr,
+                                        &version ), LP_ERR_NOT_MODIFIED );
+    CHECK( version == info.version );
+    CHECK_ERR( LPAppCopyValueIfChanged( handle, "a", -1, &jstr, &version ),
+               LP_ERR_NONE );
+    CHECK_STR( jstr, "[1]" );
+    CHECK_ERR( LPAppCopyValueIfChanged( handle, "none", -1, &jstr,
+                                        &version ), LP_ERR_NO_SUCH_KEY );
+
+    /* another key's write moves the app on, not this key */
+    CHECK_ERR( LPAppSetValue( handle, "b", "[1]" ), LP_ERR_NONE );
+    CHECK( versionOf( handle, "b" ) == info.version + 1 );
+    CHECK( versionOf( handle, "a" ) == info.version );
+
+    /* the app's versions so far, every one of them */
+    long long first = info.version;
+    long long stale = writeMany( handle, "a" );
+    CHECK_ERR( LPAppCopyChangesSince( handle, -1, &jstr, &seq ),
+               LP_ERR_NONE );
+    g_free( jstr );
+    CHECK_ERR( LPAppFreeHandle( handle, true ), LP_ERR_NONE );
+
+    /* the DB goes, and is made again and written as fast as before */
+    handle = freshHandle( APP_ID );
+    version = writeMany( handle, "a" );
+    CHECK( version < first || version - N_WRITES >= stale );  /* no overlap */
+    CHECK_ERR( LPAppCopyValueIfChanged( handle, "a", stale, &jstr,
+                                        &version ), LP_ERR_NONE );
+    g_free( jstr );
+    CHECK_ERR( LPAppCopyChangesSince( handle, seq, &jstr, &seq ),
+               LP_ERR_NO_HISTORY );
+
+    CHECK_ERR( LPAppFreeHandle( handle, true ), LP_ERR_NONE );
+    (void)LPAppClearData( APP_ID );
+    return testResult( "versions" );
+}